@@ -0,0 +1,50 @@
+#!/bin/sh
+#
+# Script to be able to run on common Linux and *nix-like OSes (eg macOS)
+# to build and run the C++ benchmarks under the portableBenchmarks directory.
+#
+# Requires a newish g++ (even if a front-end to Clang for example)
+# and with Google benchmark includes and libraries in system paths or under
+# /usr/local/{lib,include}.
+#
+# Intended to be run without arguments from top-level dir of project;
+# any arguments are passed to the benchmark executable,
+# eg --benchmark_filter=SealLong
+#
+# Run as:
+#
+#     sh ./PortableBenchmarksDriver.sh
+
+# Generates a temporary executable at top level.
+EXENAME=tmpbenchexe
+
+# Project source root.
+PROJSRCROOT=content/OTAESGCM
+# Project source files under test.
+PROJSRCS="`find ${PROJSRCROOT} -name '*.cpp' -type f -print`"
+
+# Benchmark source files dir.
+BENCHSRCDIR=portableBenchmarks
+# Source files.
+BENCHSRCS="`find ${BENCHSRCDIR} -name '*.cpp' -type f -print`"
+
+# Benchmark libs.
+BLIBS="-lbenchmark -lpthread"
+
+# Benchmark libs (paths).
+BLIBDIRS="-L/usr/local/lib"
+
+# Benchmark includes (paths).
+BINCLUDES="-I/usr/local/include"
+# Source includes (paths).
+INCLUDES="-I${PROJSRCROOT} -I${PROJSRCROOT}/utility"
+
+rm -f ${EXENAME}
+if g++ -o ${EXENAME} -std=c++11 -O2 -Wall -Werror ${INCLUDES} ${BINCLUDES} ${PROJSRCS} ${BENCHSRCS} ${BLIBDIRS} ${BLIBS} ; then
+    echo Compiled.
+else
+    echo Failed to compile.
+    exit 2
+fi
+
+./${EXENAME} "$@"
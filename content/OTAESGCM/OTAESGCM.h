@@ -38,6 +38,12 @@ Author(s) / Copyright (s): Deniz Erbilgin 2015
 
 // Implementations.
 #include "utility/OTAESGCM_OTAES128Impls.h"
+// Per-node keyed-context cache, eg for gateways.
+#include "utility/OTAESGCM_OTAESGCMKeyCache.h"
+// Multi-core received-frame pipeline (hosted builds only).
+#include "utility/OTAESGCM_OTAESGCMPipeline.h"
+// Persistent worker threads for sealParallel()/openParallel() (hosted builds only).
+#include "utility/OTAESGCM_OTAESGCMThreadPool.h"
 
 
 #endif
@@ -0,0 +1,100 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* Runtime CPU feature detection for optional hardware-accelerated implementations, and CPU cache parameters. */
+
+#ifndef ARDUINO_LIB_OTAESGCM_CPUFEATURES_H
+#define ARDUINO_LIB_OTAESGCM_CPUFEATURES_H
+
+#include <stddef.h>
+
+// x86/x86-64 AES-NI/PCLMULQDQ code is compiled (with per-function target attributes,
+// so no special compiler flags are needed) only where GCC-style intrinsics exist;
+// whether it is used is decided at run time.
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__)) \
+    && !defined(OTAESGCM_NO_X86_INTRINSICS)
+#define OTAESGCM_X86_INTRINSICS
+#endif
+
+#ifdef OTAESGCM_X86_INTRINSICS
+#include <cpuid.h>
+#endif
+
+// Multi-threaded code (C++11 std::thread) is compiled only for hosted builds,
+// not for Arduino/MCU targets.
+#if (__cplusplus >= 201103L) && defined(__STDC_HOSTED__) && (__STDC_HOSTED__ == 1) \
+    && !defined(ARDUINO) && !defined(__AVR_ARCH__) && !defined(OTAESGCM_NO_THREADS)
+#define OTAESGCM_THREADS
+#endif
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+    // Cache line size in bytes for aligning data used from different cores, eg to avoid false sharing;
+    // 1 on MCUs without a data cache.
+#if defined(__AVR_ARCH__) || defined(ARDUINO_ARCH_AVR)
+    static constexpr size_t CACHE_LINE_SIZE = 1;
+#else
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+#endif
+
+#ifdef OTAESGCM_X86_INTRINSICS
+    // CPUID leaf 1 ECX feature bits.
+    static constexpr unsigned CPUID1_ECX_PCLMULQDQ = 1U << 1;
+    static constexpr unsigned CPUID1_ECX_SSSE3     = 1U << 9;
+    static constexpr unsigned CPUID1_ECX_SSE41     = 1U << 19;
+    static constexpr unsigned CPUID1_ECX_AES       = 1U << 25;
+
+    // Get the CPUID leaf 1 ECX feature bits, or 0 if CPUID is not available.
+    // CPUID is run only on the first call, as it serialises the CPU (and traps to any hypervisor);
+    // the result is cached in a function-local static, initialised thread-safely by C++11.
+    inline unsigned cpuid1ECX()
+        {
+        static const unsigned ecx1 = []() -> unsigned
+            {
+            unsigned eax, ebx, ecx, edx;
+            if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) { return(0); }
+            return(ecx);
+            }();
+        return(ecx1);
+        }
+
+    // True iff the CPU supports AES-NI (and the SSE4.1 used alongside it); cached after the first call.
+    inline bool cpuHasAESNI()
+        {
+        static const bool has = ((CPUID1_ECX_AES | CPUID1_ECX_SSE41) == (cpuid1ECX() & (CPUID1_ECX_AES | CPUID1_ECX_SSE41)));
+        return(has);
+        }
+
+    // True iff the CPU supports PCLMULQDQ (and the SSSE3 used alongside it); cached after the first call.
+    inline bool cpuHasPCLMUL()
+        {
+        static const bool has = ((CPUID1_ECX_PCLMULQDQ | CPUID1_ECX_SSSE3) == (cpuid1ECX() & (CPUID1_ECX_PCLMULQDQ | CPUID1_ECX_SSSE3)));
+        return(has);
+        }
+#else
+    // No hardware acceleration available on this target/compiler.
+    inline bool cpuHasAESNI() { return(false); }
+    inline bool cpuHasPCLMUL() { return(false); }
+#endif
+
+    }
+
+#endif
@@ -0,0 +1,506 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): Deniz Erbilgin 2015
+                           Damon Hart-Davis 2015--2016
+                           OpenTRV contributors 2026
+*/
+
+/* OpenTRV OTAESGCM GHASH (GCM authentication hash) implementations. */
+
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVR_ARCH__) || defined(ARDUINO_ARCH_AVR) // Atmel AVR only.
+#include <avr/pgmspace.h>
+#else
+// Kludge code to treat PROGMEM as part of uniform memory space.
+#define PROGMEM
+inline uint8_t pgm_read_byte(const uint8_t *p) { return(*p); }
+#endif
+
+#include "OTAESGCM_GHASH.h"
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+/******************* Private Functions *******************/
+/**
+ * @brief   overwrites sensitive data in a way the compiler should not elide
+ * @param   p               pointer to data to wipe; never NULL
+ * @param   n               number of bytes to wipe
+ */
+static void secureWipe(void *p, size_t n)
+{
+    volatile uint8_t *vp = (volatile uint8_t *)p;
+    while(n-- > 0) { *vp++ = 0; }
+}
+
+// Byte-oriented 4-bit table multiplier (and the bitwise one below), eg for AVR.
+
+/**
+ * @note    xor_block
+ * @brief    xor on 128bit block.
+ * @param    dest:    pointer to destination
+ * @param    src:    pointer to source
+ */
+static void xorBlock(uint8_t *dest, const uint8_t *src)
+{
+    for(uint8_t i = 0; i < GHASH_BLOCK_SIZE; i++){
+        *dest++ ^= *src++;
+    }
+}
+
+/**
+ * @note    shift_block_right
+ * @brief    bitshifts 128bit block (16 byte array) right once
+ * @param    block:    pointer to block to shift
+ * @note    I separated the pointer decrement from the bit shift as it was
+ *             mangling the first byte
+ */
+static void shiftBlockRight(uint8_t *block)
+{
+    block += 15;
+
+    // bitshift LSB (last byte in array)
+    *block = *block >> 1;
+    block--;
+
+    // loop through remaining bytes
+    for (uint8_t i = 0; i < GHASH_BLOCK_SIZE-1; i++) {
+        // if lsb is set, set msb of next byte in array
+        if(*block & 0x01) *(block + 1) |= 0x80;
+        // bit shift byte
+        *block = *block >> 1;
+        block--;
+    }
+}
+
+/**
+ * @brief   multiplies a block by x in GF(2^128), ie shifts right once with reduction
+ * @param   block:    pointer to block to multiply
+ */
+static void multiplyByX(uint8_t *block)
+{
+    // Reduce without branching on the (secret) bit shifted out.
+    const uint8_t r = (uint8_t)(0xe1 & -(block[15] & 0x01));
+    shiftBlockRight(block);
+    block[0] ^= r;
+}
+
+// Reduction of the 4 bits shifted out of the bottom of a block by shiftBlockRight4(),
+// to be xored into the top two bytes: R = 11100001 || 0^120 times each bit.
+static const uint8_t rem4[16][2] PROGMEM =
+    {
+    { 0x00, 0x00 }, { 0x1c, 0x20 }, { 0x38, 0x40 }, { 0x24, 0x60 },
+    { 0x70, 0x80 }, { 0x6c, 0xa0 }, { 0x48, 0xc0 }, { 0x54, 0xe0 },
+    { 0xe1, 0x00 }, { 0xfd, 0x20 }, { 0xd9, 0x40 }, { 0xc5, 0x60 },
+    { 0x91, 0x80 }, { 0x8d, 0xa0 }, { 0xa9, 0xc0 }, { 0xb5, 0xe0 },
+    };
+
+/**
+ * @brief   multiplies a block by x^4 in GF(2^128), ie shifts right four bits with reduction
+ * @param   block:    pointer to block to multiply
+ */
+static void shiftBlockRight4(uint8_t *block)
+{
+    const uint8_t r = block[15] & 0x0f;
+    for(uint8_t i = GHASH_BLOCK_SIZE-1; i > 0; i--) {
+        block[i] = (uint8_t)((block[i] >> 4) | (block[i-1] << 4));
+    }
+    block[0] >>= 4;
+    block[0] ^= pgm_read_byte(&rem4[r][0]);
+    block[1] ^= pgm_read_byte(&rem4[r][1]);
+}
+
+/**
+ * @brief   builds the 4-bit table M[n] = n.H
+ * @param   pH              pointer to 16 byte hash subkey H
+ * @param   M               GHASH_TABLE4_SIZE bytes of table to fill
+ */
+static void GHASHTable4Init(const uint8_t *pH, uint8_t *M)
+{
+    // The top bit of a nibble is the lowest power of x,
+    // so M[8] = H, M[4] = H.x, M[2] = H.x^2, M[1] = H.x^3.
+    memset(M, 0, GHASH_BLOCK_SIZE);
+    memcpy(M + 8*GHASH_BLOCK_SIZE, pH, GHASH_BLOCK_SIZE);
+    for(uint8_t i = 4; i > 0; i >>= 1) {
+        memcpy(M + i*GHASH_BLOCK_SIZE, M + 2*i*GHASH_BLOCK_SIZE, GHASH_BLOCK_SIZE);
+        multiplyByX(M + i*GHASH_BLOCK_SIZE);
+    }
+    // Remaining entries by linearity: M[i+j] = M[i] XOR M[j].
+    for(uint8_t i = 2; i < 16; i <<= 1) {
+        for(uint8_t j = 1; j < i; j++) {
+            memcpy(M + (i+j)*GHASH_BLOCK_SIZE, M + i*GHASH_BLOCK_SIZE, GHASH_BLOCK_SIZE);
+            xorBlock(M + (i+j)*GHASH_BLOCK_SIZE, M + j*GHASH_BLOCK_SIZE);
+        }
+    }
+}
+
+/**
+ * @brief   hashes whole blocks into the running hash with the 4-bit table
+ * @param   M               table from GHASHTable4Init()
+ * @param   pInput          pointer to nBlocks*16 bytes of input
+ * @param   nBlocks         number of whole blocks
+ * @param   pOutput         pointer to 16 byte running hash
+ */
+static void GHASHBlocksTable4(const uint8_t *M, const uint8_t *pInput, size_t nBlocks, uint8_t *pOutput)
+{
+    uint8_t X[GHASH_BLOCK_SIZE];
+    while(nBlocks-- > 0) {
+        // X = Y^(i-1) XOR X_i
+        memcpy(X, pOutput, GHASH_BLOCK_SIZE);
+        xorBlock(X, pInput);
+        pInput += GHASH_BLOCK_SIZE; // move to next block
+
+        // Horner's rule over nibbles from the highest power of x down:
+        // Z = Z.x^4 XOR M[nibble].
+        memcpy(pOutput, M + (X[15] & 0x0f)*GHASH_BLOCK_SIZE, GHASH_BLOCK_SIZE);
+        shiftBlockRight4(pOutput);
+        xorBlock(pOutput, M + (X[15] >> 4)*GHASH_BLOCK_SIZE);
+        for(int8_t i = GHASH_BLOCK_SIZE-2; i >= 0; i--) {
+            shiftBlockRight4(pOutput);
+            xorBlock(pOutput, M + (X[i] & 0x0f)*GHASH_BLOCK_SIZE);
+            shiftBlockRight4(pOutput);
+            xorBlock(pOutput, M + (X[i] >> 4)*GHASH_BLOCK_SIZE);
+        }
+    }
+    secureWipe(X, sizeof(X));
+}
+
+#ifndef OTAESGCM_GHASH_CTMUL64
+
+// Bitwise multiplier, eg for AVR where 64-bit multiplies are slow.
+
+/**
+ * @note    gf_mult
+ * @brief    Performs multiplications in 128 bit galois bit field
+ * @todo    learn how multiplication algorithm works
+ * @param    x: pointer to input 1
+ * @param    y: pointer to input 2
+ * @param    result:    pointer to array to put result in
+ * @note    output straight to *x and save on a memcpy loop?
+ */
+static void gFieldMultiply(const uint8_t *x, const uint8_t *y, uint8_t *result)
+{
+    // working memory
+    uint8_t temp[GHASH_BLOCK_SIZE];
+
+    // init result to 0s and copy y to temp
+    memcpy(temp, y, GHASH_BLOCK_SIZE);
+    memset(result, 0, GHASH_BLOCK_SIZE);
+
+    // multiplication algorithm
+    for (uint8_t i = 0; i < GHASH_BLOCK_SIZE; i++) {
+        for (uint8_t j = 0; j < 8; j++) {
+
+            if (x[i] & (1 << (7 - j))) {
+                /* Z_(i + 1) = Z_i XOR V_i */
+                xorBlock(result, temp);
+            }
+            // if temp is odd, do something?
+            if (temp[15] & 0x01) {
+                /* V_(i + 1) = (V_i >> 1) XOR R */
+                shiftBlockRight(temp);
+                /* R = 11100001 || 0^120 */
+                temp[0] ^= 0xe1;
+            } else {
+                /* V_(i + 1) = V_i >> 1 */
+                shiftBlockRight(temp);
+            }
+        }
+    }
+}
+
+/**
+ * @brief   hashes whole blocks into the running hash with the portable multiplier
+ * @param   pInput          pointer to nBlocks*16 bytes of input
+ * @param   nBlocks         number of whole blocks
+ * @param   pAuthKey        pointer to 128 bit authentication subkey H
+ * @param   pOutput         pointer to 16 byte running hash
+ */
+static void GHASHBlocks(const uint8_t *pInput, size_t nBlocks,
+                        const uint8_t *pAuthKey, uint8_t *pOutput)
+{
+    uint8_t tmp[GHASH_BLOCK_SIZE];
+    while(nBlocks-- > 0) {
+        // Y_i = (Y^(i-1) XOR X_i) dot H
+        xorBlock(pOutput, pInput);
+        pInput += GHASH_BLOCK_SIZE; // move to next block
+
+        gFieldMultiply(pOutput, pAuthKey, tmp);
+
+        // copy tmp to output
+        memcpy(pOutput, tmp, GHASH_BLOCK_SIZE);
+    }
+}
+#else // OTAESGCM_GHASH_CTMUL64
+
+/*
+
+Constant-time GF(2^128) multiply from 64-bit integer multiplies,
+after BearSSL's ghash_ctmul64 (T. Pornin).
+
+Each 64x64 carry-less product is made from 16 integer multiplies
+of operands masked to every fourth bit, so that carries from the
+(at most 16) ones in each 4-bit position cannot reach the next
+position of interest; the wanted bits are then masked back out.
+The high halves of the 128-bit products are computed as the low halves
+of the products of the bit-reversed operands.
+Three such products (Karatsuba) give the 256-bit product,
+which is then reduced: no secret-dependent branches or table lookups.
+
+*/
+
+/**
+ * @brief   low 64 bits of the carry-less product of x and y
+ */
+static inline uint64_t bmul64(const uint64_t x, const uint64_t y)
+{
+    const uint64_t x0 = x & 0x1111111111111111ULL;
+    const uint64_t x1 = x & 0x2222222222222222ULL;
+    const uint64_t x2 = x & 0x4444444444444444ULL;
+    const uint64_t x3 = x & 0x8888888888888888ULL;
+    const uint64_t y0 = y & 0x1111111111111111ULL;
+    const uint64_t y1 = y & 0x2222222222222222ULL;
+    const uint64_t y2 = y & 0x4444444444444444ULL;
+    const uint64_t y3 = y & 0x8888888888888888ULL;
+    uint64_t z0 = (x0 * y0) ^ (x1 * y3) ^ (x2 * y2) ^ (x3 * y1);
+    uint64_t z1 = (x0 * y1) ^ (x1 * y0) ^ (x2 * y3) ^ (x3 * y2);
+    uint64_t z2 = (x0 * y2) ^ (x1 * y1) ^ (x2 * y0) ^ (x3 * y3);
+    uint64_t z3 = (x0 * y3) ^ (x1 * y2) ^ (x2 * y1) ^ (x3 * y0);
+    z0 &= 0x1111111111111111ULL;
+    z1 &= 0x2222222222222222ULL;
+    z2 &= 0x4444444444444444ULL;
+    z3 &= 0x8888888888888888ULL;
+    return(z0 | z1 | z2 | z3);
+}
+
+/**
+ * @brief   reverses the bits of x
+ */
+static inline uint64_t rev64(uint64_t x)
+{
+    x = ((x & 0x5555555555555555ULL) <<  1) | ((x >>  1) & 0x5555555555555555ULL);
+    x = ((x & 0x3333333333333333ULL) <<  2) | ((x >>  2) & 0x3333333333333333ULL);
+    x = ((x & 0x0F0F0F0F0F0F0F0FULL) <<  4) | ((x >>  4) & 0x0F0F0F0F0F0F0F0FULL);
+    x = ((x & 0x00FF00FF00FF00FFULL) <<  8) | ((x >>  8) & 0x00FF00FF00FF00FFULL);
+    x = ((x & 0x0000FFFF0000FFFFULL) << 16) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+    return((x << 32) | (x >> 32));
+}
+
+// Big-endian 64-bit load/store.
+static inline uint64_t load64BE(const uint8_t *p)
+{
+    uint64_t v = 0;
+    for(uint8_t i = 0; i < 8; i++) { v = (v << 8) | p[i]; }
+    return(v);
+}
+static inline void store64BE(uint8_t *p, uint64_t v)
+{
+    for(int8_t i = 7; i >= 0; i--) { p[i] = (uint8_t)v; v >>= 8; }
+}
+
+/**
+ * @brief   hashes whole blocks into the running hash with the portable constant-time multiplier
+ * @param   pInput          pointer to nBlocks*16 bytes of input
+ * @param   nBlocks         number of whole blocks
+ * @param   pAuthKey        pointer to 128 bit authentication subkey H
+ * @param   pOutput         pointer to 16 byte running hash
+ */
+static void GHASHBlocks(const uint8_t *pInput, size_t nBlocks,
+                        const uint8_t *pAuthKey, uint8_t *pOutput)
+{
+    uint64_t y1 = load64BE(pOutput);
+    uint64_t y0 = load64BE(pOutput + 8);
+    const uint64_t h1 = load64BE(pAuthKey);
+    const uint64_t h0 = load64BE(pAuthKey + 8);
+    const uint64_t h0r = rev64(h0);
+    const uint64_t h1r = rev64(h1);
+    const uint64_t h2 = h0 ^ h1;
+    const uint64_t h2r = h0r ^ h1r;
+
+    while(nBlocks-- > 0) {
+        // Y_i = (Y^(i-1) XOR X_i) dot H
+        y1 ^= load64BE(pInput);
+        y0 ^= load64BE(pInput + 8);
+        pInput += GHASH_BLOCK_SIZE; // move to next block
+
+        const uint64_t y0r = rev64(y0);
+        const uint64_t y1r = rev64(y1);
+        const uint64_t y2 = y0 ^ y1;
+        const uint64_t y2r = y0r ^ y1r;
+
+        // Karatsuba: low halves directly, high halves via the reversed operands.
+        const uint64_t z0 = bmul64(y0, h0);
+        const uint64_t z1 = bmul64(y1, h1);
+        uint64_t z2 = bmul64(y2, h2);
+        uint64_t z0h = bmul64(y0r, h0r);
+        uint64_t z1h = bmul64(y1r, h1r);
+        uint64_t z2h = bmul64(y2r, h2r);
+        z2 ^= z0 ^ z1;
+        z2h ^= z0h ^ z1h;
+        z0h = rev64(z0h) >> 1;
+        z1h = rev64(z1h) >> 1;
+        z2h = rev64(z2h) >> 1;
+
+        // 256-bit product (bit-reflected), shifted left one bit to undo the reflection.
+        uint64_t v0 = z0;
+        uint64_t v1 = z0h ^ z2;
+        uint64_t v2 = z1 ^ z2h;
+        uint64_t v3 = z1h;
+        v3 = (v3 << 1) | (v2 >> 63);
+        v2 = (v2 << 1) | (v1 >> 63);
+        v1 = (v1 << 1) | (v0 >> 63);
+        v0 = (v0 << 1);
+
+        // Reduce modulo x^128 + x^7 + x^2 + x + 1.
+        v2 ^= v0 ^ (v0 >> 1) ^ (v0 >> 2) ^ (v0 >> 7);
+        v1 ^= (v0 << 63) ^ (v0 << 62) ^ (v0 << 57);
+        v3 ^= v1 ^ (v1 >> 1) ^ (v1 >> 2) ^ (v1 >> 7);
+        v2 ^= (v1 << 63) ^ (v1 << 62) ^ (v1 << 57);
+
+        y0 = v2;
+        y1 = v3;
+    }
+
+    store64BE(pOutput, y1);
+    store64BE(pOutput + 8, y0);
+}
+
+#endif // OTAESGCM_GHASH_CTMUL64
+
+/**
+ * @brief   hashes whole blocks with the multiplier selected in the key
+ */
+static void GHASHBlocksDispatch(const uint8_t *pInput, size_t nBlocks,
+                                const GHASHKey *hk, uint8_t *pOutput)
+{
+#ifdef OTAESGCM_X86_INTRINSICS
+    if(hk->useCLMUL) { GHASHCLMULBlocks(hk->HPow, hk->nHPow, pInput, nBlocks, pOutput); return; }
+#endif
+    if(hk->useTable4) { GHASHBlocksTable4(hk->table4, pInput, nBlocks, pOutput); return; }
+    GHASHBlocks(pInput, nBlocks, hk->H, pOutput);
+}
+
+
+/******************* Public Functions ********************/
+
+/**
+ * @brief   sets H and does any precomputation for the selected multiplier
+ * @param   pH              pointer to 16 byte hash subkey H; never NULL
+ * @param   allowAccel      if false, always use a portable multiplier
+ * @param   preferTable4    if true, use any table in preference to the ctmul64 multiplier
+ * @param   hPowers         powers of H to precompute for PCLMULQDQ, 1..GHASH_HPOWERS
+ */
+void GHASHKey::init(const uint8_t *const pH, const bool allowAccel, const bool preferTable4, const uint8_t hPowers)
+{
+    memcpy(H, pH, GHASH_BLOCK_SIZE);
+    useTable4 = false;
+#ifdef OTAESGCM_X86_INTRINSICS
+    useCLMUL = allowAccel && cpuHasPCLMUL();
+    nHPow = ((0 == hPowers) || (hPowers > GHASH_HPOWERS)) ? GHASH_HPOWERS : hPowers;
+    if(useCLMUL) { GHASHCLMULInit(H, HPow, nHPow); return; }
+#else
+    (void)allowAccel;
+    (void)hPowers;
+#endif
+#ifdef OTAESGCM_GHASH_CTMUL64
+    useTable4 = (NULL != table4) && preferTable4;
+#else
+    (void)preferTable4;
+    useTable4 = (NULL != table4);
+#endif
+    if(useTable4) { GHASHTable4Init(H, table4); }
+}
+
+/**
+ * @brief   securely wipes H and any precomputation, including the table contents
+ */
+void GHASHKey::clear()
+{
+    secureWipe(H, sizeof(H));
+    if(NULL != table4) { secureWipe(table4, GHASH_TABLE4_SIZE); }
+    useTable4 = false;
+#ifdef OTAESGCM_X86_INTRINSICS
+    // Only the powers computed can hold anything.
+    secureWipe(HPow, (size_t)nHPow * GHASH_BLOCK_SIZE);
+    nHPow = 0;
+    useCLMUL = false;
+#endif
+}
+
+/**
+ * @note    ghash
+ * @brief   performs authentication hashing
+ * @param   pInput          pointer to input data
+ * @param   inputLength     length of input array
+ * @param   hk              GHASH key
+ * @param   pOutput         pointer to 16 byte output array
+ */
+void GHASH(const uint8_t *pInput, size_t inputLength,
+           const GHASHKey *hk, uint8_t *pOutput)
+{
+    // hash full blocks
+    const size_t m = inputLength / GHASH_BLOCK_SIZE;
+    if(m > 0) { GHASHBlocksDispatch(pInput, m, hk, pOutput); }
+
+    // check if final partial block. Can be omitted if we use full blocks.
+    const uint8_t last = uint8_t(inputLength % GHASH_BLOCK_SIZE);
+    if (last) {
+        uint8_t tmp[GHASH_BLOCK_SIZE];
+        // zero pad
+        memcpy(tmp, pInput + m * GHASH_BLOCK_SIZE, last);
+        memset(tmp + last, 0, sizeof(tmp) - last);
+        GHASHBlocksDispatch(tmp, 1, hk, pOutput);
+    }
+}
+
+/**
+ * @brief   multiplies the running hash by H^n
+ * @param   hk              GHASH key; never NULL
+ * @param   n               power of H
+ * @param   pOutput         pointer to 16 byte running hash, updated in place
+ *
+ * Square-and-multiply, each multiply by P being a one-block GHASH of zeros
+ * under a temporary key with hash subkey P, so that the fastest multiplier is used.
+ */
+void GHASHMulHPower(const GHASHKey *hk, uint64_t n, uint8_t *pOutput)
+{
+    static const uint8_t zeros[GHASH_BLOCK_SIZE] = { 0 };
+    if(0 == n) { return; }
+    // Power H^(2^i) as a key.
+    GHASHKey pk;
+    pk.init(hk->H);
+    for( ; ; )
+    {
+        if(n & 1) { GHASH(zeros, sizeof(zeros), &pk, pOutput); }
+        n >>= 1;
+        if(0 == n) { break; }
+        uint8_t square[GHASH_BLOCK_SIZE];
+        memcpy(square, pk.H, sizeof(square));
+        GHASH(zeros, sizeof(zeros), &pk, square);
+        pk.init(square);
+        secureWipe(square, sizeof(square));
+    }
+    pk.clear();
+}
+
+
+    }
@@ -0,0 +1,133 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* OpenTRV OTAESGCM GHASH (GCM authentication hash) implementations. */
+
+#ifndef ARDUINO_LIB_OTAESGCM_GHASH_H
+#define ARDUINO_LIB_OTAESGCM_GHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "OTAESGCM_CPUFeatures.h"
+
+// The portable multiplier, used where PCLMULQDQ is not:
+// on 64-bit hosts a constant-time one built from 64-bit integer multiplies,
+// else (eg on AVR or 32-bit MCUs such as Cortex-M0 or ESP, where 64-bit multiplies are slow library calls)
+// the small bitwise one or the 4-bit table one if a table workspace is supplied.
+// Define OTAESGCM_GHASH_BITWISE to use the byte-oriented multipliers anyway.
+#if !defined(OTAESGCM_GHASH_BITWISE) && !defined(ARDUINO) \
+    && defined(__SIZEOF_POINTER__) && (__SIZEOF_POINTER__ >= 8)
+#define OTAESGCM_GHASH_CTMUL64
+#endif
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+static constexpr uint8_t GHASH_BLOCK_SIZE = 16; // GHASH block size in bytes, as for AES.
+static constexpr uint8_t GHASH_HPOWERS    = 8;  // Powers of H precomputed for aggregated (PCLMULQDQ) GHASH.
+static constexpr uint16_t GHASH_TABLE4_SIZE = 16 * GHASH_BLOCK_SIZE; // Bytes of 4-bit (Shoup) table of multiples of H.
+
+
+    // GHASH key: the hash subkey H plus any precomputation
+    // for the fastest multiplier available on this CPU.
+    // The multiplier is chosen once in init() (eg after a CPUID check).
+    // Optionally a caller-supplied workspace holds a 4-bit (Shoup) table of multiples of H,
+    // much faster than the bitwise multiplier on eg AVR,
+    // though its lookups are data-dependent so may leak timing where there is a data cache;
+    // by default the table is not used where OTAESGCM_GHASH_CTMUL64 is defined as that is faster.
+    // Holds sensitive state: clear() securely wipes it, including any table.
+    // Can be used concurrently by several readers once initialised.
+    class GHASHKey
+        {
+        public:
+            // Hash subkey H = E(K, 0^128).
+            uint8_t H[GHASH_BLOCK_SIZE];
+            // Caller-supplied workspace of GHASH_TABLE4_SIZE bytes for the 4-bit table, else NULL.
+            // Entry n (of 16, each of GHASH_BLOCK_SIZE bytes) is n.H with n's bits in GCM order.
+            uint8_t * const table4;
+#ifdef OTAESGCM_X86_INTRINSICS
+            // H^1..H^nHPow in the byte-reversed form used with PCLMULQDQ; valid iff useCLMUL.
+            uint8_t HPow[GHASH_HPOWERS][GHASH_BLOCK_SIZE];
+            // Number of powers of H computed, 1..GHASH_HPOWERS; blocks are aggregated this many at a time.
+            uint8_t nHPow;
+            // True if the PCLMULQDQ multiplier is in use.
+            bool useCLMUL;
+#endif
+            // True if the 4-bit table multiplier is in use.
+            bool useTable4;
+
+            // Construct an all-zeros (unkeyed) instance.
+            // If table4Workspace is not NULL it must be GHASH_TABLE4_SIZE bytes
+            // and will be used for the 4-bit table when PCLMULQDQ is not.
+            constexpr GHASHKey(uint8_t *const table4Workspace = NULL) : H(), table4(table4Workspace)
+#ifdef OTAESGCM_X86_INTRINSICS
+                , HPow(), nHPow(0), useCLMUL(false)
+#endif
+                , useTable4(false)
+                { }
+
+            // Set H and do any precomputation.
+            // If allowAccel is false PCLMULQDQ is not used (eg for testing).
+            // If preferTable4 is true a supplied table is used even where the ctmul64 multiplier is available
+            // (eg to test the table multiplier on a host).
+            // hPowers (1..GHASH_HPOWERS) limits the powers of H precomputed for PCLMULQDQ,
+            // eg where no GHASH() call will be given more blocks than that, to save their setup and wiping.
+            void init(const uint8_t *pH, bool allowAccel = true, bool preferTable4 = false,
+                      uint8_t hPowers = GHASH_HPOWERS);
+
+            // Securely wipe H and any precomputation, including the table contents.
+            void clear();
+        };
+
+    /**
+     * @brief   performs authentication hashing, updating the running hash
+     * @param   pInput          pointer to input data; may be NULL if inputLength is 0
+     * @param   inputLength     length of input array; a final partial block is zero-padded
+     * @param   hk              GHASH key; never NULL
+     * @param   pOutput         pointer to 16 byte running hash, updated in place
+     */
+    void GHASH(const uint8_t *pInput, size_t inputLength,
+               const GHASHKey *hk, uint8_t *pOutput);
+
+    /**
+     * @brief   multiplies the running hash by H^n, ie as if n zero blocks had been hashed;
+     *          eg to fold together GHASHes of separate parts of a message
+     * @param   hk              GHASH key; never NULL
+     * @param   n               power of H
+     * @param   pOutput         pointer to 16 byte running hash, updated in place
+     * @note    costs about 2.log2(n) field multiplies, each with its own key setup
+     */
+    void GHASHMulHPower(const GHASHKey *hk, uint64_t n, uint8_t *pOutput);
+
+#ifdef OTAESGCM_X86_INTRINSICS
+    // PCLMULQDQ kernels, only to be called when cpuHasPCLMUL() is true.
+    // Compute HPow[0..nPowers-1] = H^1..H^nPowers from H; nPowers is 1..GHASH_HPOWERS.
+    void GHASHCLMULInit(const uint8_t *pH, uint8_t HPow[GHASH_HPOWERS][GHASH_BLOCK_SIZE], uint8_t nPowers);
+    // Hash nBlocks whole blocks into the running hash pOutput, nPowers blocks per reduction.
+    void GHASHCLMULBlocks(const uint8_t HPow[GHASH_HPOWERS][GHASH_BLOCK_SIZE], uint8_t nPowers,
+                          const uint8_t *pInput, size_t nBlocks, uint8_t *pOutput);
+#endif
+
+
+    }
+
+#endif
@@ -0,0 +1,138 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* x86/x86-64 PCLMULQDQ GHASH with aggregated reduction. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "OTAESGCM_GHASH.h"
+
+#ifdef OTAESGCM_X86_INTRINSICS
+
+#include "OTAESGCM_GHASHCLMULInline.h"
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+/*
+GHASH with carry-less multiply, after Gueron and Kounavis,
+"Intel Carry-Less Multiplication Instruction and its Usage for Computing the GCM Mode".
+
+Blocks are byte-reversed on load so that each 128-bit lane holds the GCM
+(bit-reflected) polynomial; the 256-bit product is computed Karatsuba-style
+from three PCLMULQDQs, shifted left one bit to undo the reflection,
+and reduced modulo x^128 + x^7 + x^2 + x + 1.
+
+The shift and reduction are linear, so for GHASH_HPOWERS blocks at a time
+  Y' = (Y ^ X1).H^8 ^ X2.H^7 ^ ... ^ X8.H
+the unreduced products are summed and reduced once (aggregated reduction).
+
+*/
+
+
+/******************* Private Functions *******************/
+
+// Single GF(2^128) multiply of byte-reversed values.
+OTAESGCM_TARGET_CLMUL
+static inline __m128i gfMul(__m128i a, __m128i b)
+    {
+    Product256 acc = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+    mulAccumulate(acc, a, b);
+    return(reduce(acc));
+    }
+
+
+/******************* Public Functions ********************/
+
+/**
+ * @brief   computes H^1..H^nPowers for the aggregated kernel
+ * @param   pH              pointer to 16 byte hash subkey H
+ * @param   HPow            output powers, byte-reversed; HPow[i] = H^(i+1)
+ * @param   nPowers         number of powers to compute, 1..GHASH_HPOWERS
+ */
+OTAESGCM_TARGET_CLMUL
+void GHASHCLMULInit(const uint8_t *const pH, uint8_t HPow[GHASH_HPOWERS][GHASH_BLOCK_SIZE], const uint8_t nPowers)
+    {
+    const __m128i h = loadReversed(pH);
+    __m128i p = h;
+    _mm_storeu_si128((__m128i *)HPow[0], p);
+    for(uint8_t i = 1; i < nPowers; ++i)
+        {
+        p = gfMul(p, h);
+        _mm_storeu_si128((__m128i *)HPow[i], p);
+        }
+    }
+
+/**
+ * @brief   hashes whole blocks into the running hash
+ * @param   HPow            powers of H from GHASHCLMULInit()
+ * @param   nPowers         number of powers in HPow, 1..GHASH_HPOWERS
+ * @param   pInput          pointer to nBlocks*16 bytes of input
+ * @param   nBlocks         number of whole blocks
+ * @param   pOutput         pointer to 16 byte running hash, updated in place
+ */
+OTAESGCM_TARGET_CLMUL
+void GHASHCLMULBlocks(const uint8_t HPow[GHASH_HPOWERS][GHASH_BLOCK_SIZE], const uint8_t nPowers,
+                      const uint8_t *pInput, size_t nBlocks, uint8_t *pOutput)
+    {
+    __m128i y = loadReversed(pOutput);
+
+    // GHASH_HPOWERS blocks per reduction.
+    while((GHASH_HPOWERS == nPowers) && (nBlocks >= GHASH_HPOWERS))
+        {
+        Product256 acc = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+        mulAccumulate(acc, _mm_xor_si128(y, loadReversed(pInput)),
+                      _mm_loadu_si128((const __m128i *)HPow[GHASH_HPOWERS - 1]));
+        for(uint8_t i = 1; i < GHASH_HPOWERS; ++i)
+            {
+            mulAccumulate(acc, loadReversed(pInput + i * GHASH_BLOCK_SIZE),
+                          _mm_loadu_si128((const __m128i *)HPow[GHASH_HPOWERS - 1 - i]));
+            }
+        y = reduce(acc);
+        pInput += GHASH_HPOWERS * GHASH_BLOCK_SIZE;
+        nBlocks -= GHASH_HPOWERS;
+        }
+
+    // Remaining blocks, also aggregated up to nPowers at a time: Y' = (Y ^ X1).H^n ^ ... ^ Xn.H.
+    while(nBlocks > 0)
+        {
+        const size_t n = (nBlocks < nPowers) ? nBlocks : nPowers;
+        Product256 acc = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+        mulAccumulate(acc, _mm_xor_si128(y, loadReversed(pInput)),
+                      _mm_loadu_si128((const __m128i *)HPow[n - 1]));
+        for(size_t i = 1; i < n; ++i)
+            {
+            mulAccumulate(acc, loadReversed(pInput + i * GHASH_BLOCK_SIZE),
+                          _mm_loadu_si128((const __m128i *)HPow[n - 1 - i]));
+            }
+        y = reduce(acc);
+        pInput += n * GHASH_BLOCK_SIZE;
+        nBlocks -= n;
+        }
+
+    storeReversed(pOutput, y);
+    }
+
+
+    }
+
+#endif // OTAESGCM_X86_INTRINSICS
@@ -0,0 +1,115 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* Internal: inline PCLMULQDQ GHASH building blocks, shared by the GHASH and stitched AES-GCM kernels. */
+
+#ifndef ARDUINO_LIB_OTAESGCM_GHASHCLMULINLINE_H
+#define ARDUINO_LIB_OTAESGCM_GHASHCLMULINLINE_H
+
+#include <stdint.h>
+
+#include "OTAESGCM_GHASH.h"
+
+#ifdef OTAESGCM_X86_INTRINSICS
+
+#include <emmintrin.h>
+#include <tmmintrin.h>
+#include <wmmintrin.h>
+
+// Functions using the intrinsics are compiled for these extensions
+// without needing global compiler flags; they are only called after a CPUID check.
+#define OTAESGCM_TARGET_CLMUL __attribute__((target("pclmul,ssse3")))
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+// Byte-reversal shuffle mask.
+OTAESGCM_TARGET_CLMUL
+static inline __m128i bswapMask() { return(_mm_set_epi8(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15)); }
+
+// Load/store a block byte-reversed.
+OTAESGCM_TARGET_CLMUL
+static inline __m128i loadReversed(const uint8_t *p)
+    { return(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), bswapMask())); }
+OTAESGCM_TARGET_CLMUL
+static inline void storeReversed(uint8_t *p, __m128i x)
+    { _mm_storeu_si128((__m128i *)p, _mm_shuffle_epi8(x, bswapMask())); }
+
+// Unreduced 256-bit product accumulator: lo, hi and Karatsuba middle terms.
+struct Product256 { __m128i lo, hi, mid; };
+
+// Accumulate the Karatsuba partial products of a.b into acc.
+OTAESGCM_TARGET_CLMUL
+static inline void mulAccumulate(Product256 &acc, __m128i a, __m128i b)
+    {
+    acc.lo = _mm_xor_si128(acc.lo, _mm_clmulepi64_si128(a, b, 0x00));
+    acc.hi = _mm_xor_si128(acc.hi, _mm_clmulepi64_si128(a, b, 0x11));
+    const __m128i aa = _mm_xor_si128(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(1,0,3,2)));
+    const __m128i bb = _mm_xor_si128(b, _mm_shuffle_epi32(b, _MM_SHUFFLE(1,0,3,2)));
+    acc.mid = _mm_xor_si128(acc.mid, _mm_clmulepi64_si128(aa, bb, 0x00));
+    }
+
+// Combine, shift and reduce an accumulated 256-bit product to 128 bits.
+OTAESGCM_TARGET_CLMUL
+static inline __m128i reduce(const Product256 &acc)
+    {
+    // Finish Karatsuba: middle term is mid ^ lo ^ hi, split across the two halves.
+    __m128i mid = _mm_xor_si128(acc.mid, _mm_xor_si128(acc.lo, acc.hi));
+    __m128i lo = _mm_xor_si128(acc.lo, _mm_slli_si128(mid, 8));
+    __m128i hi = _mm_xor_si128(acc.hi, _mm_srli_si128(mid, 8));
+
+    // Shift the 256-bit hi:lo left by one bit.
+    __m128i t7 = _mm_srli_epi32(lo, 31);
+    __m128i t8 = _mm_srli_epi32(hi, 31);
+    lo = _mm_slli_epi32(lo, 1);
+    hi = _mm_slli_epi32(hi, 1);
+    const __m128i t9 = _mm_srli_si128(t7, 12);
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    lo = _mm_or_si128(lo, t7);
+    hi = _mm_or_si128(hi, t8);
+    hi = _mm_or_si128(hi, t9);
+
+    // Reduce modulo x^128 + x^7 + x^2 + x + 1.
+    t7 = _mm_slli_epi32(lo, 31);
+    t8 = _mm_slli_epi32(lo, 30);
+    __m128i t = _mm_slli_epi32(lo, 25);
+    t7 = _mm_xor_si128(t7, t8);
+    t7 = _mm_xor_si128(t7, t);
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    lo = _mm_xor_si128(lo, t7);
+    __m128i t2 = _mm_srli_epi32(lo, 1);
+    const __m128i t4 = _mm_srli_epi32(lo, 2);
+    const __m128i t5 = _mm_srli_epi32(lo, 7);
+    t2 = _mm_xor_si128(t2, t4);
+    t2 = _mm_xor_si128(t2, t5);
+    t2 = _mm_xor_si128(t2, t8);
+    lo = _mm_xor_si128(lo, t2);
+    return(_mm_xor_si128(hi, lo));
+    }
+
+
+    }
+
+#endif // OTAESGCM_X86_INTRINSICS
+
+#endif
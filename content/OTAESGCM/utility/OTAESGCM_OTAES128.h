@@ -25,17 +25,25 @@ Author(s) / Copyright (s): Deniz Erbilgin 2015
 #include <stddef.h>
 #include <stdint.h>
 
+#include "OTAESGCM_CPUFeatures.h"
+
 
 // Use namespaces to help avoid collisions.
 namespace OTAESGCM
     {
 
+#ifdef OTAESGCM_X86_INTRINSICS
+    class OTAES128E_AESNI;
+#endif
 
     // Base class / interface for AES128 block encryption only.
     // Implementations can be optimised for different characteristics such as speed or size or CPU.
     // Implementations may contain differing amounts of state / data, ie vary in size.
     // Many uses, eg for AES-GCM, or TX-only leaf nodes, will not require block decryption.
     // Neither re-entrant nor ISR-safe except where stated.
+    // The const keyed operations only read the key schedule and keep their scratch on the stack,
+    // so once setKey() has returned they are re-entrant and one keyed instance may be shared by many threads;
+    // setKey() and clearKey() must not run concurrently with them.
     class OTAES128E
         {
         protected:
@@ -51,6 +59,78 @@ namespace OTAESGCM
              */
             virtual void blockEncrypt(const uint8_t* input, const uint8_t* key, uint8_t *output) = 0;
 
+            /**
+             *    @brief    AES128 key setup for subsequent blockEncryptKeyed() calls
+             *    @param    key takes a pointer to a 128-bit (16-byte) secret key; never NULL
+             *
+             * Expands the key schedule once so that many blocks can be encrypted with it.
+             * The schedule is sensitive and is held until clearKey() is called.
+             */
+            virtual void setKey(const uint8_t *key) = 0;
+
+            /**
+             *    @brief    AES128 block encryption with the key from the last setKey()
+             *    @param    input takes a pointer to an array containing plaintext, of size 16 bytes; never NULL
+             *    @param    output takes a pointer to an array to fill with ciphertext, of size 16 bytes; never NULL
+             *
+             * Does nothing if no key is currently set.
+             * Re-entrant: modifies only output.
+             */
+            virtual void blockEncryptKeyed(const uint8_t* input, uint8_t *output) const = 0;
+
+            // Securely wipe any key schedule held from setKey(); safe to call repeatedly.
+            virtual void clearKey() = 0;
+
+            /**
+             *    @brief    AES128 counter-mode encryption of whole blocks with the key from the last setKey()
+             *    @param    ctrBlock counter block for the first block, of size 16 bytes; never NULL;
+             *              on return the rightmost 32 bits (big-endian) have been advanced by nBlocks, mod 2^32
+             *    @param    input takes a pointer to nBlocks*16 bytes of input; never NULL unless nBlocks is 0
+             *    @param    output takes a pointer to nBlocks*16 bytes of output; may be the same as input
+             *    @param    nBlocks number of whole 16-byte blocks to process
+             *
+             * This is the GCM GCTR inner loop over whole blocks.
+             * Implementations may override this to interleave independent blocks for speed;
+             * by default it encrypts one counter block at a time.
+             */
+            virtual void ctr32EncryptKeyed(uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks) const
+                {
+                uint8_t keystream[16];
+                while(nBlocks-- > 0)
+                    {
+                    blockEncryptKeyed(ctrBlock, keystream);
+                    for(uint8_t i = 0; i < 16; ++i) { *output++ = *input++ ^ keystream[i]; }
+                    // Increment the rightmost 32 bits (big-endian), mod 2^32.
+                    for(uint8_t i = 16; (i > 12) && (0 == ++ctrBlock[i-1]); --i) { }
+                    }
+                }
+
+            /**
+             *    @brief    AES128 encryption of independent blocks with the key from the last setKey()
+             *    @param    input takes a pointer to nBlocks*16 bytes of input; never NULL unless nBlocks is 0
+             *    @param    output takes a pointer to nBlocks*16 bytes of output; may be the same as input
+             *    @param    nBlocks number of whole 16-byte blocks to process
+             *
+             * Eg for the counter blocks of several short messages at once.
+             * Implementations may override this to interleave blocks for speed;
+             * by default it encrypts one block at a time.
+             */
+            virtual void ecbEncryptKeyed(const uint8_t *input, uint8_t *output, size_t nBlocks) const
+                {
+                while(nBlocks-- > 0)
+                    {
+                    blockEncryptKeyed(input, output);
+                    input += 16;
+                    output += 16;
+                    }
+                }
+
+#ifdef OTAESGCM_X86_INTRINSICS
+            // The AES-NI engine behind this one if it is in use, for its stitched CTR+GHASH kernel, else NULL.
+            // Only seen by x86 builds, so that the block cipher interface itself never pulls in GHASH.
+            virtual const OTAES128E_AESNI *getAESNI() const { return(NULL); }
+#endif
+
 #if 0 // Defining the virtual destructor uses ~800+ bytes of Flash by forcing use of malloc()/free().
             // Ensure safe instance destruction when derived from.
             // by default attempts to shut down the sensor and otherwise free resources when done.
@@ -66,6 +146,7 @@ namespace OTAESGCM
     // Implementations may contain differing amounts of state / data, ie vary in size.
     // Many uses, eg for AES-GCM, or TX-only leaf nodes, will not require block decryption.
     // Neither re-entrant nor ISR-safe except where stated.
+    // As for OTAES128E, the const keyed operations are re-entrant once setKey() has returned.
     class OTAES128D
         {
         protected:
@@ -80,6 +161,27 @@ namespace OTAESGCM
              *    @param    output takes a pointer to an array to fill with plaintext, of size 16 bytes; never NULL
              */
             virtual void blockDecrypt(const uint8_t* input, const uint8_t* key, uint8_t *output) = 0;
+
+            /**
+             *    @brief    AES128 key setup for subsequent blockDecryptKeyed() calls
+             *    @param    key takes a pointer to a 128-bit (16-byte) secret key; never NULL
+             *
+             * The schedule is sensitive and is held until clearKey() is called.
+             */
+            virtual void setKey(const uint8_t *key) = 0;
+
+            /**
+             *    @brief    AES128 block decryption with the key from the last setKey()
+             *    @param    input takes a pointer to an array containing ciphertext, of size 16 bytes; never NULL
+             *    @param    output takes a pointer to an array to fill with plaintext, of size 16 bytes; never NULL
+             *
+             * Does nothing if no key is currently set.
+             * Re-entrant: modifies only output.
+             */
+            virtual void blockDecryptKeyed(const uint8_t* input, uint8_t *output) const = 0;
+
+            // Securely wipe any key schedule held from setKey(); safe to call repeatedly.
+            virtual void clearKey() = 0;
         };
 
 
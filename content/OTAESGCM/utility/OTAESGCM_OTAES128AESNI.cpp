@@ -0,0 +1,561 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* x86/x86-64 AES-NI AES(128) implementation with run-time fallback to the T-table code. */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "OTAESGCM_OTAES128AESNI.h"
+
+#ifdef OTAESGCM_X86_INTRINSICS
+
+#include <emmintrin.h>
+#include <smmintrin.h>
+#include <wmmintrin.h>
+
+#include "OTAESGCM_GHASHCLMULInline.h"
+
+// Functions using the intrinsics are compiled for these extensions
+// without needing global compiler flags; they are only called after a CPUID check.
+#define OTAESGCM_TARGET_AESNI __attribute__((target("aes,sse4.1")))
+#define OTAESGCM_TARGET_AESNI_CLMUL __attribute__((target("aes,pclmul,sse4.1")))
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+/*****************************************************************************/
+/* Defines:                                                                  */
+/*****************************************************************************/
+// The number of rounds in AES Cipher.
+#define Nr 10
+// the size of the AES block in bytes. (128/8)
+#define AES_BLOCK_SIZE 16
+// Counter blocks kept in flight by ctr32EncryptKeyed().
+#define CTR_LANES 8
+
+
+/*****************************************************************************/
+/* Private functions:                                                        */
+/*****************************************************************************/
+
+// One step of the AES128 key schedule, given the AESKEYGENASSIST output for it.
+OTAESGCM_TARGET_AESNI
+static inline __m128i keyExpandStep(__m128i key, __m128i keygened)
+  {
+  keygened = _mm_shuffle_epi32(keygened, _MM_SHUFFLE(3,3,3,3));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+  return(_mm_xor_si128(key, keygened));
+  }
+
+// Expand key to 11 round keys in rk (176 bytes, unaligned).
+// AESKEYGENASSIST needs an immediate round constant, hence the unrolling.
+OTAESGCM_TARGET_AESNI
+static void keyExpand(const uint8_t *key, uint8_t *rk)
+  {
+  __m128i k = _mm_loadu_si128((const __m128i *)key);
+  _mm_storeu_si128((__m128i *)(rk +   0), k);
+#define OTAESGCM_EXPAND(i, rcon) \
+  k = keyExpandStep(k, _mm_aeskeygenassist_si128(k, rcon)); \
+  _mm_storeu_si128((__m128i *)(rk + 16*(i)), k);
+  OTAESGCM_EXPAND(1, 0x01)
+  OTAESGCM_EXPAND(2, 0x02)
+  OTAESGCM_EXPAND(3, 0x04)
+  OTAESGCM_EXPAND(4, 0x08)
+  OTAESGCM_EXPAND(5, 0x10)
+  OTAESGCM_EXPAND(6, 0x20)
+  OTAESGCM_EXPAND(7, 0x40)
+  OTAESGCM_EXPAND(8, 0x80)
+  OTAESGCM_EXPAND(9, 0x1b)
+  OTAESGCM_EXPAND(10, 0x36)
+#undef OTAESGCM_EXPAND
+  }
+
+// Encrypt one block.
+OTAESGCM_TARGET_AESNI
+static inline __m128i encryptBlock(const uint8_t *rk, __m128i b)
+  {
+  b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i *)rk));
+  for(uint8_t round = 1; round < Nr; ++round)
+    { b = _mm_aesenc_si128(b, _mm_loadu_si128((const __m128i *)(rk + 16*round))); }
+  return(_mm_aesenclast_si128(b, _mm_loadu_si128((const __m128i *)(rk + 16*Nr))));
+  }
+
+// Derive the equivalent inverse cipher's round keys 1..Nr-1 into dk.
+OTAESGCM_TARGET_AESNI
+static void decKeyDerive(const uint8_t *rk, uint8_t *dk)
+  {
+  for(uint8_t round = 1; round < Nr; ++round)
+    {
+    _mm_storeu_si128((__m128i *)(dk + 16*(round - 1)),
+                     _mm_aesimc_si128(_mm_loadu_si128((const __m128i *)(rk + 16*round))));
+    }
+  }
+
+// Decrypt one block with the equivalent inverse cipher, its middle round keys from dk.
+OTAESGCM_TARGET_AESNI
+static inline __m128i decryptBlock(const uint8_t *rk, const uint8_t *dk, __m128i b)
+  {
+  b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i *)(rk + 16*Nr)));
+  for(uint8_t round = Nr - 1; round > 0; --round)
+    { b = _mm_aesdec_si128(b, _mm_loadu_si128((const __m128i *)(dk + 16*(round - 1)))); }
+  return(_mm_aesdeclast_si128(b, _mm_loadu_si128((const __m128i *)rk)));
+  }
+
+// Load/store bytes 12..15 of a counter block as a big-endian 32-bit value.
+static inline uint32_t getCtr32(const uint8_t *ctrBlock)
+  { return((uint32_t(ctrBlock[12]) << 24) | (uint32_t(ctrBlock[13]) << 16) | (uint32_t(ctrBlock[14]) << 8) | uint32_t(ctrBlock[15])); }
+static inline void putCtr32(uint8_t *ctrBlock, uint32_t c)
+  { ctrBlock[12] = uint8_t(c >> 24); ctrBlock[13] = uint8_t(c >> 16); ctrBlock[14] = uint8_t(c >> 8); ctrBlock[15] = uint8_t(c); }
+
+// Counter mode over whole blocks, CTR_LANES blocks in flight at a time then singly.
+OTAESGCM_TARGET_AESNI
+static void ctr32Encrypt(const uint8_t *rk, uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks)
+  {
+  const __m128i base = _mm_loadu_si128((const __m128i *)ctrBlock);
+  uint32_t c = getCtr32(ctrBlock);
+  // Byte-swap the low 32-bit lane into big-endian counter order.
+#define OTAESGCM_CTRBLOCK(n) _mm_insert_epi32(base, int(__builtin_bswap32(uint32_t(n))), 3)
+
+  while(nBlocks >= CTR_LANES)
+    {
+    __m128i k = _mm_loadu_si128((const __m128i *)rk);
+    __m128i b0 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c    ), k);
+    __m128i b1 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 1), k);
+    __m128i b2 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 2), k);
+    __m128i b3 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 3), k);
+    __m128i b4 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 4), k);
+    __m128i b5 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 5), k);
+    __m128i b6 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 6), k);
+    __m128i b7 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 7), k);
+    for(uint8_t round = 1; round < Nr; ++round)
+      {
+      k = _mm_loadu_si128((const __m128i *)(rk + 16*round));
+      b0 = _mm_aesenc_si128(b0, k); b1 = _mm_aesenc_si128(b1, k);
+      b2 = _mm_aesenc_si128(b2, k); b3 = _mm_aesenc_si128(b3, k);
+      b4 = _mm_aesenc_si128(b4, k); b5 = _mm_aesenc_si128(b5, k);
+      b6 = _mm_aesenc_si128(b6, k); b7 = _mm_aesenc_si128(b7, k);
+      }
+    k = _mm_loadu_si128((const __m128i *)(rk + 16*Nr));
+    b0 = _mm_aesenclast_si128(b0, k); b1 = _mm_aesenclast_si128(b1, k);
+    b2 = _mm_aesenclast_si128(b2, k); b3 = _mm_aesenclast_si128(b3, k);
+    b4 = _mm_aesenclast_si128(b4, k); b5 = _mm_aesenclast_si128(b5, k);
+    b6 = _mm_aesenclast_si128(b6, k); b7 = _mm_aesenclast_si128(b7, k);
+    const __m128i *in = (const __m128i *)input;
+    __m128i *out = (__m128i *)output;
+    _mm_storeu_si128(out    , _mm_xor_si128(b0, _mm_loadu_si128(in    )));
+    _mm_storeu_si128(out + 1, _mm_xor_si128(b1, _mm_loadu_si128(in + 1)));
+    _mm_storeu_si128(out + 2, _mm_xor_si128(b2, _mm_loadu_si128(in + 2)));
+    _mm_storeu_si128(out + 3, _mm_xor_si128(b3, _mm_loadu_si128(in + 3)));
+    _mm_storeu_si128(out + 4, _mm_xor_si128(b4, _mm_loadu_si128(in + 4)));
+    _mm_storeu_si128(out + 5, _mm_xor_si128(b5, _mm_loadu_si128(in + 5)));
+    _mm_storeu_si128(out + 6, _mm_xor_si128(b6, _mm_loadu_si128(in + 6)));
+    _mm_storeu_si128(out + 7, _mm_xor_si128(b7, _mm_loadu_si128(in + 7)));
+    c += CTR_LANES;
+    input += CTR_LANES * AES_BLOCK_SIZE;
+    output += CTR_LANES * AES_BLOCK_SIZE;
+    nBlocks -= CTR_LANES;
+    }
+
+  while(nBlocks-- > 0)
+    {
+    const __m128i ks = encryptBlock(rk, OTAESGCM_CTRBLOCK(c));
+    _mm_storeu_si128((__m128i *)output, _mm_xor_si128(ks, _mm_loadu_si128((const __m128i *)input)));
+    ++c;
+    input += AES_BLOCK_SIZE;
+    output += AES_BLOCK_SIZE;
+    }
+#undef OTAESGCM_CTRBLOCK
+
+  putCtr32(ctrBlock, c);
+  }
+
+// Independent blocks, CTR_LANES blocks in flight at a time then singly.
+OTAESGCM_TARGET_AESNI
+static void ecbEncrypt(const uint8_t *rk, const uint8_t *input, uint8_t *output, size_t nBlocks)
+  {
+  while(nBlocks >= CTR_LANES)
+    {
+    const __m128i *in = (const __m128i *)input;
+    __m128i *out = (__m128i *)output;
+    __m128i k = _mm_loadu_si128((const __m128i *)rk);
+    __m128i b0 = _mm_xor_si128(_mm_loadu_si128(in    ), k);
+    __m128i b1 = _mm_xor_si128(_mm_loadu_si128(in + 1), k);
+    __m128i b2 = _mm_xor_si128(_mm_loadu_si128(in + 2), k);
+    __m128i b3 = _mm_xor_si128(_mm_loadu_si128(in + 3), k);
+    __m128i b4 = _mm_xor_si128(_mm_loadu_si128(in + 4), k);
+    __m128i b5 = _mm_xor_si128(_mm_loadu_si128(in + 5), k);
+    __m128i b6 = _mm_xor_si128(_mm_loadu_si128(in + 6), k);
+    __m128i b7 = _mm_xor_si128(_mm_loadu_si128(in + 7), k);
+    for(uint8_t round = 1; round < Nr; ++round)
+      {
+      k = _mm_loadu_si128((const __m128i *)(rk + 16*round));
+      b0 = _mm_aesenc_si128(b0, k); b1 = _mm_aesenc_si128(b1, k);
+      b2 = _mm_aesenc_si128(b2, k); b3 = _mm_aesenc_si128(b3, k);
+      b4 = _mm_aesenc_si128(b4, k); b5 = _mm_aesenc_si128(b5, k);
+      b6 = _mm_aesenc_si128(b6, k); b7 = _mm_aesenc_si128(b7, k);
+      }
+    k = _mm_loadu_si128((const __m128i *)(rk + 16*Nr));
+    _mm_storeu_si128(out    , _mm_aesenclast_si128(b0, k));
+    _mm_storeu_si128(out + 1, _mm_aesenclast_si128(b1, k));
+    _mm_storeu_si128(out + 2, _mm_aesenclast_si128(b2, k));
+    _mm_storeu_si128(out + 3, _mm_aesenclast_si128(b3, k));
+    _mm_storeu_si128(out + 4, _mm_aesenclast_si128(b4, k));
+    _mm_storeu_si128(out + 5, _mm_aesenclast_si128(b5, k));
+    _mm_storeu_si128(out + 6, _mm_aesenclast_si128(b6, k));
+    _mm_storeu_si128(out + 7, _mm_aesenclast_si128(b7, k));
+    input += CTR_LANES * AES_BLOCK_SIZE;
+    output += CTR_LANES * AES_BLOCK_SIZE;
+    nBlocks -= CTR_LANES;
+    }
+
+  while(nBlocks-- > 0)
+    {
+    _mm_storeu_si128((__m128i *)output, encryptBlock(rk, _mm_loadu_si128((const __m128i *)input)));
+    input += AES_BLOCK_SIZE;
+    output += AES_BLOCK_SIZE;
+    }
+  }
+
+// Up to CTR_LANES independent blocks each under its own key schedule rk[i], all in flight together;
+// AESENC does not care which schedule each lane uses.
+// Lanes beyond nBlocks repeat the last block and are not stored: still quicker than running blocks singly.
+OTAESGCM_TARGET_AESNI
+static void ecbEncryptMulti(const uint8_t *const *rk, const uint8_t *input, uint8_t *output, const size_t nBlocks)
+  {
+  const uint8_t *k[CTR_LANES];
+  const __m128i *in[CTR_LANES];
+  for(size_t l = 0; l < CTR_LANES; ++l)
+    {
+    const size_t i = (l < nBlocks) ? l : (nBlocks - 1);
+    k[l] = rk[i];
+    in[l] = (const __m128i *)(input + i * AES_BLOCK_SIZE);
+    }
+  __m128i *out = (__m128i *)output;
+  __m128i b0 = _mm_xor_si128(_mm_loadu_si128(in[0]), _mm_loadu_si128((const __m128i *)k[0]));
+  __m128i b1 = _mm_xor_si128(_mm_loadu_si128(in[1]), _mm_loadu_si128((const __m128i *)k[1]));
+  __m128i b2 = _mm_xor_si128(_mm_loadu_si128(in[2]), _mm_loadu_si128((const __m128i *)k[2]));
+  __m128i b3 = _mm_xor_si128(_mm_loadu_si128(in[3]), _mm_loadu_si128((const __m128i *)k[3]));
+  __m128i b4 = _mm_xor_si128(_mm_loadu_si128(in[4]), _mm_loadu_si128((const __m128i *)k[4]));
+  __m128i b5 = _mm_xor_si128(_mm_loadu_si128(in[5]), _mm_loadu_si128((const __m128i *)k[5]));
+  __m128i b6 = _mm_xor_si128(_mm_loadu_si128(in[6]), _mm_loadu_si128((const __m128i *)k[6]));
+  __m128i b7 = _mm_xor_si128(_mm_loadu_si128(in[7]), _mm_loadu_si128((const __m128i *)k[7]));
+  for(uint8_t round = 1; round < Nr; ++round)
+    {
+    const size_t o = 16 * (size_t)round;
+    b0 = _mm_aesenc_si128(b0, _mm_loadu_si128((const __m128i *)(k[0] + o)));
+    b1 = _mm_aesenc_si128(b1, _mm_loadu_si128((const __m128i *)(k[1] + o)));
+    b2 = _mm_aesenc_si128(b2, _mm_loadu_si128((const __m128i *)(k[2] + o)));
+    b3 = _mm_aesenc_si128(b3, _mm_loadu_si128((const __m128i *)(k[3] + o)));
+    b4 = _mm_aesenc_si128(b4, _mm_loadu_si128((const __m128i *)(k[4] + o)));
+    b5 = _mm_aesenc_si128(b5, _mm_loadu_si128((const __m128i *)(k[5] + o)));
+    b6 = _mm_aesenc_si128(b6, _mm_loadu_si128((const __m128i *)(k[6] + o)));
+    b7 = _mm_aesenc_si128(b7, _mm_loadu_si128((const __m128i *)(k[7] + o)));
+    }
+  const size_t o = 16 * Nr;
+  _mm_storeu_si128(out, _mm_aesenclast_si128(b0, _mm_loadu_si128((const __m128i *)(k[0] + o))));
+  if(nBlocks > 1) { _mm_storeu_si128(out + 1, _mm_aesenclast_si128(b1, _mm_loadu_si128((const __m128i *)(k[1] + o)))); }
+  if(nBlocks > 2) { _mm_storeu_si128(out + 2, _mm_aesenclast_si128(b2, _mm_loadu_si128((const __m128i *)(k[2] + o)))); }
+  if(nBlocks > 3) { _mm_storeu_si128(out + 3, _mm_aesenclast_si128(b3, _mm_loadu_si128((const __m128i *)(k[3] + o)))); }
+  if(nBlocks > 4) { _mm_storeu_si128(out + 4, _mm_aesenclast_si128(b4, _mm_loadu_si128((const __m128i *)(k[4] + o)))); }
+  if(nBlocks > 5) { _mm_storeu_si128(out + 5, _mm_aesenclast_si128(b5, _mm_loadu_si128((const __m128i *)(k[5] + o)))); }
+  if(nBlocks > 6) { _mm_storeu_si128(out + 6, _mm_aesenclast_si128(b6, _mm_loadu_si128((const __m128i *)(k[6] + o)))); }
+  if(nBlocks > 7) { _mm_storeu_si128(out + 7, _mm_aesenclast_si128(b7, _mm_loadu_si128((const __m128i *)(k[7] + o)))); }
+  }
+
+// Counter mode stitched with GHASH of the ciphertext side:
+// the PCLMULQDQs for one batch of CTR_LANES (= GHASH_HPOWERS) ciphertext blocks
+// are interleaved with the AESENCs for the next so that both units are kept busy.
+// When decrypting each batch of input is hashed alongside its own encryption,
+// when encrypting each batch of output is hashed alongside the following batch's.
+OTAESGCM_TARGET_AESNI_CLMUL
+static void ctr32EncryptHash(const uint8_t *rk, const uint8_t HPow[GHASH_HPOWERS][GHASH_BLOCK_SIZE],
+                             uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks,
+                             const bool hashInput, uint8_t *S)
+  {
+  static_assert(CTR_LANES == GHASH_HPOWERS, "one aggregated reduction per batch");
+  // Previous batch of ciphertext output not yet hashed (encrypting only); else NULL.
+  const uint8_t *pending = NULL;
+  // When encrypting the first batch has nothing to be stitched with.
+  if(!hashInput && (nBlocks >= 2 * CTR_LANES))
+    {
+    ctr32Encrypt(rk, ctrBlock, input, output, CTR_LANES);
+    pending = output;
+    input += CTR_LANES * AES_BLOCK_SIZE;
+    output += CTR_LANES * AES_BLOCK_SIZE;
+    nBlocks -= CTR_LANES;
+    }
+
+  const __m128i base = _mm_loadu_si128((const __m128i *)ctrBlock);
+  uint32_t c = getCtr32(ctrBlock);
+  __m128i y = loadReversed(S);
+#define OTAESGCM_CTRBLOCK(n) _mm_insert_epi32(base, int(__builtin_bswap32(uint32_t(n))), 3)
+  // One AES round across all lanes.
+#define OTAESGCM_ROUND(r) \
+    k = _mm_loadu_si128((const __m128i *)(rk + 16*(r))); \
+    b0 = _mm_aesenc_si128(b0, k); b1 = _mm_aesenc_si128(b1, k); \
+    b2 = _mm_aesenc_si128(b2, k); b3 = _mm_aesenc_si128(b3, k); \
+    b4 = _mm_aesenc_si128(b4, k); b5 = _mm_aesenc_si128(b5, k); \
+    b6 = _mm_aesenc_si128(b6, k); b7 = _mm_aesenc_si128(b7, k);
+  // Multiply block i of the batch being hashed by the matching power of H.
+#define OTAESGCM_MUL(i) \
+    mulAccumulate(acc, loadReversed(toHash + (i) * AES_BLOCK_SIZE), \
+                  _mm_loadu_si128((const __m128i *)HPow[GHASH_HPOWERS - 1 - (i)]));
+
+  // Each batch: Y' = (Y ^ X1).H^8 ^ X2.H^7 ^ ... ^ X8.H, one multiply per AES round.
+  while((nBlocks >= CTR_LANES) && (hashInput || (NULL != pending)))
+    {
+    const uint8_t *const toHash = hashInput ? input : pending;
+    Product256 acc = { _mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128() };
+    __m128i k = _mm_loadu_si128((const __m128i *)rk);
+    __m128i b0 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c    ), k);
+    __m128i b1 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 1), k);
+    __m128i b2 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 2), k);
+    __m128i b3 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 3), k);
+    __m128i b4 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 4), k);
+    __m128i b5 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 5), k);
+    __m128i b6 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 6), k);
+    __m128i b7 = _mm_xor_si128(OTAESGCM_CTRBLOCK(c + 7), k);
+    OTAESGCM_ROUND(1)
+    mulAccumulate(acc, _mm_xor_si128(y, loadReversed(toHash)),
+                  _mm_loadu_si128((const __m128i *)HPow[GHASH_HPOWERS - 1]));
+    OTAESGCM_ROUND(2) OTAESGCM_MUL(1)
+    OTAESGCM_ROUND(3) OTAESGCM_MUL(2)
+    OTAESGCM_ROUND(4) OTAESGCM_MUL(3)
+    OTAESGCM_ROUND(5) OTAESGCM_MUL(4)
+    OTAESGCM_ROUND(6) OTAESGCM_MUL(5)
+    OTAESGCM_ROUND(7) OTAESGCM_MUL(6)
+    OTAESGCM_ROUND(8) OTAESGCM_MUL(7)
+    OTAESGCM_ROUND(9)
+    y = reduce(acc);
+    k = _mm_loadu_si128((const __m128i *)(rk + 16*Nr));
+    b0 = _mm_aesenclast_si128(b0, k); b1 = _mm_aesenclast_si128(b1, k);
+    b2 = _mm_aesenclast_si128(b2, k); b3 = _mm_aesenclast_si128(b3, k);
+    b4 = _mm_aesenclast_si128(b4, k); b5 = _mm_aesenclast_si128(b5, k);
+    b6 = _mm_aesenclast_si128(b6, k); b7 = _mm_aesenclast_si128(b7, k);
+    const __m128i *in = (const __m128i *)input;
+    __m128i *out = (__m128i *)output;
+    _mm_storeu_si128(out    , _mm_xor_si128(b0, _mm_loadu_si128(in    )));
+    _mm_storeu_si128(out + 1, _mm_xor_si128(b1, _mm_loadu_si128(in + 1)));
+    _mm_storeu_si128(out + 2, _mm_xor_si128(b2, _mm_loadu_si128(in + 2)));
+    _mm_storeu_si128(out + 3, _mm_xor_si128(b3, _mm_loadu_si128(in + 3)));
+    _mm_storeu_si128(out + 4, _mm_xor_si128(b4, _mm_loadu_si128(in + 4)));
+    _mm_storeu_si128(out + 5, _mm_xor_si128(b5, _mm_loadu_si128(in + 5)));
+    _mm_storeu_si128(out + 6, _mm_xor_si128(b6, _mm_loadu_si128(in + 6)));
+    _mm_storeu_si128(out + 7, _mm_xor_si128(b7, _mm_loadu_si128(in + 7)));
+    if(!hashInput) { pending = output; }
+    c += CTR_LANES;
+    input += CTR_LANES * AES_BLOCK_SIZE;
+    output += CTR_LANES * AES_BLOCK_SIZE;
+    nBlocks -= CTR_LANES;
+    }
+#undef OTAESGCM_MUL
+#undef OTAESGCM_ROUND
+#undef OTAESGCM_CTRBLOCK
+
+  // Hash any last pending batch, then any remaining blocks unstitched.
+  storeReversed(S, y);
+  if(NULL != pending) { GHASHCLMULBlocks(HPow, GHASH_HPOWERS, pending, CTR_LANES, S); }
+  putCtr32(ctrBlock, c);
+  if(nBlocks > 0)
+    {
+    if(hashInput) { GHASHCLMULBlocks(HPow, GHASH_HPOWERS, input, nBlocks, S); }
+    ctr32Encrypt(rk, ctrBlock, input, output, nBlocks);
+    if(!hashInput) { GHASHCLMULBlocks(HPow, GHASH_HPOWERS, output, nBlocks, S); }
+    }
+  }
+
+// Single-block wrappers operating on byte arrays.
+OTAESGCM_TARGET_AESNI
+static void encryptBytes(const uint8_t *rk, const uint8_t *input, uint8_t *output)
+  { _mm_storeu_si128((__m128i *)output, encryptBlock(rk, _mm_loadu_si128((const __m128i *)input))); }
+OTAESGCM_TARGET_AESNI
+static void decryptBytes(const uint8_t *rk, const uint8_t *dk, const uint8_t *input, uint8_t *output)
+  { _mm_storeu_si128((__m128i *)output, decryptBlock(rk, dk, _mm_loadu_si128((const __m128i *)input))); }
+
+
+/*****************************************************************************/
+/* Public functions:                                                         */
+/*****************************************************************************/
+
+/**
+ *    @brief    AES128 block encryption
+ *    @param    input takes a pointer to an array containing plaintext
+ *    @param    key takes a pointer to a 128bit secret key
+ *    @param    output takes a pointer to an array to fill with ciphertext
+ *
+ * Cleans up internal sensitive state when done.
+ */
+void OTAES128E_AESNI::blockEncrypt(const uint8_t* input, const uint8_t* key, uint8_t* output)
+{
+  setKey(key);
+  blockEncryptKeyed(input, output);
+  // Clean up private state.
+  cleanup();
+}
+
+/**
+ *    @brief    AES128 key setup
+ *    @param    key takes a pointer to a 128bit secret key
+ */
+void OTAES128E_AESNI::setKey(const uint8_t* key)
+{
+  if(!useAESNI) { portable.setKey(key); return; }
+  // Abort if no workspace to avoid crashing..
+  if(NULL == RoundKey) { return; }
+  // Reject a missing key, dropping any previous one.
+  if(NULL == key) { cleanup(); return; }
+  keyExpand(key, RoundKey);
+  if(NULL != DecRoundKey) { decKeyDerive(RoundKey, DecRoundKey); }
+  keySet = true;
+}
+
+/**
+ *    @brief    AES128 block encryption with the key from setKey()
+ *    @param    input takes a pointer to an array containing plaintext
+ *    @param    output takes a pointer to an array to fill with ciphertext
+ */
+void OTAES128E_AESNI::blockEncryptKeyed(const uint8_t* input, uint8_t* output) const
+{
+  if(!useAESNI) { portable.blockEncryptKeyed(input, output); return; }
+  // Abort if no key schedule to avoid crashing..
+  if((NULL == RoundKey) || !keySet) { return; }
+  encryptBytes(RoundKey, input, output);
+}
+
+/**
+ *    @brief    AES128 counter-mode encryption of whole blocks with the key from setKey()
+ *    @param    ctrBlock counter block, advanced by nBlocks on return
+ *    @param    input takes a pointer to nBlocks*16 bytes of input
+ *    @param    output takes a pointer to nBlocks*16 bytes of output; may be the same as input
+ *    @param    nBlocks number of whole blocks
+ */
+void OTAES128E_AESNI::ctr32EncryptKeyed(uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks) const
+{
+  if(!useAESNI) { portable.ctr32EncryptKeyed(ctrBlock, input, output, nBlocks); return; }
+  // Abort if no key schedule to avoid crashing..
+  if((NULL == RoundKey) || !keySet) { return; }
+  ctr32Encrypt(RoundKey, ctrBlock, input, output, nBlocks);
+}
+
+/**
+ *    @brief    AES128 encryption of independent blocks with the key from setKey()
+ *    @param    input takes a pointer to nBlocks*16 bytes of input
+ *    @param    output takes a pointer to nBlocks*16 bytes of output; may be the same as input
+ *    @param    nBlocks number of whole blocks
+ */
+void OTAES128E_AESNI::ecbEncryptKeyed(const uint8_t *input, uint8_t *output, size_t nBlocks) const
+{
+  if(!useAESNI) { portable.ecbEncryptKeyed(input, output, nBlocks); return; }
+  // Abort if no key schedule to avoid crashing..
+  if((NULL == RoundKey) || !keySet) { return; }
+  ecbEncrypt(RoundKey, input, output, nBlocks);
+}
+
+/**
+ *    @brief    AES128 counter-mode encryption of whole blocks stitched with PCLMULQDQ GHASH of the ciphertext side
+ *    @param    ctrBlock counter block, advanced by nBlocks on return
+ *    @param    input takes a pointer to nBlocks*16 bytes of input
+ *    @param    output takes a pointer to nBlocks*16 bytes of output; may be the same as input
+ *    @param    nBlocks number of whole blocks
+ *    @param    hk GHASH key
+ *    @param    hashInput true to hash the input, else the output
+ *    @param    S 16 byte running GHASH, updated in place
+ *    @retval   true if done, false (having done nothing) if not all of AES-NI, PCLMULQDQ and a key are in use
+ */
+bool OTAES128E_AESNI::ctr32EncryptHashKeyed(uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks,
+                                            const GHASHKey *hk, const bool hashInput, uint8_t *S) const
+{
+  // Stitch only when both the AES-NI and PCLMULQDQ paths are live, with all the powers of H.
+  if(!useAESNI || !hk->useCLMUL || (GHASH_HPOWERS != hk->nHPow) || (NULL == RoundKey) || !keySet) { return(false); }
+  ctr32EncryptHash(RoundKey, hk->HPow, ctrBlock, input, output, nBlocks, hashInput, S);
+  return(true);
+}
+
+/**
+ *    @brief    AES128 encryption of independent blocks, each under its own engine's key
+ *    @param    engines array of nBlocks engines, engines[i] holding the key for block i; never NULL
+ *    @param    input takes a pointer to nBlocks*16 bytes of input
+ *    @param    output takes a pointer to nBlocks*16 bytes of output; may be the same as input
+ *    @param    nBlocks number of blocks
+ *    @retval   true if done; false (having done nothing) unless every engine has AES-NI in use and a key set
+ */
+bool OTAES128E_AESNI::ecbEncryptMultiKeyed(const OTAES128E_AESNI *const *engines,
+                                           const uint8_t *input, uint8_t *output, size_t nBlocks)
+{
+  for(size_t i = 0; i < nBlocks; ++i)
+    {
+    const OTAES128E_AESNI *const e = engines[i];
+    if((NULL == e) || !e->useAESNI || (NULL == e->RoundKey) || !e->keySet) { return(false); }
+    }
+  while(nBlocks > 0)
+    {
+    const size_t n = (nBlocks < CTR_LANES) ? nBlocks : CTR_LANES;
+    const uint8_t *rk[CTR_LANES];
+    // A group all under one key takes the single-schedule kernel, which loads each round key once.
+    bool oneKey = true;
+    for(size_t i = 0; i < n; ++i) { rk[i] = engines[i]->RoundKey; oneKey = oneKey && (rk[i] == rk[0]); }
+    if(oneKey) { ecbEncrypt(rk[0], input, output, n); }
+    else { ecbEncryptMulti(rk, input, output, n); }
+    engines += n;
+    input += n * AES_BLOCK_SIZE;
+    output += n * AES_BLOCK_SIZE;
+    nBlocks -= n;
+    }
+  return(true);
+}
+
+
+/**
+ *    @brief    AES128 block decryption
+ *    @param    input takes a pointer to an array containing ciphertext
+ *    @param    key takes a pointer to a 128bit secret key
+ *    @param    output takes a pointer to an array to fill with plaintext
+ *
+ * Cleans up internal sensitive state when done.
+ */
+void OTAES128DE_AESNI::blockDecrypt(const uint8_t* input, const uint8_t* key, uint8_t *output)
+{
+  setKey(key);
+  blockDecryptKeyed(input, output);
+  // Clean up private state.
+  cleanup();
+}
+
+/**
+ *    @brief    AES128 block decryption with the key from setKey()
+ *    @param    input takes a pointer to an array containing ciphertext
+ *    @param    output takes a pointer to an array to fill with plaintext
+ */
+void OTAES128DE_AESNI::blockDecryptKeyed(const uint8_t* input, uint8_t *output) const
+{
+  if(!useAESNI) { portable.blockDecryptKeyed(input, output); return; }
+  // Abort if no key schedule to avoid crashing..
+  if((NULL == RoundKey) || (NULL == DecRoundKey) || !keySet) { return; }
+  decryptBytes(RoundKey, DecRoundKey, input, output);
+}
+
+
+    }
+
+#endif // OTAESGCM_X86_INTRINSICS
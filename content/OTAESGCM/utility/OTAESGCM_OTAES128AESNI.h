@@ -0,0 +1,194 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* x86/x86-64 AES-NI AES(128) implementation with run-time fallback to the T-table code. */
+
+#ifndef ARDUINO_LIB_OTAESGCM_OTAES128AESNI_H
+#define ARDUINO_LIB_OTAESGCM_OTAES128AESNI_H
+
+#include <stdint.h>
+#include <string.h>
+#include "OTAESGCM_OTAES128.h"
+#include "OTAESGCM_OTAES128TTable.h"
+#include "OTAESGCM_CPUFeatures.h"
+#include "OTAESGCM_GHASH.h"
+
+#ifdef OTAESGCM_X86_INTRINSICS
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+    // AES-NI encrypt-only implementation.
+    // Uses AESENC/AESKEYGENASSIST when CPUID reports AES-NI at construction,
+    // else falls back to the portable T-table implementation on the same workspace.
+    // Counter mode keeps 8 blocks in flight to hide AESENC latency.
+    // Neither re-entrant nor ISR-safe except where stated.
+    // Carries workspace but logically no state is carried from one operation to the next
+    // except for the key schedule held between setKey() and clearKey().
+    // Residual state should be regarded as sensitive, and eg overwritten before being released to heap.
+    class OTAES128E_AESNI : public OTAES128E
+        {
+        protected:
+            // Size of RoundKey (bytes).
+            static constexpr uint8_t RoundKeySize = 176;
+            // Size of DecRoundKey (bytes).
+            static constexpr uint8_t DecRoundKeySize = 144;
+
+            // Nr+1 round keys as 11 16-byte blocks, not necessarily aligned;
+            // NULL if insufficent workspace is passed in.
+            // Should be cleared before releasing space to (say) heap.
+            uint8_t * const RoundKey;
+            // AESIMC of round keys 1..Nr-1 for AESDEC, as 9 16-byte blocks, not necessarily aligned,
+            // derived by setKey(); NULL unless decrypting with sufficient workspace.
+            // Should be cleared before releasing space to (say) heap.
+            uint8_t * const DecRoundKey;
+            // True if AES-NI is in use, else the portable fallback is.
+            const bool useAESNI;
+            // True while RoundKey (and any DecRoundKey) holds an AES-NI expanded key.
+            bool keySet;
+            // Portable fallback, sharing the workspace; used iff !useAESNI.
+            OTAES128DE_TTable portable;
+
+            // Construct an instance also deriving the decryption round keys
+            // (or letting the fallback do so) if decrypt is true and the workspace allows.
+            OTAES128E_AESNI(uint8_t *const workspace, size_t workspaceLen, bool allowAESNI, bool decrypt)
+              : RoundKey((workspaceLen >= RoundKeySize) ? workspace : NULL),
+                DecRoundKey((decrypt && (workspaceLen >= OTAES128DE_TTable::workspaceRequired)) ? workspace + RoundKeySize : NULL),
+                useAESNI(allowAESNI && cpuHasAESNI()), keySet(false),
+                portable(workspace, decrypt ? workspaceLen : ((workspaceLen >= RoundKeySize) ? RoundKeySize : 0))
+                { }
+
+        public:
+            // External workspace/scratch required minimum size, unaligned; strictly positive.
+            // At the moment just enough to cover the RoundKey.
+            // This constant, defined per class, is effectively part of the API.
+            static constexpr uint8_t workspaceRequired = RoundKeySize;
+
+            // Construct an instance: supplied workspace must be large enough.
+            // If allowAESNI is false the portable fallback is always used (eg for testing).
+            OTAES128E_AESNI(uint8_t *const workspace, size_t workspaceLen, bool allowAESNI = true)
+              : OTAES128E_AESNI(workspace, workspaceLen, allowAESNI, false)
+                { }
+
+            // True if this instance is using the AES-NI instructions.
+            bool isUsingAESNI() const { return(useAESNI); }
+
+            // Clean up sensitive state.
+            // If no key is held then assumed to already have been done and is not repeated.
+            void cleanup()
+                {
+                if(!useAESNI) { portable.cleanup(); return; }
+                if((NULL == RoundKey) || !keySet) { return; }
+                memset(RoundKey, 0, RoundKeySize);
+                if(NULL != DecRoundKey) { memset(DecRoundKey, 0, DecRoundKeySize); }
+                keySet = false;
+                }
+
+            /**
+             *    @brief    AES128 block encryption
+             *    @param    input takes a pointer to an array containing plaintext, of size 16 bytes; never NULL
+             *    @param    key takes a pointer to a 128-bit (16-byte) secret key; never NULL
+             *    @param    output takes a pointer to an array to fill with ciphertext, of size 16 bytes; never NULL
+             *
+             * Cleans up internal sensitive state when done.
+             */
+            virtual void blockEncrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
+
+            // Expand key into RoundKey (and any DecRoundKey); held until clearKey().
+            virtual void setKey(const uint8_t *key);
+            // Encrypt one block with the RoundKey held from setKey().
+            virtual void blockEncryptKeyed(const uint8_t* input, uint8_t *output) const;
+            // Wipe RoundKey.
+            virtual void clearKey() { cleanup(); }
+            // Counter mode over whole blocks, 8 (then 1) blocks at a time.
+            virtual void ctr32EncryptKeyed(uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks) const;
+            // Independent blocks, 8 (then 1) blocks at a time.
+            virtual void ecbEncryptKeyed(const uint8_t *input, uint8_t *output, size_t nBlocks) const;
+            // This engine when AES-NI is in use, else NULL.
+            virtual const OTAES128E_AESNI *getAESNI() const { return(useAESNI ? this : NULL); }
+
+            /**
+             *    @brief    AES128 counter-mode encryption of whole blocks stitched with PCLMULQDQ GHASH
+             *    @param    ctrBlock, input, output, nBlocks as for ctr32EncryptKeyed()
+             *    @param    hk GHASH key; never NULL
+             *    @param    hashInput true to hash the input (ie decrypting, before any in-place overwrite), else the output
+             *    @param    S 16 byte running GHASH, updated in place; never NULL
+             *    @retval   true if done; false (having done nothing) unless AES-NI, PCLMULQDQ (with all GHASH_HPOWERS powers of H) and a key are all in use
+             *
+             * Not virtual: the GCM layer reaches it through getAESNI() on x86 builds only.
+             */
+            bool ctr32EncryptHashKeyed(uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks,
+                                       const GHASHKey *hk, bool hashInput, uint8_t *S) const;
+
+            /**
+             *    @brief    AES128 encryption of independent blocks, block i under engines[i]'s key
+             *    @param    engines array of nBlocks engines; never NULL
+             *    @param    input, output, nBlocks as for ecbEncryptKeyed()
+             *    @retval   true if done; false (having done nothing) unless every engine has AES-NI in use and a key set
+             *
+             * Eg for the counter blocks of a batch of short frames each under its own key:
+             * blocks are kept 8 in flight whichever schedules they use.
+             */
+            static bool ecbEncryptMultiKeyed(const OTAES128E_AESNI *const *engines,
+                                             const uint8_t *input, uint8_t *output, size_t nBlocks);
+        };
+
+    // AES-NI decrypt and encrypt implementation.
+    // Uses AESDEC in the equivalent inverse cipher, with its round keys derived once
+    // with AESIMC by setKey() into the workspace after the encryption schedule
+    // (where the portable fallback keeps its own).
+    // Neither re-entrant nor ISR-safe except where stated.
+    // Residual state should be regarded as sensitive, and eg overwritten before being released to heap.
+    class OTAES128DE_AESNI final : public OTAES128D, public OTAES128E_AESNI
+        {
+        public:
+            // External workspace/scratch required minimum size, unaligned; strictly positive.
+            // Enough to cover the RoundKey and DecRoundKey, as for the portable fallback.
+            // This constant, defined per class, is effectively part of the API.
+            static constexpr uint16_t workspaceRequired = OTAES128DE_TTable::workspaceRequired;
+
+            // Construct an instance: supplied workspace must be large enough to decrypt.
+            // If allowAESNI is false the portable fallback is always used (eg for testing).
+            OTAES128DE_AESNI(uint8_t *const workspace, size_t workspaceLen, bool allowAESNI = true)
+              : OTAES128E_AESNI(workspace, workspaceLen, allowAESNI, true)
+                { }
+
+            /**
+             *    @brief    AES128 block decryption
+             *    @param    input takes a pointer to an array containing ciphertext, of size 16 bytes; never NULL
+             *    @param    key takes a pointer to a 128-bit (16-byte) secret key; never NULL
+             *    @param    output takes a pointer to an array to fill with plaintext, of size 16 bytes; never NULL
+             *
+             * Cleans up internal sensitive state when done.
+             */
+            virtual void blockDecrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
+
+            // Keyed operations: setKey() prepares both directions.
+            virtual void setKey(const uint8_t *key) override { OTAES128E_AESNI::setKey(key); }
+            virtual void blockDecryptKeyed(const uint8_t* input, uint8_t *output) const override;
+            virtual void clearKey() override { OTAES128E_AESNI::clearKey(); }
+        };
+
+
+    }
+
+#endif // OTAESGCM_X86_INTRINSICS
+
+#endif
@@ -177,10 +177,11 @@ static uint8_t getSBoxValue(uint8_t num)
 }
 
 /**
- * @brief    Fills RoundKey with key expansion of Key
+ * @brief    Fills RoundKey with key expansion of key
+ * @param    key    128-bit (16-byte) secret key; never NULL
  */
 // This function produces Nb(Nr+1) round keys. The round keys are used in each round to decrypt the states.
-void OTAES128E_AVR::KeyExpansion(void)
+void OTAES128E_AVR::KeyExpansion(const uint8_t *const key)
 {
   uint32_t i, j, k;
   uint8_t tempa[4]; // Used for the column/row operations
@@ -188,10 +189,10 @@ void OTAES128E_AVR::KeyExpansion(void)
   // The first round key is the key itself.
   for(i = 0; i < Nk; ++i)
   {
-    RoundKey[(i * 4) + 0] = Key[(i * 4) + 0];
-    RoundKey[(i * 4) + 1] = Key[(i * 4) + 1];
-    RoundKey[(i * 4) + 2] = Key[(i * 4) + 2];
-    RoundKey[(i * 4) + 3] = Key[(i * 4) + 3];
+    RoundKey[(i * 4) + 0] = key[(i * 4) + 0];
+    RoundKey[(i * 4) + 1] = key[(i * 4) + 1];
+    RoundKey[(i * 4) + 2] = key[(i * 4) + 2];
+    RoundKey[(i * 4) + 3] = key[(i * 4) + 3];
   }
 
   // All other round keys are found from the previous round keys.
@@ -255,7 +256,7 @@ void OTAES128E_AVR::KeyExpansion(void)
  * @todo    is it worth removing nested loop? matrix should be stored in consecutive memory locations anyway
  * @param    round    current AES encryption round
  */
-void OTAES128E_AVR::AddRoundKey(uint8_t round)
+void OTAES128E_AVR::AddRoundKey(state_t *const state, const uint8_t round) const
 {
   uint8_t i,j;
   for(i=0;i<4;++i)
@@ -271,7 +272,7 @@ void OTAES128E_AVR::AddRoundKey(uint8_t round)
  * @brief    Substitute state matrix values with S-box values
  * @todo    is it worth removing nested loop? matrix should be stored in consecutive memory locations anyway
  */
-void OTAES128E_AVR::SubBytes(void)
+void OTAES128E_AVR::SubBytes(state_t *const state)
 {
   uint8_t i, j;
   for(i = 0; i < 4; ++i)
@@ -287,7 +288,7 @@ void OTAES128E_AVR::SubBytes(void)
  * @brief    shifts rows in state to the left by the row number (first row not shifted, last row shifted by 3)
  * @todo    is it worth removing nested loop? matrix should be stored in consecutive memory locations anyway
  */
-void OTAES128E_AVR::ShiftRows(void)
+void OTAES128E_AVR::ShiftRows(state_t *const state)
 {
   uint8_t temp;
 
@@ -350,7 +351,7 @@ static uint8_t Multiply(uint8_t x, uint8_t y)
  * @brief    mixes columns according AES spec
  * @todo    better description
  */
-void OTAES128E_AVR::MixColumns(void)
+void OTAES128E_AVR::MixColumns(state_t *const state)
 {
   uint8_t i;
   uint8_t Tmp,Tm,t;
@@ -368,29 +369,29 @@ void OTAES128E_AVR::MixColumns(void)
 /**
  * @brief    encrypts one 128 bit block
  */
-void OTAES128E_AVR::Cipher(void)
+void OTAES128E_AVR::Cipher(state_t *const state) const
 {
   uint8_t round = 0;
 
   // Add the First round key to the state before starting the rounds.
-  AddRoundKey(0);
+  AddRoundKey(state, 0);
 
   // There will be Nr rounds.
   // The first Nr-1 rounds are identical.
   // These Nr-1 rounds are executed in the loop below.
   for(round = 1; round < Nr; ++round)
   {
-    SubBytes();
-    ShiftRows();
-    MixColumns();
-    AddRoundKey(round);
+    SubBytes(state);
+    ShiftRows(state);
+    MixColumns(state);
+    AddRoundKey(state, round);
   }
 
   // The last round is given below.
   // The MixColumns function is not here in the last round.
-  SubBytes();
-  ShiftRows();
-  AddRoundKey(Nr);
+  SubBytes(state);
+  ShiftRows(state);
+  AddRoundKey(state, Nr);
 }
 
 //#ifndef NO_DECRYPT
@@ -411,7 +412,7 @@ static uint8_t getSBoxInvert(uint8_t num)
 /**
  * @brief    inverse mix columns for unencrypting data
  */
-void OTAES128DE_AVR::InvMixColumns(void)
+void OTAES128DE_AVR::InvMixColumns(state_t *const state)
 {
     // The method used to multiply may be difficult to understand for the inexperienced.
     // Please use the references to gain more information.
@@ -435,7 +436,7 @@ void OTAES128DE_AVR::InvMixColumns(void)
 /**
  * @brief    inverses S-box substitution of state
  */
-void OTAES128DE_AVR::InvSubBytes(void)
+void OTAES128DE_AVR::InvSubBytes(state_t *const state)
 {
   uint8_t i,j;
   for(i=0;i<4;++i)
@@ -450,7 +451,7 @@ void OTAES128DE_AVR::InvSubBytes(void)
 /**
  * @brief    inverse of shiftRows
  */
-void OTAES128DE_AVR::InvShiftRows(void)
+void OTAES128DE_AVR::InvShiftRows(state_t *const state)
 {
   uint8_t temp;
 
@@ -481,29 +482,29 @@ void OTAES128DE_AVR::InvShiftRows(void)
 /**
  * @brief    decrypts one 128 bit block
  */
-void OTAES128DE_AVR::InvCipher(void)
+void OTAES128DE_AVR::InvCipher(state_t *const state) const
 {
   uint8_t round=0;
 
   // Add the First round key to the state before starting the rounds.
-  AddRoundKey(Nr);
+  AddRoundKey(state, Nr);
 
   // There will be Nr rounds.
   // The first Nr-1 rounds are identical.
   // These Nr-1 rounds are executed in the loop below.
   for(round=Nr-1;round>0;round--)
   {
-    InvShiftRows();
-    InvSubBytes();
-    AddRoundKey(round);
-    InvMixColumns();
+    InvShiftRows(state);
+    InvSubBytes(state);
+    AddRoundKey(state, round);
+    InvMixColumns(state);
   }
 
   // The last round is given below.
   // The MixColumns function is not here in the last round.
-  InvShiftRows();
-  InvSubBytes();
-  AddRoundKey(0);
+  InvShiftRows(state);
+  InvSubBytes(state);
+  AddRoundKey(state, 0);
 }
 //#endif // NO_DECRYPT
 
@@ -523,55 +524,85 @@ void OTAES128DE_AVR::InvCipher(void)
  */
 void OTAES128E_AVR::blockEncrypt(const uint8_t* input, const uint8_t* key, uint8_t* output)
 {
-  // Abort if no workspace to avoid crashing..
-  // TODO: find a way of signalling the problem.
-  if(NULL == RoundKey) { return; }
-
-  // Copy input to output, and work in-memory on output.
-  //BlockCopy(output, input);
-  memcpy(output, input, AES_BLOCK_SIZE);
-  state = (state_t*)output;
-
-  Key = key;
-  KeyExpansion();
+  setKey(key);
 
   // Encrypt the plaintext with the Key using the AES algorithm.
-  Cipher();
+  blockEncryptKeyed(input, output);
 
   // Clean up private state.
   cleanup();
 }
 
-
 /**
- *    @brief    AES128 block decryption
- *    @param    input takes a pointer to an array containing ciphertext
+ *    @brief    AES128 key setup
  *    @param    key takes a pointer to a 128bit secret key
- *    @param    output takes a pointer to an array to fill with plaintext
  *
- * Cleans up internal sensitive state when done.
+ * The expanded key is held in the workspace until clearKey()/cleanup().
  */
-void OTAES128DE_AVR::blockDecrypt(const uint8_t* input, const uint8_t* key, uint8_t *output)
+void OTAES128E_AVR::setKey(const uint8_t* key)
 {
   // Abort if no workspace to avoid crashing..
   // TODO: find a way of signalling the problem.
   if(NULL == RoundKey) { return; }
+  // Reject a missing key, dropping any previous one.
+  if(NULL == key) { cleanup(); return; }
+
+  // The KeyExpansion routine must be called before encryption.
+  KeyExpansion(key);
+  keySet = true;
+}
+
+/**
+ *    @brief    AES128 block encryption with the key from setKey()
+ *    @param    input takes a pointer to an array containing plaintext
+ *    @param    output takes a pointer to an array to fill with ciphertext
+ */
+void OTAES128E_AVR::blockEncryptKeyed(const uint8_t* input, uint8_t* output) const
+{
+  // Abort if no key schedule to avoid crashing..
+  if((NULL == RoundKey) || !keySet) { return; }
 
   // Copy input to output, and work in-memory on output.
   //BlockCopy(output, input);
-  memcpy(output, input, AES_BLOCK_SIZE);
-  state = (state_t*)output;
+  if(output != input) { memcpy(output, input, AES_BLOCK_SIZE); }
+  Cipher((state_t*)output);
+}
 
-  // The KeyExpansion routine must be called before encryption.
-  Key = key;
-  KeyExpansion();
 
-  InvCipher();
+/**
+ *    @brief    AES128 block decryption
+ *    @param    input takes a pointer to an array containing ciphertext
+ *    @param    key takes a pointer to a 128bit secret key
+ *    @param    output takes a pointer to an array to fill with plaintext
+ *
+ * Cleans up internal sensitive state when done.
+ */
+void OTAES128DE_AVR::blockDecrypt(const uint8_t* input, const uint8_t* key, uint8_t *output)
+{
+  setKey(key);
+
+  blockDecryptKeyed(input, output);
 
   // Clean up private state.
   cleanup();
 }
 
+/**
+ *    @brief    AES128 block decryption with the key from setKey()
+ *    @param    input takes a pointer to an array containing ciphertext
+ *    @param    output takes a pointer to an array to fill with plaintext
+ */
+void OTAES128DE_AVR::blockDecryptKeyed(const uint8_t* input, uint8_t *output) const
+{
+  // Abort if no key schedule to avoid crashing..
+  if((NULL == RoundKey) || !keySet) { return; }
+
+  // Copy input to output, and work in-memory on output.
+  //BlockCopy(output, input);
+  if(output != input) { memcpy(output, input, AES_BLOCK_SIZE); }
+  InvCipher((state_t*)output);
+}
+
 
     }
 
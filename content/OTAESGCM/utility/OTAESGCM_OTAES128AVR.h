@@ -43,24 +43,22 @@ namespace OTAESGCM
             // Size of RoundKey (bytes).
             static constexpr uint8_t RoundKeySize = 176;
 
-            // The AES key (128 bits, 16 bytes); never NULL.
-            // Note that Key is space passed in by caller.
-            const uint8_t *Key;
-            // Intermediate results during decryption.
+            // True while a key schedule is held in RoundKey.
+            bool keySet;
+            // Intermediate results during encryption/decryption,
+            // held in the caller's output block so that keyed operations need no mutable members.
             typedef uint8_t state_t[4][4];
-            // Note that state is space passed in by caller.
-            state_t *state;
             // Nr+1 round keys; NULL if insufficent workspace is passed in.
             // Should be cleared before releasing space to (say) heap.
             //uint8_t RoundKey[RoundKeySize];
             uint8_t * const RoundKey;
 
-            void KeyExpansion();
-            void AddRoundKey(uint8_t round);
-            void SubBytes();
-            void ShiftRows();
-            void MixColumns();
-            void Cipher();
+            void KeyExpansion(const uint8_t *key);
+            void AddRoundKey(state_t *state, uint8_t round) const;
+            static void SubBytes(state_t *state);
+            static void ShiftRows(state_t *state);
+            static void MixColumns(state_t *state);
+            void Cipher(state_t *state) const;
 
         public:
             // External workspace/scratch required minimum size, unaligned; strictly positive.
@@ -71,13 +69,13 @@ namespace OTAESGCM
 
             // Construct an instance: supplied workspace must be large enough.
             OTAES128E_AVR(uint8_t *const workspace, uint8_t workspaceLen)
-              : RoundKey((workspaceLen >= workspaceRequired) ? workspace : NULL)
+              : keySet(false), RoundKey((workspaceLen >= workspaceRequired) ? workspace : NULL)
                 { }
 
             // Clean up sensitive state and removes pointers to external state.
-            // If Key pointer already cleared then assumed to already have been done and is not repeated.
+            // If no key is set then assumed to already have been done and is not repeated.
             // NOT YET TESTED.
-            void cleanup() { if((NULL != RoundKey) && (NULL != Key)) { memset(RoundKey, 0, RoundKeySize); state=NULL; Key=NULL; } }
+            void cleanup() { if((NULL != RoundKey) && keySet) { memset(RoundKey, 0, RoundKeySize); keySet = false; } }
 
             /**
              *    @brief    AES128 block encryption
@@ -89,6 +87,13 @@ namespace OTAESGCM
              */
             virtual void blockEncrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
 
+            // Expand key into RoundKey; held until clearKey().
+            // A NULL key wipes any schedule held, so keyed operations then do nothing.
+            virtual void setKey(const uint8_t *key);
+            // Encrypt one block with the RoundKey held from setKey(); re-entrant.
+            virtual void blockEncryptKeyed(const uint8_t* input, uint8_t *output) const;
+            // Wipe RoundKey.
+            virtual void clearKey() { cleanup(); }
         };
 
     // AVR decrypt and encrypt implementation.
@@ -104,10 +109,10 @@ namespace OTAESGCM
             static constexpr uint8_t workspaceRequired = OTAES128E_AVR::workspaceRequired;
 
         protected:
-            void InvMixColumns();
-            void InvSubBytes();
-            void InvShiftRows();
-            void InvCipher();
+            static void InvMixColumns(state_t *state);
+            static void InvSubBytes(state_t *state);
+            static void InvShiftRows(state_t *state);
+            void InvCipher(state_t *state) const;
 
         public:
             // Expose (version of) base-class constructor.
@@ -122,6 +127,11 @@ namespace OTAESGCM
              * Cleans up internal sensitive state when done.
              */
             virtual void blockDecrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
+
+            // Keyed operations: the same RoundKey serves both directions.
+            virtual void setKey(const uint8_t *key) override { OTAES128E_AVR::setKey(key); }
+            virtual void blockDecryptKeyed(const uint8_t* input, uint8_t *output) const override;
+            virtual void clearKey() override { OTAES128E_AVR::clearKey(); }
         };
 
 
@@ -42,13 +42,22 @@ namespace OTAESGCM
 
 // Take this as a generic impl for MCUs.
 #include "OTAESGCM_OTAES128AVR.h"
+// 32-bit T-table impl for 32/64-bit hosts where ~8kB of tables is affordable.
+#include "OTAESGCM_OTAES128TTable.h"
+// AES-NI impl for x86 where supported by the compiler; checks the CPU at run time.
+#include "OTAESGCM_OTAES128AESNI.h"
 // Fast, small and default implementations, enc and enc+dec, for this architecture.
 namespace OTAESGCM
     {
-    typedef OTAES128E_AVR OTAES128E_fast_t;
+#ifdef OTAESGCM_X86_INTRINSICS
+    typedef OTAES128E_AESNI OTAES128E_fast_t;
+    typedef OTAES128DE_AESNI OTAES128DE_fast_t;
+#else
+    typedef OTAES128E_TTable OTAES128E_fast_t;
+    typedef OTAES128DE_TTable OTAES128DE_fast_t;
+#endif
     typedef OTAES128E_AVR OTAES128E_small_t;
     typedef OTAES128E_AVR OTAES128E_default_t;
-    typedef OTAES128DE_AVR OTAES128DE_fast_t;
     typedef OTAES128DE_AVR OTAES128DE_small_t;
     typedef OTAES128DE_AVR OTAES128DE_default_t;
     }
@@ -0,0 +1,151 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* 32-bit T-table AES(128) implementation for 32/64-bit hosts. */
+/* Trades ~8kB of constant tables for several times the speed of the byte-oriented code. */
+
+#ifndef ARDUINO_LIB_OTAESGCM_OTAES128TTABLE_H
+#define ARDUINO_LIB_OTAESGCM_OTAES128TTABLE_H
+
+#include <stdint.h>
+#include <string.h>
+#include "OTAESGCM_OTAES128.h"
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+    // 32-bit T-table encrypt-only implementation, for hosts with plenty of (cached) memory.
+    // Uses the Te0..Te3 round tables (and Te4 S-box for the final round).
+    // Neither re-entrant nor ISR-safe except where stated.
+    // Carries workspace but logically no state is carried from one operation to the next
+    // except for the key schedule held between setKey() and clearKey().
+    // Residual state should be regarded as sensitive, and eg overwritten before being released to heap.
+    // Note: table lookups are indexed by secret data, so this is not cache-timing resistant.
+    class OTAES128E_TTable : public OTAES128E
+        {
+        protected:
+            // Size of RoundKey (bytes).
+            static constexpr uint8_t RoundKeySize = 176;
+            // Size of DecRoundKey (bytes).
+            static constexpr uint8_t DecRoundKeySize = 144;
+
+            // Nr+1 round keys as 44 native 32-bit words, not necessarily aligned;
+            // NULL if insufficent workspace is passed in.
+            // Should be cleared before releasing space to (say) heap.
+            uint8_t * const RoundKey;
+            // InvMixColumns of round keys 1..Nr-1 for the equivalent inverse cipher,
+            // as 36 native 32-bit words, not necessarily aligned, derived by setKey();
+            // NULL unless decrypting with sufficient workspace.
+            // Should be cleared before releasing space to (say) heap.
+            uint8_t * const DecRoundKey;
+            // True while RoundKey (and any DecRoundKey) holds an expanded key.
+            bool keySet;
+
+            // Construct an instance also deriving the decryption round keys into decWorkspace
+            // (of DecRoundKeySize bytes) if that is not NULL.
+            OTAES128E_TTable(uint8_t *const workspace, uint8_t workspaceLen, uint8_t *const decWorkspace)
+              : RoundKey((workspaceLen >= RoundKeySize) ? workspace : NULL),
+                DecRoundKey((workspaceLen >= RoundKeySize) ? decWorkspace : NULL), keySet(false)
+                { }
+
+        public:
+            // External workspace/scratch required minimum size, unaligned; strictly positive.
+            // At the moment just enough to cover the RoundKey.
+            // This constant, defined per class, is effectively part of the API.
+            static constexpr uint8_t workspaceRequired = RoundKeySize;
+
+            // Construct an instance: supplied workspace must be large enough.
+            OTAES128E_TTable(uint8_t *const workspace, uint8_t workspaceLen)
+              : OTAES128E_TTable(workspace, workspaceLen, NULL)
+                { }
+
+            // Clean up sensitive state.
+            // If no key is held then assumed to already have been done and is not repeated.
+            void cleanup()
+                {
+                if((NULL == RoundKey) || !keySet) { return; }
+                memset(RoundKey, 0, RoundKeySize);
+                if(NULL != DecRoundKey) { memset(DecRoundKey, 0, DecRoundKeySize); }
+                keySet = false;
+                }
+
+            /**
+             *    @brief    AES128 block encryption
+             *    @param    input takes a pointer to an array containing plaintext, of size 16 bytes; never NULL
+             *    @param    key takes a pointer to a 128-bit (16-byte) secret key; never NULL
+             *    @param    output takes a pointer to an array to fill with ciphertext, of size 16 bytes; never NULL
+             *
+             * Cleans up internal sensitive state when done.
+             */
+            virtual void blockEncrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
+
+            // Expand key into RoundKey (and any DecRoundKey); held until clearKey().
+            virtual void setKey(const uint8_t *key);
+            // Encrypt one block with the RoundKey held from setKey().
+            virtual void blockEncryptKeyed(const uint8_t* input, uint8_t *output) const;
+            // Wipe RoundKey.
+            virtual void clearKey() { cleanup(); }
+            // Counter mode over whole blocks, sharing work between successive counters.
+            virtual void ctr32EncryptKeyed(uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks) const;
+        };
+
+    // 32-bit T-table decrypt and encrypt implementation.
+    // Uses the Td0..Td3 round tables (and Td4 inverse S-box for the final round)
+    // in the equivalent inverse cipher, with its round keys derived once by setKey()
+    // into the workspace after the encryption schedule.
+    // Neither re-entrant nor ISR-safe except where stated.
+    // Residual state should be regarded as sensitive, and eg overwritten before being released to heap.
+    class OTAES128DE_TTable final : public OTAES128D, public OTAES128E_TTable
+        {
+        public:
+            // External workspace/scratch required minimum size, unaligned; strictly positive.
+            // Enough to cover the RoundKey and DecRoundKey.
+            // This constant, defined per class, is effectively part of the API.
+            static constexpr uint16_t workspaceRequired = (uint16_t)RoundKeySize + DecRoundKeySize;
+
+            // Construct an instance: supplied workspace must be large enough to decrypt.
+            // With only OTAES128E_TTable::workspaceRequired bytes it can still encrypt,
+            // eg as the fallback for OTAES128E_AESNI.
+            OTAES128DE_TTable(uint8_t *const workspace, size_t workspaceLen)
+              : OTAES128E_TTable(workspace, (workspaceLen >= RoundKeySize) ? RoundKeySize : uint8_t(0),
+                                 (workspaceLen >= workspaceRequired) ? workspace + RoundKeySize : NULL)
+                { }
+
+            /**
+             *    @brief    AES128 block decryption
+             *    @param    input takes a pointer to an array containing ciphertext, of size 16 bytes; never NULL
+             *    @param    key takes a pointer to a 128-bit (16-byte) secret key; never NULL
+             *    @param    output takes a pointer to an array to fill with plaintext, of size 16 bytes; never NULL
+             *
+             * Cleans up internal sensitive state when done.
+             */
+            virtual void blockDecrypt(const uint8_t* input, const uint8_t* key, uint8_t *output);
+
+            // Keyed operations: setKey() prepares both directions.
+            virtual void setKey(const uint8_t *key) override { OTAES128E_TTable::setKey(key); }
+            virtual void blockDecryptKeyed(const uint8_t* input, uint8_t *output) const override;
+            virtual void clearKey() override { OTAES128E_TTable::clearKey(); }
+        };
+
+
+    }
+
+#endif
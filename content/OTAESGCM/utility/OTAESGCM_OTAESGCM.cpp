@@ -24,6 +24,11 @@ Author(s) / Copyright (s): Deniz Erbilgin 2015
 
 #include "OTAESGCM_OTAESGCM.h"
 
+#ifdef OTAESGCM_THREADS
+#include <thread>
+#include "OTAESGCM_OTAESGCMThreadPool.h"
+#endif
+
 
 // Use namespaces to help avoid collisions.
 namespace OTAESGCM
@@ -48,59 +53,37 @@ namespace OTAESGCM
 //
 /******************* Private Variables *******************/
 
-/******************* Private Functions *******************/
-/**
- * @note    xor_block
- * @brief    xor on 128bit block.
- * @param    dest:    pointer to destination
- * @param    src:    pointer to source
- */
-static void xorBlock(uint8_t *dest, const uint8_t *src)
-{
-    for(uint8_t i = 0; i < AES128GCM_BLOCK_SIZE; i++){
-        *dest++ ^= *src++;
-    }
-}
-
-/**
- * @note    shift_block_right
- * @brief    bitshifts 128bit block (16 byte array) right once
- * @param    block:    pointer to block to shift
- * @note    I separated the pointer decrement from the bit shift as it was
- *             mangling the first byte
- */
-static void shiftBlockRight(uint8_t *block)
-{
-    block += 15;
-
-    // bitshift LSB (last byte in array)
-    *block = *block >> 1;
-    block--;
-
-    // loop through remaining bytes
-    for (uint8_t i = 0; i < AES128GCM_BLOCK_SIZE-1; i++) {
-        // if lsb is set, set msb of next byte in array
-        if(*block & 0x01) *(block + 1) |= 0x80;
-        // bit shift byte
-        *block = *block >> 1;
-        block--;
-    }
-}
+// Counter blocks per batched AES call in sealBatch()/openBatch(),
+// and the largest short frame (A || C || lengths) they hash in one go, in blocks;
+// these bound their stack use.
+// Frames with fewer whole text blocks than GCM_BATCH_KEYSTREAM_BLOCKS have all their keystream in the batch;
+// larger ones fill the engine's counter-mode lanes (8 with AES-NI) by themselves.
+#if defined(__AVR_ARCH__) || defined(ARDUINO_ARCH_AVR)
+static constexpr size_t GCM_BATCH_BLOCKS = 4;
+static constexpr size_t GCM_BATCH_HASH_BLOCKS = 4;
+static constexpr size_t GCM_BATCH_KEYSTREAM_BLOCKS = 3;
+#else
+static constexpr size_t GCM_BATCH_BLOCKS = 32;
+static constexpr size_t GCM_BATCH_HASH_BLOCKS = 16;
+static constexpr size_t GCM_BATCH_KEYSTREAM_BLOCKS = 8;
+#endif
 
+/******************* Private Functions *******************/
 /**
  * @brief   checks if tags match
  * @param   tag1        pointer to array containing tag1
  * @param   tag2        pointer to array containing tag2
+ * @param   tagLength   number of leading bytes to compare, eg for a truncated tag
  * @retval  returns 0 if tags match. All other values are a fail.
  */
-static uint8_t checkTag(const uint8_t *tag1, const uint8_t *tag2)
+static uint8_t checkTag(const uint8_t *tag1, const uint8_t *tag2, const uint8_t tagLength = AES128GCM_TAG_SIZE)
 {
     uint8_t result = 0;
 
     // Compare tags: f any byte pair fails to match this will set bits in result.
     // This method runtime does not depend on where the match is,
     // which will help avoid some side-channel attacks based on timing.
-    for (uint8_t i = 0; i < AES128GCM_TAG_SIZE; i++) {
+    for (uint8_t i = 0; i < tagLength; i++) {
         result |= *tag1 ^ *tag2;
         tag1++;
         tag2++;
@@ -108,46 +91,6 @@ static uint8_t checkTag(const uint8_t *tag1, const uint8_t *tag2)
     return result;
 }
 
-/**
- * @note    gf_mult
- * @brief    Performs multiplications in 128 bit galois bit field
- * @todo    learn how multiplication algorithm works
- * @param    x: pointer to input 1
- * @param    y: pointer to input 2
- * @param    result:    pointer to array to put result in
- * @note    output straight to *x and save on a memcpy loop?
- */
-static void gFieldMultiply(const uint8_t *x, const uint8_t *y, uint8_t *result)
-{
-    // working memory
-    uint8_t temp[AES128GCM_BLOCK_SIZE];
-
-    // init result to 0s and copy y to temp
-    memcpy(temp, y, AES128GCM_BLOCK_SIZE);
-    memset(result, 0, AES128GCM_BLOCK_SIZE);
-
-    // multiplication algorithm
-    for (uint8_t i = 0; i < AES128GCM_BLOCK_SIZE; i++) {
-        for (uint8_t j = 0; j < 8; j++) {
-
-            if (x[i] & (1 << (7 - j))) {
-                /* Z_(i + 1) = Z_i XOR V_i */
-                xorBlock(result, temp);
-            }
-            // if temp is odd, do something?
-            if (temp[15] & 0x01) {
-                /* V_(i + 1) = (V_i >> 1) XOR R */
-                shiftBlockRight(temp);
-                /* R = 11100001 || 0^120 */
-                temp[0] ^= 0xe1;
-            } else {
-                /* V_(i + 1) = V_i >> 1 */
-                shiftBlockRight(temp);
-            }
-        }
-    }
-}
-
 /**
  * @note    inc32
  * @brief    increments the rightmost 32 bits (4 bytes) of block, %(2^32)
@@ -168,21 +111,94 @@ static void incr32(uint8_t *pBlock)
     }
 }
 
+/**
+ * @brief   counter-mode encryption of whole blocks fused with GHASH of the ciphertext side
+ * @param   ap              AES implementation with the key already set
+ * @param   ctrBlock        counter block for the first block; advanced by nBlocks
+ * @param   input           nBlocks*16 bytes of input
+ * @param   output          nBlocks*16 bytes of output; may be the same as input
+ * @param   nBlocks         number of whole blocks
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   hashInput       true to hash the input (ie decrypting, before any in-place overwrite), else the output
+ * @param   S               16 byte running hash, updated in place
+ *
+ * This is the GCM inner loop: it hashes each stripe of ciphertext while still in L1 cache
+ * rather than in a second pass over the whole buffer.
+ * On x86 the AES-NI engine's stitched kernel is used where it and PCLMULQDQ are in use.
+ */
+static void ctr32EncryptHash(const OTAES128E * const ap,
+                             uint8_t *ctrBlock, const uint8_t *input, uint8_t *output, size_t nBlocks,
+                             const GHASHKey *hk, const bool hashInput, uint8_t *S)
+{
+#ifdef OTAESGCM_X86_INTRINSICS
+    const OTAES128E_AESNI *const ni = ap->getAESNI();
+    if((NULL != ni) && ni->ctr32EncryptHashKeyed(ctrBlock, input, output, nBlocks, hk, hashInput, S)) { return; }
+#endif
+    // Blocks per stripe: several aggregated GHASH rounds, well within L1.
+    const uint8_t stripeBlocks = 4 * GHASH_HPOWERS;
+    while(nBlocks > 0) {
+        const size_t m = (nBlocks < stripeBlocks) ? nBlocks : stripeBlocks;
+        const size_t nBytes = m * AES128GCM_BLOCK_SIZE;
+        if(hashInput) { GHASH(input, nBytes, hk, S); }
+        ap->ctr32EncryptKeyed(ctrBlock, input, output, m);
+        if(!hashInput) { GHASH(output, nBytes, hk, S); }
+        input += nBytes;
+        output += nBytes;
+        nBlocks -= m;
+    }
+}
+
+/**
+ * @brief   encryption of independent blocks, each under its own engine's key
+ * @param   lanes           array of nBlocks engines with keys set, lanes[i] for block i; typically in runs
+ * @param   input           nBlocks*16 bytes of input
+ * @param   output          nBlocks*16 bytes of output
+ * @param   nBlocks         number of blocks
+ *
+ * On x86, if every lane has AES-NI in use the blocks go through its multi-schedule kernel
+ * with up to 8 in flight whatever their keys;
+ * otherwise each run of blocks sharing an engine is one ecbEncryptKeyed() call.
+ */
+static void ecbEncryptLanes(const OTAES128E *const *lanes,
+                            const uint8_t *input, uint8_t *output, const size_t nBlocks)
+{
+#ifdef OTAESGCM_X86_INTRINSICS
+    const OTAES128E_AESNI *ni[GCM_BATCH_BLOCKS];
+    bool allNI = (nBlocks <= GCM_BATCH_BLOCKS);
+    for(size_t i = 0; allNI && (i < nBlocks); ++i)
+    {
+        ni[i] = ((0 != i) && (lanes[i] == lanes[i-1])) ? ni[i-1] : lanes[i]->getAESNI();
+        allNI = (NULL != ni[i]);
+    }
+    if(allNI && OTAES128E_AESNI::ecbEncryptMultiKeyed(ni, input, output, nBlocks)) { return; }
+#endif
+    size_t i = 0;
+    while(i < nBlocks)
+    {
+        size_t end = i + 1;
+        while((end < nBlocks) && (lanes[end] == lanes[i])) { ++end; }
+        const size_t o = i * AES128GCM_BLOCK_SIZE;
+        lanes[i]->ecbEncryptKeyed(input + o, output + o, end - i);
+        i = end;
+    }
+}
+
 //**************** MAIN ENCRYPTION FUNCTIONS *************
 /**
  * @note    aes_gctr
  * @brief   performs gcntr operation for encryption
+ * @param   ap              AES implementation with the key already set
  * @param   pInput          pointer to input data
  * @param   inputLength     length of input array
- * @param   pKey            pointer to 128 bit AES key
  * @param   pICB            initial counter block J0
- * @param   pOutput         pointer to output data. length inputLength rounded up to 16.
+ * @param   pOutput         pointer to output data, length inputLength
  */
-static void GCTR(OTAES128E * const ap,
-                    const uint8_t *pInput, uint8_t inputLength, const uint8_t *pKey,
+static void GCTR(const OTAES128E * const ap,
+                    const uint8_t *pInput, size_t inputLength,
                     const uint8_t *pCtrBlock, uint8_t *pOutput)
 {
-    uint8_t n, last;
+    size_t n;
+    uint8_t last;
     uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
     uint8_t tmp[AES128GCM_BLOCK_SIZE]; // if we use full blocks, no need for tmp
 
@@ -198,75 +214,22 @@ static void GCTR(OTAES128E * const ap,
     // copy ICB to ctrBlock
     memcpy(ctrBlock, pCtrBlock, AES128GCM_BLOCK_SIZE);
 
-    // for full blocks
-    for (uint8_t i = 0; i < n; i++) {
-        // cipher counterblock and combine with input
-        ap->blockEncrypt(ctrBlock, pKey, ypos);
-        xorBlock(ypos, xpos);
-
-        // increment pointers to next block
-        xpos += AES128GCM_BLOCK_SIZE;
-        ypos += AES128GCM_BLOCK_SIZE;
-
-        // increment counter
-        incr32(ctrBlock);
-    }
+    // cipher counterblocks and combine with input for full blocks,
+    // leaving ctrBlock ready for any partial block
+    ap->ctr32EncryptKeyed(ctrBlock, xpos, ypos, n);
+    xpos += n * AES128GCM_BLOCK_SIZE;
+    ypos += n * AES128GCM_BLOCK_SIZE;
 
     // check if there is a partial block at end
     last = uint8_t(pInput + inputLength - xpos);
     if (last) {
         // encrypt into tmp and combine with last block of input
-        ap->blockEncrypt(ctrBlock, pKey, tmp);
+        ap->blockEncryptKeyed(ctrBlock, tmp);
         for (uint8_t i = 0; i < last; i++)
             *ypos++ = *xpos++ ^ tmp[i];
     }
 }
 
-/**
- * @note    ghash
- * @brief   performs authentication hashing
- * @todo    is final memcpy always persistent?
- * @param   pInput          pointer to input data
- * @param   inputLength     length of input array
- * @param   pAuthKey        pointer to 128 bit authentication subkey H
- * @param   pOutput         pointer to 16 byte output array
- */
-static void GHASH(  const uint8_t *pInput, uint8_t inputLength,
-                    const uint8_t *pAuthKey, uint8_t *pOutput )
-{
-    uint8_t m;
-    const uint8_t *xpos = pInput;
-    uint8_t tmp[AES128GCM_BLOCK_SIZE]; // if we use full blocks, no need for tmp
-
-    // calculate number of full blocks to hash
-    m = inputLength / AES128GCM_BLOCK_SIZE;
-
-    // hash full blocks
-    for (uint8_t i = 0; i < m; i++) {
-        // Y_i = (Y^(i-1) XOR X_i) dot H
-        xorBlock(pOutput, xpos);
-        xpos += 16; // move to next block
-
-        gFieldMultiply(pOutput, pAuthKey, tmp);
-
-        // copy tmp to output
-        memcpy(pOutput, tmp, AES128GCM_BLOCK_SIZE);
-    }
-
-    // check if final partial block. Can be omitted if we use full blocks.
-    if (pInput + inputLength > xpos) {
-        // zero pad
-        const uint8_t last = uint8_t(pInput + inputLength - xpos);
-        memcpy(tmp, xpos, last);
-        memset(tmp + last, 0, sizeof(tmp) - last);
-
-        // Y_i = (Y^(i-1) XOR X_i) dot H
-        xorBlock(pOutput, tmp);
-        gFieldMultiply(pOutput, pAuthKey, tmp);
-        memcpy(pOutput, tmp, AES128GCM_BLOCK_SIZE);
-    }
-}
-
 /**
  * @note    aes_gcm_prepare_j0
  * @brief   generates initial counter block from IV
@@ -285,14 +248,15 @@ static void generateICB(const uint8_t *pIV, uint8_t *pOutput)
 /**
  * @note    aes_gcm_ctr
  * @brief   encrypt PDATA to get CDATA
+ * @param   ap          AES implementation with the key already set
  * @param   pICB        pointer to initial counter block
  * @param   pPDATA      pointer to plain text
  * @param   PDATALength length of plain text
- * @param   pCDATA      pointer to array for cipher text. Length PDATALength rounded up to next 16 bytes
+ * @param   pCDATA      pointer to array for cipher text, length PDATALength
  */
-static void generateCDATA(OTAES128E * const ap,
-                            const uint8_t *pICB, const uint8_t *pPDATA, uint8_t PDATALength,
-                            uint8_t *pCDATA, const uint8_t *pKey )
+static void generateCDATA(const OTAES128E * const ap,
+                            const uint8_t *pICB, const uint8_t *pPDATA, size_t PDATALength,
+                            uint8_t *pCDATA)
 {
     uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
 
@@ -304,29 +268,65 @@ static void generateCDATA(OTAES128E * const ap,
     incr32(ctrBlock);
 
     // encrypt
-    GCTR(ap, pPDATA, PDATALength, pKey, ctrBlock, pCDATA);
+    GCTR(ap, pPDATA, PDATALength, ctrBlock, pCDATA);
+}
+
+/**
+ * @brief   makes the GHASH length block [len(A)]64 || [len(C)]64, lengths in bits
+ * @param   ADATALength     length of A in bytes
+ * @param   CDATALength     length of C in bytes
+ * @param   pOutput         pointer to 16 byte output array
+ */
+static void generateLengthBlock(uint64_t ADATALength, uint64_t CDATALength, uint8_t *pOutput)
+{
+    ADATALength <<= 3;
+    CDATALength <<= 3;
+    for (int8_t i = 7; i >= 0; i--) {
+        pOutput[i] = (uint8_t)ADATALength;
+        pOutput[8 + i] = (uint8_t)CDATALength;
+        ADATALength >>= 8;
+        CDATALength >>= 8;
+    }
+}
+
+/**
+ * @brief   hashes the length block into S and encrypts it with the ICB to make the tag
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   ADATALength     length of A in bytes
+ * @param   CDATALength     length of C in bytes
+ * @param   S               16 byte running hash over A and C, zero padded
+ * @param   pICB            initial counter block J0
+ * @param   pTag            pointer to 16 byte array to store tag
+ */
+static void finishTag(const OTAES128E * const ap, const GHASHKey *hk,
+                            uint64_t ADATALength, uint64_t CDATALength,
+                            uint8_t *S, const uint8_t *pICB, uint8_t *pTag)
+{
+    uint8_t lengthBuffer[16];
+    generateLengthBlock(ADATALength, CDATALength, lengthBuffer);
+    GHASH(lengthBuffer, sizeof(lengthBuffer), hk, S);
+    GCTR(ap, S, AES128GCM_BLOCK_SIZE, pICB, pTag);
 }
 
 /**
  * @note    aes_gcm_ghash
  * @brief   makes message S from ADATA and CDATA
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key holding authentication subkey H
  * @param   pADATA          pointer to array containing authentication data
  * @param   ADATALength     length of ADATA array
  * @param   pCDATA          pointer to array containing encrypted data
  * @param   CDATALength     length of CDATA array
- * @param   pAuthKey        pointer to 128 bit authentication subkey H
  * @param   pTag            pointer to array to store tag
  */
-static void generateTag(OTAES128E * const ap,
-                            const uint8_t *pKey, const uint8_t *pAuthKey,
-                            const uint8_t *pADATA, uint8_t ADATALength,
-                            const uint8_t *pCDATA, uint8_t CDATALength,
+static void generateTag(const OTAES128E * const ap,
+                            const GHASHKey *hk,
+                            const uint8_t *pADATA, size_t ADATALength,
+                            const uint8_t *pCDATA, size_t CDATALength,
                             uint8_t * pTag, const uint8_t *pICB)
 {
-    uint16_t temp;
-    uint8_t lengthBuffer[16];
     uint8_t S[16];
-    memset(lengthBuffer, 0, 16);
     memset(S, 0, AES128GCM_BLOCK_SIZE);
     /*
      * u = 128 * ceil[len(C)/128] - len(C)
@@ -334,69 +334,53 @@ static void generateTag(OTAES128E * const ap,
      * S = GHASH_H(A || 0^v || C || 0^u || [len(A)]64 || [len(C)]64)
      * (i.e., zero padded to block size A || C and lengths of each in bits)
      */
+    GHASH(pADATA, ADATALength, hk, S);
+    GHASH(pCDATA, CDATALength, hk, S);
+    finishTag(ap, hk, ADATALength, CDATALength, S, pICB, pTag);
+}
 
-    // function to put [len(A)]64 || [len(C)]64 in temp. could be saved as using fixed method length
-    temp = (uint16_t) ADATALength * 8;
-    //lengthBuffer[4] = (temp >> 24) & 0xff;    // these two are not needed as only using 16 bit values
-    //lengthBuffer[5] = (temp >> 16) & 0xff;
-    lengthBuffer[6] = (temp >> 8) & 0xff;
-    lengthBuffer[7] = temp & 0xff;
-
-    temp = (uint16_t) CDATALength * 8;
-    //lengthBuffer[12] = (temp >> 24) & 0xff;
-    //lengthBuffer[13] = (temp >> 16) & 0xff;
-    lengthBuffer[14] = (temp >> 8) & 0xff;
-    lengthBuffer[15] = temp & 0xff;
-
-
-    GHASH(pADATA, ADATALength, pAuthKey, S);
-    GHASH(pCDATA, CDATALength, pAuthKey, S);
-    GHASH(lengthBuffer, sizeof(lengthBuffer), pAuthKey, S);
-
-    GCTR(ap, S, sizeof(S), pKey, pICB, pTag);
+/**
+ * @brief   overwrites sensitive data in a way the compiler should not elide
+ * @param   p               pointer to data to wipe; never NULL
+ * @param   n               number of bytes to wipe
+ */
+static void secureWipe(void *p, size_t n)
+{
+    volatile uint8_t *vp = (volatile uint8_t *)p;
+    while(n-- > 0) { *vp++ = 0; }
 }
 
 /**
  * @note    aes_gcm_init_hash_subkey
  * @brief   generates authentication subkey H
- * @param   pKey            pointer to 128 bit AES key
- * @param   pOutput         pointer to 16 byte array put to subkey H in
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key to set up with subkey H
  * @note    tested arduino 1.6.5
  */
-static void generateAuthKey(OTAES128E * const ap, const uint8_t *pKey, uint8_t *pAuthKey)
+static void generateAuthKey(const OTAES128E * const ap, GHASHKey *hk)
 {
     // original has if(aes == NULL) return NULL;
 
     // Encrypt 128 bit block of 0s to generate authentication sub-key.
-    memset(pAuthKey, 0, AES128GCM_BLOCK_SIZE);
-    ap->blockEncrypt(pAuthKey, pKey, pAuthKey);
+    uint8_t authKey[AES128GCM_BLOCK_SIZE];
+    memset(authKey, 0, AES128GCM_BLOCK_SIZE);
+    ap->blockEncryptKeyed(authKey, authKey);
+    hk->init(authKey);
+    secureWipe(authKey, sizeof(authKey));
 }
 
 
-/******************* Public Functions ********************/
-
 /**
- * @brief   performs AES-GCM encryption.
- * @param   key             pointer to 16 byte (128 bit) key; never NULL
- * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
- * @param   PDATA           pointer to plaintext array, this is internally padded up to a multiple of the blocksize; NULL if length 0.
+ * @brief   checks encryption parameters and computes padded CDATA length
  * @param   PDATALength     length of plaintext array in bytes, can be zero
- * @param   ADATA           pointer to additional data array; NULL if length 0.
  * @param   ADATALength     length of additional data in bytes, can be zero
- * @param   CDATA           buffer to output ciphertext to, size MUST BE PADDED/EXPANDED TO FULL BLOCKSIZE MULTIPLE at/above PDATAlength;
- *                          (nominally set to NULL if PDATA is NULL but seems to cause a crash)
- * @param   tag             pointer to 16 byte buffer to output tag to; never NULL
- * @retval  true if encryption successful, else false
+ * @param   CDATA           buffer for ciphertext; never NULL
+ * @param   CDATALength     set to PDATALength rounded up to the block size
+ * @retval  true if parameters are acceptable, else false
  */
-bool OTAES128GCMGenericBase::gcmEncrypt(
-                        const uint8_t* key, const uint8_t* IV,
-                        const uint8_t* PDATA, uint8_t PDATALength,
-                        const uint8_t* ADATA, uint8_t ADATALength,
-                        uint8_t* CDATA, uint8_t *tag) const
+static bool checkEncryptParams(uint8_t PDATALength, uint8_t ADATALength,
+                               const uint8_t *CDATA, uint8_t &CDATALength)
 {
-    uint8_t authKey[AES128GCM_BLOCK_SIZE];
-    uint8_t ICB[AES128GCM_BLOCK_SIZE];
-
     if(NULL == CDATA) { return(false); } // DHD20161107: NULL CDATA causes crashes in subroutines.
 
     // Check if there is input data.
@@ -405,159 +389,1754 @@ bool OTAES128GCMGenericBase::gcmEncrypt(
 
     // Compute implicit CDATA length (ie rounded up to the next block size if necessary).
     if(PDATALength >= (uint8_t)(256U - (uint16_t)AES128GCM_BLOCK_SIZE)) { return(false); } // Too big.
-    const uint8_t CDATALength = (PDATALength + AES128GCM_BLOCK_SIZE-1) & ~(AES128GCM_BLOCK_SIZE-1);
-
-    // Encrypt data
-    generateAuthKey(ap, key, authKey);
-    generateICB(IV, ICB);
-    generateCDATA(ap, ICB, PDATA, PDATALength, CDATA, key);
-
-    // Generate authentication tag.
-    generateTag(ap, key, authKey, ADATA, ADATALength, CDATA, CDATALength, tag, ICB);
-
+    CDATALength = (PDATALength + AES128GCM_BLOCK_SIZE-1) & ~(AES128GCM_BLOCK_SIZE-1);
     return(true);
 }
 
-
 /**
- * @brief   performs AES-GCM decryption and authentication
- * @param   key             pointer to 16 byte (128 bit) key
- * @param   IV              pointer to 12 byte (96 bit) IV
- * @param   CDATA           pointer to ciphertext array (multiple of block size, 16 bytes)
+ * @brief   checks decryption parameters
  * @param   CDATALength     length of ciphertext array
- * @param   ADATA           pointer to additional data array
  * @param   ADATALength     length of additional data
- * @param   PDATA           buffer to output plaintext to; must be same length as CDATA
- * @retval  true if decryption and authentication successful, else false
+ * @retval  true if parameters are acceptable, else false
  */
-bool OTAES128GCMGenericBase::gcmDecrypt(
-                        const uint8_t* key, const uint8_t* IV,
-                        const uint8_t* CDATA, uint8_t CDATALength,
-                        const uint8_t* ADATA, uint8_t ADATALength,
-                        const uint8_t* messageTag, uint8_t *PDATA) const
+static bool checkDecryptParams(uint8_t CDATALength, uint8_t ADATALength)
 {
-    uint8_t authKey[AES128GCM_BLOCK_SIZE];
-    uint8_t ICB[AES128GCM_BLOCK_SIZE];
-    uint8_t calculatedTag[AES128GCM_TAG_SIZE];
-
     // Check if there is input data.
     // Fail if there is nothing to decrypt and/or authenticate.
     if((CDATALength == 0) && (ADATALength == 0)) { return(false); }
 
     // Fail if the CDATA length is not a multiple of the block size.
     if(0 != (CDATALength & (AES128GCM_BLOCK_SIZE-1))) { return(false); }
+    return(true);
+}
 
-    // Decrypt CDATA.
-    generateAuthKey(ap, key, authKey);
-    generateICB(IV, ICB);
+/**
+ * @brief   checks parameters for the exact-length (long) entry points
+ * @param   textLength      length of plaintext/ciphertext in bytes, can be zero
+ * @param   ADATALength     length of additional data in bytes, can be zero
+ * @param   input           text input; may be NULL only if textLength is 0
+ * @param   output          text output; may be NULL only if textLength is 0
+ * @retval  true if parameters are acceptable, else false
+ */
+static bool checkLongParams(size_t textLength, size_t ADATALength,
+                            const uint8_t *input, const uint8_t *output)
+{
+    // Fail if there is nothing to encrypt and/or authenticate, as for the short forms.
+    if((textLength == 0) && (ADATALength == 0)) { return(false); }
+    // Fail if the text is present but buffers are not.
+    if((textLength != 0) && ((NULL == input) || (NULL == output))) { return(false); }
+    // Enforce the GCM length limits.
+    if((uint64_t)textLength > AES128GCM_MAX_TEXT_LENGTH) { return(false); }
+    if((uint64_t)ADATALength > AES128GCM_MAX_AAD_LENGTH) { return(false); }
+    return(true);
+}
 
-    generateCDATA(ap, ICB, CDATA, CDATALength, PDATA, key);
+/**
+ * @brief   checks the layout of a frame buffer for in-place encryption/decryption
+ * @param   frame           pointer to frame buffer
+ * @param   frameLength     length of frame buffer in bytes
+ * @param   ADATALength     length of additional data at the start of the frame, can be zero
+ * @param   bodyOffset      offset of the body (text) in the frame
+ * @param   bodyLength      length of body in bytes, can be zero
+ * @param   tagOffset       offset of the tag slot in the frame
+ * @param   tagLength       length of the tag slot in bytes
+ * @retval  true if the regions lie within the frame and do not overlap, else false
+ */
+static bool checkFrameParams(const uint8_t *frame, uint8_t frameLength,
+                             uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                             uint8_t tagOffset, uint8_t tagLength)
+{
+    // Use 16-bit arithmetic so that region ends cannot wrap.
+    const uint16_t bodyEnd = (uint16_t)bodyOffset + bodyLength;
+    const uint16_t tagEnd = (uint16_t)tagOffset + tagLength;
+    if(NULL == frame) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    // Fail if there is nothing to encrypt and/or authenticate.
+    if((bodyLength == 0) && (ADATALength == 0)) { return(false); }
+    // All regions must lie within the frame.
+    if((ADATALength > frameLength) || (bodyEnd > frameLength) || (tagEnd > frameLength)) { return(false); }
+    // The body and tag slot must follow the AAD, and not overlap each other.
+    if((bodyLength != 0) && (bodyOffset < ADATALength)) { return(false); }
+    if(tagOffset < ADATALength) { return(false); }
+    if((bodyLength != 0) && (tagOffset < bodyEnd) && (tagEnd > bodyOffset)) { return(false); }
+    return(true);
+}
 
-    // Authenticate and return true if tag matches.
-    generateTag(ap, key, authKey, ADATA, ADATALength, CDATA, CDATALength, calculatedTag, ICB);
-    return(0 == checkTag(calculatedTag, messageTag));
+/**
+ * @brief   XORs text with precomputed keystream
+ * @param   pInput          pointer to input text
+ * @param   pKeystream      pointer to keystream, at least length bytes
+ * @param   pOutput         pointer to output text; may be the same as pInput
+ * @param   length          length of text in bytes
+ */
+static void xorKeystream(const uint8_t *pInput, const uint8_t *pKeystream, uint8_t *pOutput, size_t length)
+{
+#if !defined(__AVR_ARCH__) && !defined(ARDUINO_ARCH_AVR)
+    // A word at a time where words are cheap; memcpy() keeps it alignment- and aliasing-safe.
+    for( ; length >= sizeof(uint64_t); length -= sizeof(uint64_t))
+    {
+        uint64_t t, k;
+        memcpy(&t, pInput, sizeof(t));
+        memcpy(&k, pKeystream, sizeof(k));
+        t ^= k;
+        memcpy(pOutput, &t, sizeof(t));
+        pInput += sizeof(t);
+        pKeystream += sizeof(k);
+        pOutput += sizeof(t);
+    }
+#endif
+    while(length-- > 0) { *pOutput++ = *pInput++ ^ *pKeystream++; }
 }
 
+/**
+ * @brief   length rounded up to a whole number of blocks
+ */
+static size_t paddedLength(size_t length)
+{
+    return((length + AES128GCM_BLOCK_SIZE - 1) & ~(size_t)(AES128GCM_BLOCK_SIZE - 1));
+}
 
-// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) encryption/authentication function.
-// This is an adaptor/bridge function to ease outside use in simple cases
-// without explicit type/library dependencies, but use with care.
-// Stateless implementation: creates state on stack each time at cost of stack space
-// (which may be considerable and difficult to manage in an embedded system)
-// and at cost of time.
-// The state parameter is not used (is ignored) and should be NULL.
-// Other than the authtext, all sizes are fixed:
-//   * textSize is 32 (or zero if plaintext is NULL)
-//   * keySize is 16
-//   * nonceSize is 12
-//   * tagSize is 16
-// The plain-text (and identical cipher-text) size is picked to be
-// a multiple of the cipher's block size, or zero,
-// which implies likely requirement for padding of the plain text.
-// Note that the authenticated text size is not fixed, ie is zero or more bytes.
-// The plaintext can be NULL, ciphertextOut not (a future version may allow it to be if plaintext is).
-// Returns true on success, false on failure.
-bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(void *const,
-        const uint8_t *const key, const uint8_t *const iv,
-        const uint8_t *const authtext, const uint8_t authtextSize,
-        const uint8_t *const plaintext,
-        uint8_t *const ciphertextOut, uint8_t *const tagOut)
-    {
-    if((NULL == key) || (NULL == iv) || (NULL == ciphertextOut) || (NULL == tagOut)) { return(false); } // ERROR
-    OTAES128GCMGeneric<> i;
-    return(i.gcmEncrypt(key, iv, plaintext, (NULL == plaintext) ? 0 : 32, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut));
+/**
+ * @brief   hashes the length block into S and masks it with E(K, J0) to make the tag;
+ *          as finishTag() with the tag mask already computed
+ * @param   mask            16 byte encrypted initial counter block
+ * @param   pTag            pointer to 16 byte array to store tag; may be the same as S
+ */
+static void maskTag(const GHASHKey *hk,
+                    uint64_t ADATALength, uint64_t CDATALength,
+                    uint8_t *S, const uint8_t *mask, uint8_t *pTag)
+{
+    uint8_t lengthBuffer[AES128GCM_BLOCK_SIZE];
+    generateLengthBlock(ADATALength, CDATALength, lengthBuffer);
+    GHASH(lengthBuffer, sizeof(lengthBuffer), hk, S);
+    for(uint8_t i = 0; i < AES128GCM_BLOCK_SIZE; ++i) { pTag[i] = S[i] ^ mask[i]; }
+}
+
+/**
+ * @brief   hashes the next piece of a message (AAD, or ciphertext on its own),
+ *          carrying any partial block over to the next piece
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   S               16 byte running hash
+ * @param   buf             16 byte partial block awaiting GHASH
+ * @param   bufLength       bytes held in buf, [0,15]; updated
+ * @param   pInput          pointer to input; may be NULL if length is 0
+ * @param   length          length of input in bytes
+ */
+static void hashPieces(const GHASHKey *hk, uint8_t *S,
+                       uint8_t *buf, uint8_t &bufLength,
+                       const uint8_t *pInput, size_t length)
+{
+    // Top up any partial block.
+    while((0 != bufLength) && (length > 0)) {
+        buf[bufLength++] = *pInput++;
+        --length;
+        if(AES128GCM_BLOCK_SIZE == bufLength) {
+            GHASH(buf, AES128GCM_BLOCK_SIZE, hk, S);
+            bufLength = 0;
+        }
     }
 
-// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) decryption/authentication function.
-// This is an adaptor/bridge function to ease outside use in simple cases
-// without explicit type/library dependencies, but use with care.
-// Stateless implementation: creates state on stack each time at cost of stack space
-// (which may be considerable and difficult to manage in an embedded system)
-// and at cost of time.
-// The state parameter is not used (is ignored) and should be NULL.
-// Other than the authtext, all sizes are fixed:
-//   * textSize is 32 (or zero if ciphertext is NULL)
-//   * keySize is 16
-//   * nonceSize is 12
-//   * tagSize is 16
-// The plain-text (and identical cipher-text) size is picked to be
-// a multiple of the cipher's block size, or zero,
-// which implies likely requirement for padding of the plain text.
-// Note that the authenticated text size is not fixed, ie is zero or more bytes.
-// The ciphertext can be NULL, plaintextOut not (a future version may allow it to be if ciphertext is).
-// Decrypts/authenticates the output of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS.)
-// Returns true on success, false on failure.
-bool fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(void *const,
-        const uint8_t *const key, const uint8_t *const iv,
-        const uint8_t *const authtext, const uint8_t authtextSize,
-        const uint8_t *const ciphertext, const uint8_t *const tag,
-        uint8_t *const plaintextOut)
-    {
-    if((NULL == key) || (NULL == iv) || (NULL == tag) || (NULL == plaintextOut)) { return(false); } // ERROR
-    OTAES128GCMGeneric<> i;
-    return(i.gcmDecrypt(key, iv, ciphertext, (NULL == ciphertext) ? 0 : 32, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut));
+    // Hash whole blocks directly.
+    const size_t n = length & ~(size_t)(AES128GCM_BLOCK_SIZE-1);
+    GHASH(pInput, n, hk, S);
+    pInput += n;
+    length -= n;
+
+    // Buffer any remainder (only possible if the buffer has just been emptied).
+    if(length > 0) {
+        memcpy(buf, pInput, length);
+        bufLength = (uint8_t)length;
     }
+}
 
+/**
+ * @brief   encrypts or decrypts the next piece of text in counter mode,
+ *          carrying the keystream and any partial ciphertext block over to the next piece
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   ctrBlock        counter block for the next whole block; updated
+ * @param   S               16 byte running hash over the ciphertext; NULL to not hash
+ * @param   buf             16 byte partial ciphertext block awaiting GHASH
+ * @param   keystream       16 byte keystream for the partial block
+ * @param   bufLength       bytes of the partial block done, [0,15]; updated
+ * @param   decrypting      true if input is ciphertext, false if output is
+ * @param   pInput          pointer to input text
+ * @param   length          length of text in bytes
+ * @param   pOutput         pointer to output text; may be the same as pInput
+ */
+static void cryptPieces(const OTAES128E * const ap, const GHASHKey *hk,
+                        uint8_t *ctrBlock, uint8_t *S,
+                        uint8_t *buf, uint8_t *keystream, uint8_t &bufLength, const bool decrypting,
+                        const uint8_t *pInput, size_t length, uint8_t *pOutput)
+{
+    // Use up the keystream for any partial block.
+    while((0 != bufLength) && (length > 0)) {
+        const uint8_t in = *pInput++;
+        const uint8_t out = in ^ keystream[bufLength];
+        *pOutput++ = out;
+        buf[bufLength++] = decrypting ? in : out;
+        --length;
+        if(AES128GCM_BLOCK_SIZE == bufLength) {
+            if(NULL != S) { GHASH(buf, AES128GCM_BLOCK_SIZE, hk, S); }
+            bufLength = 0;
+        }
+    }
 
-// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) encryption/authentication function using work space passed in.
-// This is an adaptor/bridge function to ease outside use in simple cases
-// without explicit type/library dependencies, but use with care.
-// A workspace is passed in (and cleared on exit);
-// this routine will fail (safely, returning false) if the workspace is NULL or too small.
-// The workspace requirement depends on the implementation used.
-// Other than the authtext, all sizes are fixed:
-//   * textSize is 32 (or zero if plaintext is NULL)
-//   * keySize is 16
-//   * nonceSize is 12
-//   * tagSize is 16
-// The plain-text (and identical cipher-text) size is picked to be
-// a multiple of the cipher's block size, or zero,
-// which implies likely requirement for padding of the plain text.
-// Note that the authenticated text size is not fixed, ie is zero or more bytes.
-// Returns true on success, false on failure.
-bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
-        uint8_t *const workspace, const uint8_t workspaceSize,
-        const uint8_t *const key, const uint8_t *const iv,
-        const uint8_t *const authtext, const uint8_t authtextSize,
-        const uint8_t *const plaintext,
-        uint8_t *const ciphertextOut, uint8_t *const tagOut)
-    {
-    if((NULL == key) || (NULL == iv) || (NULL == ciphertextOut) || (NULL == tagOut)) { return(false); } // ERROR
-    typedef OTAES128GCMGenericWithWorkspace<> t;
-    if(!t::isWorkspaceSufficient(workspace, workspaceSize)) { return(false); } // ERROR
-    t i(workspace, workspaceSize);
-    return(i.gcmEncrypt(key, iv, plaintext, (NULL == plaintext) ? 0 : 32, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut));
+    // Whole blocks in counter mode, hashing the ciphertext side.
+    const size_t n = length / AES128GCM_BLOCK_SIZE;
+    if(n > 0) {
+        const size_t nBytes = n * AES128GCM_BLOCK_SIZE;
+        if(NULL != S) { ctr32EncryptHash(ap, ctrBlock, pInput, pOutput, n, hk, decrypting, S); }
+        else { ap->ctr32EncryptKeyed(ctrBlock, pInput, pOutput, n); }
+        pInput += nBytes;
+        pOutput += nBytes;
+        length -= nBytes;
     }
 
-// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) decryption/authentication function using work space passed in.
-// This is an adaptor/bridge function to ease outside use in simple cases
-// without explicit type/library dependencies, but use with care.
-// A workspace is passed in (and cleared on exit);
-// this routine will fail (safely, returning false) if the workspace is NULL or too small.
-// The workspace requirement depends on the implementation used.
-// Other than the authtext, all sizes are fixed:
-//   * textSize is 32 (or zero if ciphertext is NULL)
-//   * keySize is 16
+    // Start a partial block, keeping its keystream for later.
+    if(length > 0) {
+        ap->blockEncryptKeyed(ctrBlock, keystream);
+        incr32(ctrBlock);
+        while(length-- > 0) {
+            const uint8_t in = *pInput++;
+            const uint8_t out = in ^ keystream[bufLength];
+            *pOutput++ = out;
+            buf[bufLength++] = decrypting ? in : out;
+        }
+    }
+}
+
+/**
+ * @brief   checks scatter-gather segment lists and totals their lengths
+ * @param   ADATA           array of nADATA AAD segments; NULL if nADATA is 0
+ * @param   text            array of nText text segments; NULL if nText is 0
+ * @param   ADATALength     set to the total AAD length in bytes
+ * @param   textLength      set to the total text length in bytes
+ * @retval  true if acceptable as for checkLongParams() on the totals, else false
+ */
+static bool checkSegmentParams(const OTAES128GCMSegment *ADATA, size_t nADATA,
+                               const OTAES128GCMTextSegment *text, size_t nText,
+                               uint64_t &ADATALength, uint64_t &textLength)
+{
+    if(((0 != nADATA) && (NULL == ADATA)) || ((0 != nText) && (NULL == text))) { return(false); }
+    ADATALength = 0;
+    textLength = 0;
+    for(size_t i = 0; i < nADATA; ++i)
+    {
+        if(0 == ADATA[i].length) { continue; }
+        if(NULL == ADATA[i].data) { return(false); }
+        if(ADATA[i].length > AES128GCM_MAX_AAD_LENGTH - ADATALength) { return(false); }
+        ADATALength += ADATA[i].length;
+    }
+    for(size_t i = 0; i < nText; ++i)
+    {
+        if(0 == text[i].length) { continue; }
+        if((NULL == text[i].input) || (NULL == text[i].output)) { return(false); }
+        if(text[i].length > AES128GCM_MAX_TEXT_LENGTH - textLength) { return(false); }
+        textLength += text[i].length;
+    }
+    // Fail if there is nothing to encrypt and/or authenticate, as for the other forms.
+    return((0 != ADATALength) || (0 != textLength));
+}
+
+/**
+ * @brief   encrypts scatter-gather segments and generates tag with key and H already set up
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   ADATALength     total AAD length from checkSegmentParams()
+ * @param   textLength      total text length from checkSegmentParams()
+ * @note    other parameters as for gcmEncryptSegments(); these must already have been checked
+ */
+static void encryptSegmentsKeyed(const OTAES128E * const ap, const GHASHKey *hk,
+                                 const uint8_t* IV,
+                                 const OTAES128GCMSegment *ADATA, size_t nADATA,
+                                 const OTAES128GCMTextSegment *text, size_t nText,
+                                 uint64_t ADATALength, uint64_t textLength,
+                                 uint8_t *tag, const uint8_t tagLength)
+{
+    uint8_t ICB[AES128GCM_BLOCK_SIZE];
+    uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    uint8_t buf[AES128GCM_BLOCK_SIZE];
+    uint8_t keystream[AES128GCM_BLOCK_SIZE];
+    uint8_t fullTag[AES128GCM_TAG_SIZE];
+    uint8_t bufLength = 0;
+    memset(S, 0, sizeof(S));
+    generateICB(IV, ICB);
+
+    for(size_t i = 0; i < nADATA; ++i) { hashPieces(hk, S, buf, bufLength, ADATA[i].data, ADATA[i].length); }
+    GHASH(buf, bufLength, hk, S);
+    bufLength = 0;
+
+    memcpy(ctrBlock, ICB, sizeof(ctrBlock));
+    incr32(ctrBlock);
+    for(size_t i = 0; i < nText; ++i)
+        { cryptPieces(ap, hk, ctrBlock, S, buf, keystream, bufLength, false, text[i].input, text[i].length, text[i].output); }
+    GHASH(buf, bufLength, hk, S);
+
+    finishTag(ap, hk, ADATALength, textLength, S, ICB, fullTag);
+    memcpy(tag, fullTag, tagLength);
+    secureWipe(keystream, sizeof(keystream));
+}
+
+/**
+ * @brief   decrypts and authenticates scatter-gather segments with key and H already set up
+ * @note    parameters as for encryptSegmentsKeyed() and gcmDecryptSegments()
+ * @retval  true if the tag matches, else false
+ */
+static bool decryptSegmentsKeyed(const OTAES128E * const ap, const GHASHKey *hk,
+                                 const uint8_t* IV,
+                                 const OTAES128GCMSegment *ADATA, size_t nADATA,
+                                 const OTAES128GCMTextSegment *text, size_t nText,
+                                 uint64_t ADATALength, uint64_t textLength,
+                                 const uint8_t *messageTag, const uint8_t tagLength)
+{
+    uint8_t ICB[AES128GCM_BLOCK_SIZE];
+    uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    uint8_t buf[AES128GCM_BLOCK_SIZE];
+    uint8_t keystream[AES128GCM_BLOCK_SIZE];
+    uint8_t calculatedTag[AES128GCM_TAG_SIZE];
+    uint8_t bufLength = 0;
+    memset(S, 0, sizeof(S));
+    generateICB(IV, ICB);
+
+    // Authenticate first, so that a forged or corrupted message
+    // never writes unauthenticated plaintext to any output segment.
+    for(size_t i = 0; i < nADATA; ++i) { hashPieces(hk, S, buf, bufLength, ADATA[i].data, ADATA[i].length); }
+    GHASH(buf, bufLength, hk, S);
+    bufLength = 0;
+    for(size_t i = 0; i < nText; ++i) { hashPieces(hk, S, buf, bufLength, text[i].input, text[i].length); }
+    GHASH(buf, bufLength, hk, S);
+    finishTag(ap, hk, ADATALength, textLength, S, ICB, calculatedTag);
+    const bool authentic = (0 == checkTag(calculatedTag, messageTag, tagLength));
+    secureWipe(calculatedTag, sizeof(calculatedTag));
+    if(!authentic) { return(false); }
+
+    // Decrypt, without hashing again.
+    bufLength = 0;
+    memcpy(ctrBlock, ICB, sizeof(ctrBlock));
+    incr32(ctrBlock);
+    for(size_t i = 0; i < nText; ++i)
+        { cryptPieces(ap, hk, ctrBlock, NULL, buf, keystream, bufLength, true, text[i].input, text[i].length, text[i].output); }
+    secureWipe(keystream, sizeof(keystream));
+    secureWipe(buf, sizeof(buf));
+    return(true);
+}
+
+/**
+ * @brief   encrypts and generates tag with key and H already set up
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   CDATALength     ciphertext length to authenticate: padded from checkEncryptParams(), or exact
+ * @param   tagLength       number of leading bytes of the tag to output
+ * @note    other parameters as for gcmEncrypt(); these must already have been checked
+ */
+static void encryptKeyed(const OTAES128E * const ap, const GHASHKey *hk,
+                         const uint8_t* IV,
+                         const uint8_t* PDATA, size_t PDATALength,
+                         const uint8_t* ADATA, size_t ADATALength,
+                         uint8_t* CDATA, size_t CDATALength, uint8_t *tag,
+                         const uint8_t tagLength = AES128GCM_TAG_SIZE)
+{
+    uint8_t ICB[AES128GCM_BLOCK_SIZE];
+    uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    memset(S, 0, sizeof(S));
+
+    generateICB(IV, ICB);
+    GHASH(ADATA, ADATALength, hk, S);
+
+    // Encrypt and hash whole blocks in a single pass.
+    memcpy(ctrBlock, ICB, sizeof(ctrBlock));
+    incr32(ctrBlock);
+    const size_t n = PDATALength / AES128GCM_BLOCK_SIZE;
+    const size_t nBytes = n * AES128GCM_BLOCK_SIZE;
+    ctr32EncryptHash(ap, ctrBlock, PDATA, CDATA, n, hk, false, S);
+
+    // Any partial block, then hash the rest of CDATA (including any padding).
+    GCTR(ap, PDATA + nBytes, PDATALength - nBytes, ctrBlock, CDATA + nBytes);
+    GHASH(CDATA + nBytes, CDATALength - nBytes, hk, S);
+
+    // Generate authentication tag, truncated if need be.
+    if(AES128GCM_TAG_SIZE == tagLength) { finishTag(ap, hk, ADATALength, CDATALength, S, ICB, tag); return; }
+    uint8_t fullTag[AES128GCM_TAG_SIZE];
+    finishTag(ap, hk, ADATALength, CDATALength, S, ICB, fullTag);
+    memcpy(tag, fullTag, tagLength);
+}
+
+/**
+ * @brief   decrypts and authenticates with key and H already set up
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   tagLength       number of leading bytes of the tag to check
+ * @note    other parameters as for gcmDecrypt(); these must already have been checked
+ * @retval  true if the tag matches, else false
+ */
+static bool decryptKeyed(const OTAES128E * const ap, const GHASHKey *hk,
+                         const uint8_t* IV,
+                         const uint8_t* CDATA, size_t CDATALength,
+                         const uint8_t* ADATA, size_t ADATALength,
+                         const uint8_t* messageTag, uint8_t *PDATA,
+                         const uint8_t tagLength = AES128GCM_TAG_SIZE)
+{
+    uint8_t ICB[AES128GCM_BLOCK_SIZE];
+    uint8_t calculatedTag[AES128GCM_TAG_SIZE];
+
+    // Authenticate first, so that a forged or corrupted message
+    // costs only the GHASH and never writes unauthenticated plaintext to PDATA.
+    generateICB(IV, ICB);
+    generateTag(ap, hk, ADATA, ADATALength, CDATA, CDATALength, calculatedTag, ICB);
+    const bool authentic = (0 == checkTag(calculatedTag, messageTag, tagLength));
+    secureWipe(calculatedTag, sizeof(calculatedTag));
+    if(!authentic) { return(false); }
+
+    // Decrypt CDATA.
+    generateCDATA(ap, ICB, CDATA, CDATALength, PDATA);
+    return(true);
+}
+
+/**
+ * @brief   computes a GMAC (authenticate-only GCM) tag with key and H already set up:
+ *          just the GHASH of the AAD and one block encryption for the tag mask
+ * @param   ap              AES implementation with the key already set
+ * @param   hk              GHASH key holding authentication subkey H
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   ADATA           pointer to additional data array; never NULL
+ * @param   ADATALength     length of additional data in bytes
+ * @param   tag             pointer to 16 byte buffer to output tag to; never NULL
+ */
+static void gmacKeyed(const OTAES128E * const ap, const GHASHKey *hk,
+                      const uint8_t *IV, const uint8_t *ADATA, size_t ADATALength,
+                      uint8_t *tag)
+{
+    uint8_t ICB[AES128GCM_BLOCK_SIZE];
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    memset(S, 0, sizeof(S));
+    generateICB(IV, ICB);
+    GHASH(ADATA, ADATALength, hk, S);
+    finishTag(ap, hk, ADATALength, 0, S, ICB, tag);
+}
+
+/**
+ * @brief   checks GMAC parameters
+ * @retval  true if parameters are acceptable, else false
+ */
+static bool checkGMACParams(const uint8_t *IV, const uint8_t *ADATA, size_t ADATALength, const uint8_t *tag)
+{
+    if((NULL == IV) || (NULL == ADATA) || (NULL == tag)) { return(false); }
+    // Fail if there is nothing to authenticate, as for encryption.
+    if(0 == ADATALength) { return(false); }
+    if((uint64_t)ADATALength > AES128GCM_MAX_AAD_LENGTH) { return(false); }
+    return(true);
+}
+
+/**
+ * @brief   checks a GMAC tag with key and H already set up
+ * @retval  true if the tag matches, else false
+ * @note    parameters as for gmacKeyed(), with the tag to check against
+ */
+static bool gmacVerifyKeyed(const OTAES128E * const ap, const GHASHKey *hk,
+                            const uint8_t *IV, const uint8_t *ADATA, size_t ADATALength,
+                            const uint8_t *messageTag)
+{
+    uint8_t calculatedTag[AES128GCM_TAG_SIZE];
+    gmacKeyed(ap, hk, IV, ADATA, ADATALength, calculatedTag);
+    const bool authentic = (0 == checkTag(calculatedTag, messageTag));
+    secureWipe(calculatedTag, sizeof(calculatedTag));
+    return(authentic);
+}
+
+
+/******************* Public Functions ********************/
+
+/**
+ * @brief   performs AES-GCM encryption.
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   PDATA           pointer to plaintext array, this is internally padded up to a multiple of the blocksize; NULL if length 0.
+ * @param   PDATALength     length of plaintext array in bytes, can be zero
+ * @param   ADATA           pointer to additional data array; NULL if length 0.
+ * @param   ADATALength     length of additional data in bytes, can be zero
+ * @param   CDATA           buffer to output ciphertext to, size MUST BE PADDED/EXPANDED TO FULL BLOCKSIZE MULTIPLE at/above PDATAlength;
+ *                          (nominally set to NULL if PDATA is NULL but seems to cause a crash)
+ * @param   tag             pointer to 16 byte buffer to output tag to; never NULL
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMGenericBase::gcmEncrypt(
+                        const uint8_t* key, const uint8_t* IV,
+                        const uint8_t* PDATA, uint8_t PDATALength,
+                        const uint8_t* ADATA, uint8_t ADATALength,
+                        uint8_t* CDATA, uint8_t *tag) const
+{
+    GHASHKey hashKey(ghashTable4);
+    uint8_t CDATALength;
+
+    if((NULL == key) || (NULL == IV) || (NULL == tag)) { return(false); }
+    if(!checkEncryptParams(PDATALength, ADATALength, CDATA, CDATALength)) { return(false); }
+
+    // Expand the key once for the whole message.
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    encryptKeyed(ap, &hashKey, IV, PDATA, PDATALength, ADATA, ADATALength, CDATA, CDATALength, tag);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(true);
+}
+
+
+/**
+ * @brief   performs AES-GCM decryption and authentication
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   CDATA           pointer to ciphertext array (multiple of block size, 16 bytes)
+ * @param   CDATALength     length of ciphertext array
+ * @param   ADATA           pointer to additional data array
+ * @param   ADATALength     length of additional data
+ * @param   PDATA           buffer to output plaintext to; must be same length as CDATA;
+ *                          not written to if authentication fails
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMGenericBase::gcmDecrypt(
+                        const uint8_t* key, const uint8_t* IV,
+                        const uint8_t* CDATA, uint8_t CDATALength,
+                        const uint8_t* ADATA, uint8_t ADATALength,
+                        const uint8_t* messageTag, uint8_t *PDATA) const
+{
+    GHASHKey hashKey(ghashTable4);
+
+    if((NULL == key) || (NULL == IV) || (NULL == messageTag)) { return(false); }
+    if(!checkDecryptParams(CDATALength, ADATALength)) { return(false); }
+
+    // Expand the key once for the whole message.
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    const bool result = decryptKeyed(ap, &hashKey, IV, CDATA, CDATALength, ADATA, ADATALength, messageTag, PDATA);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(result);
+}
+
+
+/**
+ * @brief   performs standard AES-GCM encryption on exact lengths up to the GCM limits
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   PDATA           pointer to plaintext array; NULL if length 0
+ * @param   PDATALength     length of plaintext array in bytes, can be zero, at most 2^36 - 32
+ * @param   ADATA           pointer to additional data array; NULL if length 0
+ * @param   ADATALength     length of additional data in bytes, can be zero
+ * @param   CDATA           buffer to output PDATALength bytes of ciphertext to; NULL if length 0
+ * @param   tag             pointer to tagLength byte buffer to output tag to; never NULL
+ * @param   tagLength       tag length in bytes: 16, or truncated to 15, 14, 13, 12, 8 or 4
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMGenericBase::gcmEncryptLong(
+                        const uint8_t* key, const uint8_t* IV,
+                        const uint8_t* PDATA, size_t PDATALength,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        uint8_t* CDATA, uint8_t *tag, const uint8_t tagLength) const
+{
+    GHASHKey hashKey(ghashTable4);
+
+    if((NULL == key) || (NULL == IV) || (NULL == tag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkLongParams(PDATALength, ADATALength, PDATA, CDATA)) { return(false); }
+
+    // Expand the key once for the whole message.
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    encryptKeyed(ap, &hashKey, IV, PDATA, PDATALength, ADATA, ADATALength, CDATA, PDATALength, tag, tagLength);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM decryption and authentication on exact lengths up to the GCM limits
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   CDATA           pointer to ciphertext array; NULL if length 0
+ * @param   CDATALength     length of ciphertext array in bytes, can be zero, at most 2^36 - 32
+ * @param   ADATA           pointer to additional data array; NULL if length 0
+ * @param   ADATALength     length of additional data in bytes, can be zero
+ * @param   messageTag      pointer to tagLength byte tag to authenticate against; never NULL
+ * @param   PDATA           buffer to output CDATALength bytes of plaintext to; NULL if length 0
+ * @param   tagLength       tag length in bytes: 16, or truncated to 15, 14, 13, 12, 8 or 4
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMGenericBase::gcmDecryptLong(
+                        const uint8_t* key, const uint8_t* IV,
+                        const uint8_t* CDATA, size_t CDATALength,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        const uint8_t* messageTag, uint8_t *PDATA, const uint8_t tagLength) const
+{
+    GHASHKey hashKey(ghashTable4);
+
+    if((NULL == key) || (NULL == IV) || (NULL == messageTag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkLongParams(CDATALength, ADATALength, CDATA, PDATA)) { return(false); }
+
+    // Expand the key once for the whole message.
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    const bool result = decryptKeyed(ap, &hashKey, IV, CDATA, CDATALength, ADATA, ADATALength, messageTag, PDATA, tagLength);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(result);
+}
+
+
+/**
+ * @brief   performs standard AES-GCM encryption in place on a single frame buffer
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   frame           frame buffer; the body is overwritten with ciphertext and the tag slot with the tag
+ * @param   frameLength     length of frame buffer in bytes
+ * @param   ADATALength     length of additional data (eg header) at the start of the frame, can be zero
+ * @param   bodyOffset      offset of the body in the frame, at or after the additional data
+ * @param   bodyLength      length of body in bytes, can be zero; not padded
+ * @param   tagOffset       offset of the tag slot, after the additional data and not overlapping the body
+ * @param   tagLength       tag length in bytes: 16, or truncated to 15, 14, 13, 12, 8 or 4
+ * @retval  true if encryption successful, else false (and the frame is unchanged)
+ */
+bool OTAES128GCMGenericBase::gcmEncryptInPlace(
+                        const uint8_t* key, const uint8_t* IV,
+                        uint8_t *frame, uint8_t frameLength,
+                        uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                        uint8_t tagOffset, const uint8_t tagLength) const
+{
+    GHASHKey hashKey(ghashTable4);
+
+    if((NULL == key) || (NULL == IV)) { return(false); }
+    if(!checkFrameParams(frame, frameLength, ADATALength, bodyOffset, bodyLength, tagOffset, tagLength)) { return(false); }
+
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    uint8_t *const body = frame + bodyOffset;
+    encryptKeyed(ap, &hashKey, IV, body, bodyLength, frame, ADATALength, body, bodyLength, frame + tagOffset, tagLength);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM decryption and authentication in place on a single frame buffer
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   frame           frame buffer; the body is overwritten with plaintext only if authentic
+ * @note    other parameters as for gcmEncryptInPlace()
+ * @retval  true if decryption and authentication successful, else false (and the frame is unchanged)
+ */
+bool OTAES128GCMGenericBase::gcmDecryptInPlace(
+                        const uint8_t* key, const uint8_t* IV,
+                        uint8_t *frame, uint8_t frameLength,
+                        uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                        uint8_t tagOffset, const uint8_t tagLength) const
+{
+    GHASHKey hashKey(ghashTable4);
+
+    if((NULL == key) || (NULL == IV)) { return(false); }
+    if(!checkFrameParams(frame, frameLength, ADATALength, bodyOffset, bodyLength, tagOffset, tagLength)) { return(false); }
+
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    uint8_t *const body = frame + bodyOffset;
+    const bool result = decryptKeyed(ap, &hashKey, IV, body, bodyLength, frame, ADATALength, frame + tagOffset, body, tagLength);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(result);
+}
+
+
+/**
+ * @brief   computes a GMAC tag, ie authenticates ADATA only (GCM with no text)
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   ADATA           pointer to data to authenticate; never NULL
+ * @param   ADATALength     length of ADATA in bytes, strictly positive
+ * @param   tag             pointer to 16 byte buffer to output tag to; never NULL
+ * @retval  true if successful, else false
+ */
+bool OTAES128GCMGenericBase::gmacCompute(
+                        const uint8_t* key, const uint8_t* IV,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        uint8_t *tag) const
+{
+    GHASHKey hashKey(ghashTable4);
+
+    if(NULL == key) { return(false); }
+    if(!checkGMACParams(IV, ADATA, ADATALength, tag)) { return(false); }
+
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    gmacKeyed(ap, &hashKey, IV, ADATA, ADATALength, tag);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(true);
+}
+
+/**
+ * @brief   checks a GMAC tag over ADATA
+ * @param   messageTag      pointer to 16 byte tag to authenticate against; never NULL
+ * @note    other parameters as for gmacCompute()
+ * @retval  true if ADATA is authentic, else false
+ */
+bool OTAES128GCMGenericBase::gmacVerify(
+                        const uint8_t* key, const uint8_t* IV,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        const uint8_t *messageTag) const
+{
+    GHASHKey hashKey(ghashTable4);
+
+    if(NULL == key) { return(false); }
+    if(!checkGMACParams(IV, ADATA, ADATALength, messageTag)) { return(false); }
+
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    const bool result = gmacVerifyKeyed(ap, &hashKey, IV, ADATA, ADATALength, messageTag);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(result);
+}
+
+/**
+ * @brief   performs standard AES-GCM encryption of scatter-gather segments
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   ADATA           array of nADATA AAD segments; NULL if nADATA is 0
+ * @param   nADATA          number of AAD segments
+ * @param   text            array of nText text segments; NULL if nText is 0
+ * @param   nText           number of text segments
+ * @param   tag             pointer to tagLength byte buffer to output tag to; never NULL
+ * @param   tagLength       tag length in bytes: 16, or truncated to 15, 14, 13, 12, 8 or 4
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMGenericBase::gcmEncryptSegments(
+                        const uint8_t* key, const uint8_t* IV,
+                        const OTAES128GCMSegment *ADATA, size_t nADATA,
+                        const OTAES128GCMTextSegment *text, size_t nText,
+                        uint8_t *tag, const uint8_t tagLength) const
+{
+    GHASHKey hashKey(ghashTable4);
+    uint64_t ADATALength, textLength;
+
+    if((NULL == key) || (NULL == IV) || (NULL == tag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkSegmentParams(ADATA, nADATA, text, nText, ADATALength, textLength)) { return(false); }
+
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    encryptSegmentsKeyed(ap, &hashKey, IV, ADATA, nADATA, text, nText, ADATALength, textLength, tag, tagLength);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM decryption and authentication of scatter-gather segments
+ * @param   messageTag      pointer to tagLength byte tag to authenticate against; never NULL
+ * @note    other parameters as for gcmEncryptSegments()
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMGenericBase::gcmDecryptSegments(
+                        const uint8_t* key, const uint8_t* IV,
+                        const OTAES128GCMSegment *ADATA, size_t nADATA,
+                        const OTAES128GCMTextSegment *text, size_t nText,
+                        const uint8_t *messageTag, const uint8_t tagLength) const
+{
+    GHASHKey hashKey(ghashTable4);
+    uint64_t ADATALength, textLength;
+
+    if((NULL == key) || (NULL == IV) || (NULL == messageTag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkSegmentParams(ADATA, nADATA, text, nText, ADATALength, textLength)) { return(false); }
+
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+
+    const bool result = decryptSegmentsKeyed(ap, &hashKey, IV, ADATA, nADATA, text, nText,
+                                             ADATALength, textLength, messageTag, tagLength);
+
+    // Wipe the key schedule and H.
+    ap->clearKey();
+    hashKey.clear();
+
+    return(result);
+}
+
+
+/**
+ * @brief   sets (or replaces) the key, caching the key schedule and H
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @retval  true if the key was set, else false
+ */
+bool OTAES128GCMKeyedBase::setKey(const uint8_t *key)
+{
+    clearKey();
+    if(NULL == key) { return(false); }
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+    keyed = true;
+    return(true);
+}
+
+/**
+ * @brief   securely wipes the cached key schedule and H
+ */
+void OTAES128GCMKeyedBase::clearKey()
+{
+    ap->clearKey();
+    hashKey.clear();
+    keyed = false;
+}
+
+/**
+ * @brief   performs AES-GCM encryption with the cached key; see gcmEncrypt()
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMKeyedBase::seal(const uint8_t* IV,
+                        const uint8_t* PDATA, uint8_t PDATALength,
+                        const uint8_t* ADATA, uint8_t ADATALength,
+                        uint8_t* CDATA, uint8_t *tag) const
+{
+    uint8_t CDATALength;
+    if(!keyed) { return(false); }
+    if((NULL == IV) || (NULL == tag)) { return(false); }
+    if(!checkEncryptParams(PDATALength, ADATALength, CDATA, CDATALength)) { return(false); }
+    encryptKeyed(ap, &hashKey, IV, PDATA, PDATALength, ADATA, ADATALength, CDATA, CDATALength, tag);
+    return(true);
+}
+
+/**
+ * @brief   performs AES-GCM decryption and authentication with the cached key; see gcmDecrypt()
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMKeyedBase::open(const uint8_t* IV,
+                        const uint8_t* CDATA, uint8_t CDATALength,
+                        const uint8_t* ADATA, uint8_t ADATALength,
+                        const uint8_t* messageTag, uint8_t *PDATA) const
+{
+    if(!keyed) { return(false); }
+    if((NULL == IV) || (NULL == messageTag)) { return(false); }
+    if(!checkDecryptParams(CDATALength, ADATALength)) { return(false); }
+    return(decryptKeyed(ap, &hashKey, IV, CDATA, CDATALength, ADATA, ADATALength, messageTag, PDATA));
+}
+
+/**
+ * @brief   performs standard AES-GCM encryption on exact lengths with the cached key; see gcmEncryptLong()
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMKeyedBase::sealLong(const uint8_t* IV,
+                        const uint8_t* PDATA, size_t PDATALength,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        uint8_t* CDATA, uint8_t *tag, const uint8_t tagLength) const
+{
+    if(!keyed) { return(false); }
+    if((NULL == IV) || (NULL == tag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkLongParams(PDATALength, ADATALength, PDATA, CDATA)) { return(false); }
+    encryptKeyed(ap, &hashKey, IV, PDATA, PDATALength, ADATA, ADATALength, CDATA, PDATALength, tag, tagLength);
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM decryption and authentication on exact lengths with the cached key; see gcmDecryptLong()
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMKeyedBase::openLong(const uint8_t* IV,
+                        const uint8_t* CDATA, size_t CDATALength,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        const uint8_t* messageTag, uint8_t *PDATA, const uint8_t tagLength) const
+{
+    if(!keyed) { return(false); }
+    if((NULL == IV) || (NULL == messageTag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkLongParams(CDATALength, ADATALength, CDATA, PDATA)) { return(false); }
+    return(decryptKeyed(ap, &hashKey, IV, CDATA, CDATALength, ADATA, ADATALength, messageTag, PDATA, tagLength));
+}
+
+/**
+ * @brief   performs standard AES-GCM encryption in place on a single frame buffer with the cached key; see gcmEncryptInPlace()
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMKeyedBase::sealInPlace(const uint8_t* IV,
+                        uint8_t *frame, uint8_t frameLength,
+                        uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                        uint8_t tagOffset, const uint8_t tagLength) const
+{
+    if(!keyed) { return(false); }
+    if(NULL == IV) { return(false); }
+    if(!checkFrameParams(frame, frameLength, ADATALength, bodyOffset, bodyLength, tagOffset, tagLength)) { return(false); }
+    uint8_t *const body = frame + bodyOffset;
+    encryptKeyed(ap, &hashKey, IV, body, bodyLength, frame, ADATALength, body, bodyLength, frame + tagOffset, tagLength);
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM decryption and authentication in place on a single frame buffer with the cached key; see gcmDecryptInPlace()
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMKeyedBase::openInPlace(const uint8_t* IV,
+                        uint8_t *frame, uint8_t frameLength,
+                        uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                        uint8_t tagOffset, const uint8_t tagLength) const
+{
+    if(!keyed) { return(false); }
+    if(NULL == IV) { return(false); }
+    if(!checkFrameParams(frame, frameLength, ADATALength, bodyOffset, bodyLength, tagOffset, tagLength)) { return(false); }
+    uint8_t *const body = frame + bodyOffset;
+    return(decryptKeyed(ap, &hashKey, IV, body, bodyLength, frame, ADATALength, frame + tagOffset, body, tagLength));
+}
+
+/**
+ * @brief   computes a GMAC tag over ADATA with the cached key; see gmacCompute()
+ * @retval  true if successful, else false (including if not keyed)
+ */
+bool OTAES128GCMKeyedBase::gmacCompute(const uint8_t* IV,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        uint8_t *tag) const
+{
+    if(!keyed) { return(false); }
+    if(!checkGMACParams(IV, ADATA, ADATALength, tag)) { return(false); }
+    gmacKeyed(ap, &hashKey, IV, ADATA, ADATALength, tag);
+    return(true);
+}
+
+/**
+ * @brief   checks a GMAC tag over ADATA with the cached key; see gmacVerify()
+ * @retval  true if ADATA is authentic, else false (including if not keyed)
+ */
+bool OTAES128GCMKeyedBase::gmacVerify(const uint8_t* IV,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        const uint8_t *messageTag) const
+{
+    if(!keyed) { return(false); }
+    if(!checkGMACParams(IV, ADATA, ADATALength, messageTag)) { return(false); }
+    return(gmacVerifyKeyed(ap, &hashKey, IV, ADATA, ADATALength, messageTag));
+}
+
+// Layout of a buffer from prepare(): flag, IV, tag mask, keystream.
+static constexpr uint8_t PREPARED_READY = 0xa5; // Flag value for a prepared and unused buffer.
+static constexpr size_t PREPARED_IV = 1;
+static constexpr size_t PREPARED_MASK = PREPARED_IV + AES128GCM_IV_SIZE;
+static constexpr size_t PREPARED_KEYSTREAM = PREPARED_MASK + AES128GCM_BLOCK_SIZE;
+static_assert(PREPARED_KEYSTREAM == AES128GCM_PREPARED_OVERHEAD, "prepared buffer layout");
+
+/**
+ * @brief   precomputes the tag mask and keystream for one future message
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   prepared        buffer to fill; never NULL
+ * @param   preparedSize    size of prepared in bytes, gcmPreparedSize() of the longest text to seal
+ * @retval  true if successful, else false
+ */
+bool OTAES128GCMKeyedBase::prepare(const uint8_t* IV, uint8_t *prepared, const size_t preparedSize) const
+{
+    if(!keyed) { return(false); }
+    if((NULL == IV) || (NULL == prepared)) { return(false); }
+    if(preparedSize < AES128GCM_PREPARED_OVERHEAD) { return(false); }
+    if((uint64_t)(preparedSize - AES128GCM_PREPARED_OVERHEAD) > AES128GCM_MAX_TEXT_LENGTH) { return(false); }
+
+    uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
+    memcpy(prepared + PREPARED_IV, IV, AES128GCM_IV_SIZE);
+    generateICB(IV, ctrBlock);
+    ap->blockEncryptKeyed(ctrBlock, prepared + PREPARED_MASK);
+    incr32(ctrBlock);
+
+    // Keystream: counter mode over zeros, whole blocks then any partial block.
+    uint8_t *const ks = prepared + PREPARED_KEYSTREAM;
+    const size_t length = preparedSize - AES128GCM_PREPARED_OVERHEAD;
+    const size_t n = length / AES128GCM_BLOCK_SIZE;
+    const size_t nBytes = n * AES128GCM_BLOCK_SIZE;
+    memset(ks, 0, nBytes);
+    ap->ctr32EncryptKeyed(ctrBlock, ks, ks, n);
+    if(length > nBytes)
+    {
+        uint8_t tmp[AES128GCM_BLOCK_SIZE];
+        ap->blockEncryptKeyed(ctrBlock, tmp);
+        memcpy(ks + nBytes, tmp, length - nBytes);
+        secureWipe(tmp, sizeof(tmp));
+    }
+    prepared[0] = PREPARED_READY;
+    return(true);
+}
+
+/**
+ * @brief   seals one message using a buffer from prepare(), which is then wiped
+ * @param   prepared        buffer filled by prepare(); never NULL
+ * @param   preparedSize    size of prepared in bytes, as passed to prepare()
+ * @note    other parameters as for sealLong()
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMKeyedBase::sealPrepared(uint8_t *prepared, const size_t preparedSize,
+                        const uint8_t* PDATA, size_t PDATALength,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        uint8_t* CDATA, uint8_t *tag, const uint8_t tagLength) const
+{
+    if(!keyed) { return(false); }
+    if((NULL == prepared) || (NULL == tag)) { return(false); }
+    if((preparedSize < AES128GCM_PREPARED_OVERHEAD) || (PREPARED_READY != prepared[0])) { return(false); }
+    if(PDATALength > preparedSize - AES128GCM_PREPARED_OVERHEAD) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkLongParams(PDATALength, ADATALength, PDATA, CDATA)) { return(false); }
+
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    memset(S, 0, sizeof(S));
+    xorKeystream(PDATA, prepared + PREPARED_KEYSTREAM, CDATA, PDATALength);
+    GHASH(ADATA, ADATALength, &hashKey, S);
+    GHASH(CDATA, PDATALength, &hashKey, S);
+    maskTag(&hashKey, ADATALength, PDATALength, S, prepared + PREPARED_MASK, S);
+    memcpy(tag, S, tagLength);
+
+    // Never use this keystream again.
+    secureWipe(prepared, preparedSize);
+    secureWipe(S, sizeof(S));
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM encryption of scatter-gather segments with the cached key; see gcmEncryptSegments()
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMKeyedBase::sealSegments(const uint8_t* IV,
+                        const OTAES128GCMSegment *ADATA, size_t nADATA,
+                        const OTAES128GCMTextSegment *text, size_t nText,
+                        uint8_t *tag, const uint8_t tagLength) const
+{
+    uint64_t ADATALength, textLength;
+    if(!keyed) { return(false); }
+    if((NULL == IV) || (NULL == tag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkSegmentParams(ADATA, nADATA, text, nText, ADATALength, textLength)) { return(false); }
+    encryptSegmentsKeyed(ap, &hashKey, IV, ADATA, nADATA, text, nText, ADATALength, textLength, tag, tagLength);
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM decryption and authentication of scatter-gather segments with the cached key; see gcmDecryptSegments()
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMKeyedBase::openSegments(const uint8_t* IV,
+                        const OTAES128GCMSegment *ADATA, size_t nADATA,
+                        const OTAES128GCMTextSegment *text, size_t nText,
+                        const uint8_t *messageTag, const uint8_t tagLength) const
+{
+    uint64_t ADATALength, textLength;
+    if(!keyed) { return(false); }
+    if((NULL == IV) || (NULL == messageTag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkSegmentParams(ADATA, nADATA, text, nText, ADATALength, textLength)) { return(false); }
+    return(decryptSegmentsKeyed(ap, &hashKey, IV, ADATA, nADATA, text, nText, ADATALength, textLength, messageTag, tagLength));
+}
+
+/**
+ * @brief   checks one frame for sealBatch()/openBatch() as sealLong()/openLong() would
+ * @retval  true if the frame can be processed, else false
+ */
+static bool checkBatchFrame(const OTAES128GCMBatchFrame &f)
+{
+    if((NULL == f.context) || !f.context->isKeyed()) { return(false); }
+    if((NULL == f.IV) || (NULL == f.tag)) { return(false); }
+    if(!isValidGCMTagLength(f.tagLength)) { return(false); }
+    return(checkLongParams(f.textLength, f.ADATALength, f.input, f.output));
+}
+
+/**
+ * @brief   writes counter block J0 + 1 + index (index < 2^32 - 1) into pOutput
+ */
+static void counterBlock(const uint8_t *pIV, const uint32_t index, uint8_t *pOutput)
+{
+    const uint32_t ctr = 2 + index;
+    memcpy(pOutput, pIV, AES128GCM_IV_SIZE);
+    pOutput[12] = (uint8_t)(ctr >> 24);
+    pOutput[13] = (uint8_t)(ctr >> 16);
+    pOutput[14] = (uint8_t)(ctr >> 8);
+    pOutput[15] = (uint8_t)ctr;
+}
+
+/**
+ * @brief   true if a frame is short enough to be hashed from hashBuffer in processBatch()
+ */
+static bool isShortBatchFrame(const OTAES128GCMBatchFrame &f)
+{
+    return(paddedLength(f.ADATALength) + paddedLength(f.textLength) + AES128GCM_BLOCK_SIZE <=
+           GCM_BATCH_HASH_BLOCKS * AES128GCM_BLOCK_SIZE);
+}
+
+/**
+ * @brief   true if a short frame has its whole keystream precomputed in processBatch()
+ */
+static bool hasBatchKeystream(const OTAES128GCMBatchFrame &f)
+{
+    return((f.textLength / AES128GCM_BLOCK_SIZE < GCM_BATCH_KEYSTREAM_BLOCKS) && isShortBatchFrame(f));
+}
+
+/**
+ * @brief   number of blocks a valid frame has precomputed in processBatch()
+ *
+ * J0 for the tag mask, then for a small short frame its whole counter-mode keystream,
+ * else just the counter block for any partial final block.
+ */
+static size_t batchFrameBlocks(const OTAES128GCMBatchFrame &f)
+{
+    if(hasBatchKeystream(f)) { return(1 + paddedLength(f.textLength) / AES128GCM_BLOCK_SIZE); }
+    return((0 != (f.textLength % AES128GCM_BLOCK_SIZE)) ? 2 : 1);
+}
+
+/**
+ * @brief   counter-mode encryption of a frame's text in processBatch()
+ * @param   allKs           true if textKs holds all the keystream, else just that for any partial final block
+ * @param   ctrBlock        counter block for the first block, used if not allKs
+ */
+static void batchCTR(const OTAES128E * const ap, const bool allKs, uint8_t *ctrBlock, const uint8_t *textKs,
+                     const uint8_t *input, uint8_t *output, const size_t length)
+{
+    if(allKs) { xorKeystream(input, textKs, output, length); return; }
+    const size_t n = length / AES128GCM_BLOCK_SIZE;
+    const size_t nBytes = n * AES128GCM_BLOCK_SIZE;
+    ap->ctr32EncryptKeyed(ctrBlock, input, output, n);
+    xorKeystream(input + nBytes, textKs, output + nBytes, length - nBytes);
+}
+
+// Any one frame fits in a window.
+static_assert(1 + GCM_BATCH_KEYSTREAM_BLOCKS <= GCM_BATCH_BLOCKS, "a frame must fit in one batch");
+
+/**
+ * @brief   seals or opens frames; see sealBatch() and openBatch()
+ * @param   decrypt         true to open, false to seal
+ *
+ * The blocks that would otherwise be encrypted a few at a time
+ * (the tag mask E(K, J0), and the whole keystream of a frame of under GCM_BATCH_KEYSTREAM_BLOCKS blocks
+ * or else the counter for its partial final block)
+ * are gathered from a window of consecutive valid frames, whatever their contexts,
+ * and encrypted together by ecbEncryptLanes() in up to GCM_BATCH_BLOCKS blocks,
+ * so that they are interleaved with each other even under different keys;
+ * the whole text blocks of each larger frame then go through the usual pipelined CTR/GHASH.
+ */
+size_t OTAES128GCMKeyedBase::processBatch(const OTAES128GCMBatchFrame *frames, size_t nFrames,
+                                          uint8_t *okBitmap, const bool decrypt)
+{
+    if((NULL == frames) || (NULL == okBitmap)) { return(0); }
+    memset(okBitmap, 0, (nFrames + 7) / 8);
+
+    const OTAES128E *lanes[GCM_BATCH_BLOCKS];
+    uint8_t ctrBlocks[GCM_BATCH_BLOCKS * AES128GCM_BLOCK_SIZE];
+    uint8_t keystream[GCM_BATCH_BLOCKS * AES128GCM_BLOCK_SIZE];
+    uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    uint8_t hashBuffer[GCM_BATCH_HASH_BLOCKS * AES128GCM_BLOCK_SIZE];
+    size_t maxBlocks = 0;
+    size_t nOK = 0;
+    size_t i = 0;
+    while(i < nFrames)
+    {
+        // Gather the blocks to precompute for a window of frames;
+        // bad frames are skipped, leaving their bits clear.
+        size_t end = i;
+        size_t nBlocks = 0;
+        for( ; end < nFrames; ++end)
+        {
+            const OTAES128GCMBatchFrame &f = frames[end];
+            if(!checkBatchFrame(f)) { continue; }
+            const size_t m = batchFrameBlocks(f);
+            if(nBlocks + m > GCM_BATCH_BLOCKS) { break; }
+            uint8_t *p = ctrBlocks + nBlocks * AES128GCM_BLOCK_SIZE;
+            generateICB(f.IV, p);
+            if(hasBatchKeystream(f))
+            {
+                for(size_t j = 1; j < m; ++j) { counterBlock(f.IV, (uint32_t)(j - 1), p + j * AES128GCM_BLOCK_SIZE); }
+            }
+            // Counter index is the number of whole blocks; fits in 32 bits given AES128GCM_MAX_TEXT_LENGTH.
+            else if(2 == m) { counterBlock(f.IV, (uint32_t)(f.textLength / AES128GCM_BLOCK_SIZE), p + AES128GCM_BLOCK_SIZE); }
+            for(size_t j = 0; j < m; ++j) { lanes[nBlocks + j] = f.context->ap; }
+            nBlocks += m;
+        }
+        ecbEncryptLanes(lanes, ctrBlocks, keystream, nBlocks);
+        if(nBlocks > maxBlocks) { maxBlocks = nBlocks; }
+
+        // Then each frame in turn, using its precomputed blocks.
+        const uint8_t *ks = keystream;
+        for( ; i < end; ++i)
+        {
+            const OTAES128GCMBatchFrame &f = frames[i];
+            if(!checkBatchFrame(f)) { continue; }
+            const OTAES128GCMKeyedBase *const ctx = f.context;
+            const size_t n = f.textLength / AES128GCM_BLOCK_SIZE;
+            const size_t nBytes = n * AES128GCM_BLOCK_SIZE;
+            const size_t last = f.textLength - nBytes;
+            const uint8_t *const mask = ks;
+            const uint8_t *const textKs = ks + AES128GCM_BLOCK_SIZE;
+            ks += batchFrameBlocks(f) * AES128GCM_BLOCK_SIZE;
+            const bool allKs = hasBatchKeystream(f);
+            // Counter for the first text block, if not all precomputed.
+            generateICB(f.IV, ctrBlock);
+            incr32(ctrBlock);
+            memset(S, 0, sizeof(S));
+            if(isShortBatchFrame(f))
+            {
+                // Short frame: hash A || C || lengths in one go, with a single reduction.
+                const size_t paddedA = paddedLength(f.ADATALength);
+                const size_t paddedC = paddedLength(f.textLength);
+                memset(hashBuffer, 0, paddedA + paddedC);
+                if(0 != f.ADATALength) { memcpy(hashBuffer, f.ADATA, f.ADATALength); }
+                uint8_t *const C = hashBuffer + paddedA;
+                if(!decrypt) { batchCTR(ctx->ap, allKs, ctrBlock, textKs, f.input, C, f.textLength); }
+                else if(0 != f.textLength) { memcpy(C, f.input, f.textLength); }
+                generateLengthBlock(f.ADATALength, f.textLength, C + paddedC);
+                GHASH(hashBuffer, paddedA + paddedC + AES128GCM_BLOCK_SIZE, &ctx->hashKey, S);
+                for(uint8_t j = 0; j < AES128GCM_BLOCK_SIZE; ++j) { S[j] ^= mask[j]; }
+                if(!decrypt)
+                {
+                    if(0 != f.textLength) { memcpy(f.output, C, f.textLength); }
+                    memcpy(f.tag, S, f.tagLength);
+                }
+                // Authenticate before writing any plaintext.
+                else if(0 != checkTag(S, f.tag, f.tagLength)) { continue; }
+                else { batchCTR(ctx->ap, allKs, ctrBlock, textKs, f.input, f.output, f.textLength); }
+            }
+            else if(decrypt)
+            {
+                // Authenticate before writing any plaintext.
+                GHASH(f.ADATA, f.ADATALength, &ctx->hashKey, S);
+                GHASH(f.input, f.textLength, &ctx->hashKey, S);
+                maskTag(&ctx->hashKey, f.ADATALength, f.textLength, S, mask, S);
+                if(0 != checkTag(S, f.tag, f.tagLength)) { continue; }
+                batchCTR(ctx->ap, false, ctrBlock, textKs, f.input, f.output, f.textLength);
+            }
+            else
+            {
+                GHASH(f.ADATA, f.ADATALength, &ctx->hashKey, S);
+                ctr32EncryptHash(ctx->ap, ctrBlock, f.input, f.output, n, &ctx->hashKey, false, S);
+                xorKeystream(f.input + nBytes, textKs, f.output + nBytes, last);
+                GHASH(f.output + nBytes, last, &ctx->hashKey, S);
+                maskTag(&ctx->hashKey, f.ADATALength, f.textLength, S, mask, S);
+                memcpy(f.tag, S, f.tagLength);
+            }
+            okBitmap[i / 8] |= (uint8_t)(1U << (i % 8));
+            ++nOK;
+        }
+    }
+    // The keystream is overwritten by each window, so wipe just once.
+    secureWipe(keystream, maxBlocks * AES128GCM_BLOCK_SIZE);
+    secureWipe(S, sizeof(S));
+    secureWipe(hashBuffer, sizeof(hashBuffer));
+    return(nOK);
+}
+
+#ifdef OTAESGCM_THREADS
+// What each thread of sealParallel()/openParallel() does with its share.
+enum : uint8_t
+{
+    SHARE_SEAL, // encrypt, and hash the ciphertext output
+    SHARE_HASH, // hash the input only
+    SHARE_CTR   // counter mode only
+};
+
+/**
+ * @brief   checks that contexts for sealParallel()/openParallel() are usable together
+ * @retval  true if all nContexts (at least 1) contexts are present and keyed with the same key, else false
+ */
+bool OTAES128GCMKeyedBase::checkParallelContexts(const OTAES128GCMKeyedBase *const *contexts, const uint8_t nContexts)
+{
+    if((NULL == contexts) || (0 == nContexts)) { return(false); }
+    for(uint8_t i = 0; i < nContexts; ++i)
+    {
+        if((NULL == contexts[i]) || !contexts[i]->keyed) { return(false); }
+        // Same H implies the same key.
+        if(0 != memcmp(contexts[i]->hashKey.H, contexts[0]->hashKey.H, AES128GCM_BLOCK_SIZE)) { return(false); }
+    }
+    return(true);
+}
+
+/**
+ * @brief   processes one thread's share of the text
+ * @param   ctx             context for this thread alone
+ * @param   ICB             initial counter block J0 of the message
+ * @param   input           start of whole message input text
+ * @param   output          start of whole message output text; unused for SHARE_HASH
+ * @param   firstBlock      index of the first block of the share in the message
+ * @param   length          length of the share in bytes; only the last share may end with a partial block
+ * @param   foldPower       number of (padded) text blocks after this share
+ * @param   mode            SHARE_SEAL, SHARE_HASH or SHARE_CTR
+ * @param   digest          16 byte output: GHASH of the share from zero, multiplied by H^foldPower;
+ *                          unused for SHARE_CTR
+ */
+void OTAES128GCMKeyedBase::runShare(const OTAES128GCMKeyedBase *const ctx, const uint8_t *const ICB,
+                                   const uint8_t *input, uint8_t *output, const size_t firstBlock, const size_t length,
+                                   const uint64_t foldPower, const uint8_t mode, uint8_t *const digest)
+{
+    const GHASHKey *const hk = &ctx->hashKey;
+    const size_t n = length / AES128GCM_BLOCK_SIZE;
+    const size_t nBytes = n * AES128GCM_BLOCK_SIZE;
+    const size_t offset = firstBlock * AES128GCM_BLOCK_SIZE;
+    input += offset;
+    if(SHARE_HASH != mode) { output += offset; }
+
+    // Counter J0 + 1 + firstBlock, modulo 2^32 in the last 4 bytes.
+    uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
+    memcpy(ctrBlock, ICB, AES128GCM_BLOCK_SIZE);
+    uint32_t ctr = ((uint32_t)ctrBlock[12] << 24) | ((uint32_t)ctrBlock[13] << 16) |
+                   ((uint32_t)ctrBlock[14] << 8) | ctrBlock[15];
+    ctr += (uint32_t)(1 + firstBlock);
+    ctrBlock[12] = (uint8_t)(ctr >> 24);
+    ctrBlock[13] = (uint8_t)(ctr >> 16);
+    ctrBlock[14] = (uint8_t)(ctr >> 8);
+    ctrBlock[15] = (uint8_t)ctr;
+
+    memset(digest, 0, AES128GCM_BLOCK_SIZE);
+    if(SHARE_SEAL == mode)
+    {
+        ctr32EncryptHash(ctx->ap, ctrBlock, input, output, n, hk, false, digest);
+        GCTR(ctx->ap, input + nBytes, length - nBytes, ctrBlock, output + nBytes);
+        GHASH(output + nBytes, length - nBytes, hk, digest);
+    }
+    else if(SHARE_HASH == mode) { GHASH(input, length, hk, digest); }
+    else { GCTR(ctx->ap, input, length, ctrBlock, output); }
+    if(SHARE_CTR != mode) { GHASHMulHPower(hk, foldPower, digest); }
+}
+
+// The shares of one runParallel() call, for runShareTask().
+struct ParallelJob
+{
+    const OTAES128GCMKeyedBase *const *contexts;
+    uint8_t nContexts;
+    const uint8_t *ICB;
+    const uint8_t *input;
+    uint8_t *output;
+    uint8_t mode;
+    const size_t *shareFirst;
+    const size_t *shareLength;
+    const uint64_t *sharePower;
+    uint8_t (*digests)[AES128GCM_BLOCK_SIZE];
+};
+
+/**
+ * @brief   runs one share of a ParallelJob, with the contexts used in turn
+ * @param   job             the ParallelJob
+ * @param   share           index of the share
+ */
+void OTAES128GCMKeyedBase::runShareTask(void *const job, const uint8_t share)
+{
+    const ParallelJob *const j = (const ParallelJob *)job;
+    runShare(j->contexts[share % j->nContexts], j->ICB, j->input, j->output,
+             j->shareFirst[share], j->shareLength[share], j->sharePower[share], j->mode, j->digests[share]);
+}
+
+/**
+ * @brief   splits the text into nShares shares and runs them,
+ *          on the pool if one is started, else one per thread started here
+ *          with the first on the caller's thread, then folds their hashes into S
+ * @param   pool            started pool of worker threads to use, else NULL
+ * @param   contexts        nContexts contexts keyed with the same key; without a pool, at least nShares
+ * @param   nShares         number of shares, at least 1 and at most GCM_PARALLEL_MAX_THREADS
+ * @param   S               16 byte running hash over A, updated to cover the text too
+ *                          (unchanged for SHARE_CTR)
+ * @note    other parameters as for runShare()
+ */
+void OTAES128GCMKeyedBase::runParallel(OTAES128GCMThreadPool *const pool,
+                                       const OTAES128GCMKeyedBase *const *contexts, const uint8_t nContexts,
+                                       const uint8_t nShares,
+                                       const uint8_t *ICB, const uint8_t *input, uint8_t *output,
+                                       const size_t textLength, const uint8_t mode, uint8_t *S)
+{
+    // Sized by the cap on threads rather than by any uint8_t count.
+    uint8_t digests[GCM_PARALLEL_MAX_THREADS][AES128GCM_BLOCK_SIZE];
+    const size_t nWhole = textLength / AES128GCM_BLOCK_SIZE;
+    const uint64_t nPadded = paddedLength(textLength) / AES128GCM_BLOCK_SIZE;
+
+    // Whole blocks split as evenly as possible, with any partial block in the last share.
+    size_t shareFirst[GCM_PARALLEL_MAX_THREADS], shareLength[GCM_PARALLEL_MAX_THREADS];
+    uint64_t sharePower[GCM_PARALLEL_MAX_THREADS];
+    size_t first = 0;
+    for(uint8_t t = 0; t < nShares; ++t)
+    {
+        const size_t blocks = (nWhole / nShares) + ((t < (nWhole % nShares)) ? 1 : 0);
+        shareFirst[t] = first;
+        shareLength[t] = blocks * AES128GCM_BLOCK_SIZE;
+        if(t == nShares - 1) { shareLength[t] = textLength - first * AES128GCM_BLOCK_SIZE; }
+        sharePower[t] = nPadded - (first + paddedLength(shareLength[t]) / AES128GCM_BLOCK_SIZE);
+        first += blocks;
+    }
+    ParallelJob job = { contexts, nContexts, ICB, input, output, mode, shareFirst, shareLength, sharePower, digests };
+
+    if(NULL != pool) { pool->run(runShareTask, &job, nShares); }
+    else
+    {
+        std::thread threads[GCM_PARALLEL_MAX_THREADS];
+        for(uint8_t t = 1; t < nShares; ++t)
+        {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+            try
+            {
+                threads[t] = std::thread(runShareTask, &job, t);
+                continue;
+            }
+            // If a thread cannot be started, do its share on this one.
+            catch(...) { }
+#else
+            threads[t] = std::thread(runShareTask, &job, t);
+            continue;
+#endif
+            runShareTask(&job, t);
+        }
+        runShareTask(&job, 0);
+        for(uint8_t t = 1; t < nShares; ++t) { if(threads[t].joinable()) { threads[t].join(); } }
+    }
+
+    if(SHARE_CTR == mode) { return; }
+    GHASHMulHPower(&contexts[0]->hashKey, nPadded, S);
+    for(uint8_t t = 0; t < nShares; ++t)
+    {
+        for(uint8_t i = 0; i < AES128GCM_BLOCK_SIZE; ++i) { S[i] ^= digests[t][i]; }
+    }
+    secureWipe(digests, (size_t)nShares * AES128GCM_BLOCK_SIZE);
+}
+
+/**
+ * @brief   number of shares worth splitting a text into, one per thread
+ * @param   maxThreads      most threads available: the pool's workers and the caller, else the contexts
+ */
+static uint8_t parallelShares(const size_t textLength, const size_t maxThreads)
+{
+    size_t n = textLength / OTAES128GCMKeyedBase::GCM_PARALLEL_MIN_SHARE;
+    if(n > maxThreads) { n = maxThreads; }
+    if(n > OTAES128GCMKeyedBase::GCM_PARALLEL_MAX_THREADS) { n = OTAES128GCMKeyedBase::GCM_PARALLEL_MAX_THREADS; }
+    return((n < 1) ? 1 : (uint8_t)n);
+}
+
+/**
+ * @brief   number of threads a parallel call can use
+ */
+static size_t parallelThreads(OTAES128GCMThreadPool *const pool, const uint8_t nContexts)
+{
+    return((NULL != pool) ? (size_t)pool->workerCount() + 1 : nContexts);
+}
+
+/**
+ * @brief   performs standard AES-GCM encryption on exact lengths using several threads; see sealLong()
+ * @retval  true if encryption successful, else false
+ */
+bool OTAES128GCMKeyedBase::sealParallel(OTAES128GCMThreadPool *const pool,
+                        const OTAES128GCMKeyedBase *const *contexts, const uint8_t nContexts,
+                        const uint8_t* IV,
+                        const uint8_t* PDATA, size_t PDATALength,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        uint8_t* CDATA, uint8_t *tag, const uint8_t tagLength)
+{
+    if(!checkParallelContexts(contexts, nContexts)) { return(false); }
+    if((NULL == IV) || (NULL == tag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkLongParams(PDATALength, ADATALength, PDATA, CDATA)) { return(false); }
+    const OTAES128GCMKeyedBase *const ctx = contexts[0];
+
+    uint8_t ICB[AES128GCM_BLOCK_SIZE];
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    uint8_t fullTag[AES128GCM_TAG_SIZE];
+    generateICB(IV, ICB);
+    memset(S, 0, sizeof(S));
+    GHASH(ADATA, ADATALength, &ctx->hashKey, S);
+    runParallel(pool, contexts, nContexts, parallelShares(PDATALength, parallelThreads(pool, nContexts)),
+                ICB, PDATA, CDATA, PDATALength, SHARE_SEAL, S);
+    finishTag(ctx->ap, &ctx->hashKey, ADATALength, PDATALength, S, ICB, fullTag);
+    memcpy(tag, fullTag, tagLength);
+    secureWipe(fullTag, sizeof(fullTag));
+    secureWipe(S, sizeof(S));
+    return(true);
+}
+
+/**
+ * @brief   performs standard AES-GCM decryption and authentication on exact lengths using several threads; see openLong()
+ * @retval  true if decryption and authentication successful, else false
+ */
+bool OTAES128GCMKeyedBase::openParallel(OTAES128GCMThreadPool *const pool,
+                        const OTAES128GCMKeyedBase *const *contexts, const uint8_t nContexts,
+                        const uint8_t* IV,
+                        const uint8_t* CDATA, size_t CDATALength,
+                        const uint8_t* ADATA, size_t ADATALength,
+                        const uint8_t* messageTag, uint8_t *PDATA, const uint8_t tagLength)
+{
+    if(!checkParallelContexts(contexts, nContexts)) { return(false); }
+    if((NULL == IV) || (NULL == messageTag)) { return(false); }
+    if(!isValidGCMTagLength(tagLength)) { return(false); }
+    if(!checkLongParams(CDATALength, ADATALength, CDATA, PDATA)) { return(false); }
+    const OTAES128GCMKeyedBase *const ctx = contexts[0];
+    const uint8_t nShares = parallelShares(CDATALength, parallelThreads(pool, nContexts));
+
+    // Authenticate first, in parallel.
+    uint8_t ICB[AES128GCM_BLOCK_SIZE];
+    uint8_t S[AES128GCM_BLOCK_SIZE];
+    uint8_t calculatedTag[AES128GCM_TAG_SIZE];
+    generateICB(IV, ICB);
+    memset(S, 0, sizeof(S));
+    GHASH(ADATA, ADATALength, &ctx->hashKey, S);
+    runParallel(pool, contexts, nContexts, nShares, ICB, CDATA, NULL, CDATALength, SHARE_HASH, S);
+    finishTag(ctx->ap, &ctx->hashKey, ADATALength, CDATALength, S, ICB, calculatedTag);
+    const bool authentic = (0 == checkTag(calculatedTag, messageTag, tagLength));
+    secureWipe(calculatedTag, sizeof(calculatedTag));
+    secureWipe(S, sizeof(S));
+    if(!authentic) { return(false); }
+
+    // Then decrypt, in parallel; S is not needed for counter mode.
+    runParallel(pool, contexts, nContexts, nShares, ICB, CDATA, PDATA, CDATALength, SHARE_CTR, S);
+    return(true);
+}
+#endif // OTAESGCM_THREADS
+
+/**
+ * @brief   starts a message, setting up the key schedule, H and counters
+ * @param   key             pointer to 16 byte (128 bit) key; never NULL
+ * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+ * @param   decrypt         true to decrypt, false to encrypt
+ * @retval  true if successful, else false
+ */
+bool OTAES128GCMStreamBase::init(const uint8_t *key, const uint8_t *IV, const bool decrypt)
+{
+    clear();
+    if((NULL == key) || (NULL == IV)) { return(false); }
+    ap->setKey(key);
+    generateAuthKey(ap, &hashKey);
+    generateICB(IV, ICB);
+    memcpy(ctrBlock, ICB, AES128GCM_BLOCK_SIZE);
+    incr32(ctrBlock);
+    decrypting = decrypt;
+    state = stateAAD;
+    return(true);
+}
+
+/**
+ * @brief   adds additional authenticated data, hashing whole blocks as they fill
+ */
+bool OTAES128GCMStreamBase::updateAAD(const uint8_t *ADATA, size_t length)
+{
+    if(stateAAD != state) { return(false); }
+    if(0 == length) { return(true); }
+    if(NULL == ADATA) { return(false); }
+    if(length > AES128GCM_MAX_AAD_LENGTH - ADATALength) { return(false); }
+    ADATALength += length;
+    hashPieces(&hashKey, S, buf, bufLength, ADATA, length);
+    return(true);
+}
+
+/**
+ * @brief   encrypts or decrypts the next chunk of text, hashing ciphertext as whole blocks fill
+ */
+bool OTAES128GCMStreamBase::update(const uint8_t *input, size_t length, uint8_t *output)
+{
+    if(stateIdle == state) { return(false); }
+    if(0 == length) { return(true); }
+    if((NULL == input) || (NULL == output)) { return(false); }
+    if(length > AES128GCM_MAX_TEXT_LENGTH - textLength) { return(false); }
+
+    // The AAD is complete: hash any zero-padded partial block.
+    if(stateAAD == state) {
+        GHASH(buf, bufLength, &hashKey, S);
+        bufLength = 0;
+        state = stateText;
+    }
+    textLength += length;
+    cryptPieces(ap, &hashKey, ctrBlock, S, buf, keystream, bufLength, decrypting, input, length, output);
+    return(true);
+}
+
+/**
+ * @brief   hashes any pending partial block and the lengths, and computes the tag
+ * @param   tag             pointer to 16 byte buffer for tag; never NULL
+ */
+void OTAES128GCMStreamBase::computeTag(uint8_t *tag)
+{
+    // Pending partial AAD or ciphertext block, zero padded.
+    GHASH(buf, bufLength, &hashKey, S);
+
+    // [len(A)]64 || [len(C)]64 in bits.
+    uint8_t lengthBuffer[AES128GCM_BLOCK_SIZE];
+    generateLengthBlock(ADATALength, textLength, lengthBuffer);
+    GHASH(lengthBuffer, sizeof(lengthBuffer), &hashKey, S);
+
+    GCTR(ap, S, sizeof(S), ICB, tag);
+}
+
+/**
+ * @brief   completes encryption, generating the tag and wiping state
+ */
+bool OTAES128GCMStreamBase::finish(uint8_t *tag)
+{
+    if((stateIdle == state) || decrypting || (NULL == tag)) { return(false); }
+    computeTag(tag);
+    clear();
+    return(true);
+}
+
+/**
+ * @brief   completes decryption, checking the tag and wiping state
+ */
+bool OTAES128GCMStreamBase::verify(const uint8_t *messageTag)
+{
+    if((stateIdle == state) || !decrypting || (NULL == messageTag)) { return(false); }
+    uint8_t calculatedTag[AES128GCM_TAG_SIZE];
+    computeTag(calculatedTag);
+    const bool result = (0 == checkTag(calculatedTag, messageTag));
+    secureWipe(calculatedTag, sizeof(calculatedTag));
+    clear();
+    return(result);
+}
+
+/**
+ * @brief   abandons any message in progress, securely wiping the key schedule and state
+ */
+void OTAES128GCMStreamBase::clear()
+{
+    ap->clearKey();
+    hashKey.clear();
+    secureWipe(ICB, sizeof(ICB));
+    secureWipe(ctrBlock, sizeof(ctrBlock));
+    secureWipe(S, sizeof(S));
+    secureWipe(buf, sizeof(buf));
+    secureWipe(keystream, sizeof(keystream));
+    ADATALength = 0;
+    textLength = 0;
+    bufLength = 0;
+    state = stateIdle;
+}
+
+
+
+// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) encryption/authentication function.
+// This is an adaptor/bridge function to ease outside use in simple cases
+// without explicit type/library dependencies, but use with care.
+// Stateless implementation: creates state on stack each time at cost of stack space
+// (which may be considerable and difficult to manage in an embedded system)
+// and at cost of time.
+// The state parameter is not used (is ignored) and should be NULL.
+// Other than the authtext, all sizes are fixed:
+//   * textSize is 32 (or zero if plaintext is NULL)
+//   * keySize is 16
+//   * nonceSize is 12
+//   * tagSize is 16
+// The plain-text (and identical cipher-text) size is picked to be
+// a multiple of the cipher's block size, or zero,
+// which implies likely requirement for padding of the plain text.
+// Note that the authenticated text size is not fixed, ie is zero or more bytes.
+// The plaintext can be NULL, ciphertextOut not (a future version may allow it to be if plaintext is).
+// Returns true on success, false on failure.
+bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(void *const,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if((NULL == key) || (NULL == iv) || (NULL == ciphertextOut) || (NULL == tagOut)) { return(false); } // ERROR
+    OTAES128GCMFixed<32> i;
+    return(i.encrypt(key, iv, (0 == authtextSize) ? NULL : authtext, authtextSize, plaintext, ciphertextOut, tagOut));
+    }
+
+// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) decryption/authentication function.
+// This is an adaptor/bridge function to ease outside use in simple cases
+// without explicit type/library dependencies, but use with care.
+// Stateless implementation: creates state on stack each time at cost of stack space
+// (which may be considerable and difficult to manage in an embedded system)
+// and at cost of time.
+// The state parameter is not used (is ignored) and should be NULL.
+// Other than the authtext, all sizes are fixed:
+//   * textSize is 32 (or zero if ciphertext is NULL)
+//   * keySize is 16
+//   * nonceSize is 12
+//   * tagSize is 16
+// The plain-text (and identical cipher-text) size is picked to be
+// a multiple of the cipher's block size, or zero,
+// which implies likely requirement for padding of the plain text.
+// Note that the authenticated text size is not fixed, ie is zero or more bytes.
+// The ciphertext can be NULL, plaintextOut not (a future version may allow it to be if ciphertext is).
+// Decrypts/authenticates the output of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS.)
+// Returns true on success, false on failure.
+bool fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(void *const,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if((NULL == key) || (NULL == iv) || (NULL == tag) || (NULL == plaintextOut)) { return(false); } // ERROR
+    OTAES128GCMFixed<32> i;
+    return(i.decrypt(key, iv, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertext, tag, plaintextOut));
+    }
+
+
+// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) encryption/authentication function using work space passed in.
+// This is an adaptor/bridge function to ease outside use in simple cases
+// without explicit type/library dependencies, but use with care.
+// A workspace is passed in (and cleared on exit);
+// this routine will fail (safely, returning false) if the workspace is NULL or too small.
+// The workspace requirement depends on the implementation used;
+// a workspace of OTAES128GCMGenericWithWorkspace<>::workspaceWithGHASHTable bytes is faster.
+// Other than the authtext, all sizes are fixed:
+//   * textSize is 32 (or zero if plaintext is NULL)
+//   * keySize is 16
+//   * nonceSize is 12
+//   * tagSize is 16
+// The plain-text (and identical cipher-text) size is picked to be
+// a multiple of the cipher's block size, or zero,
+// which implies likely requirement for padding of the plain text.
+// Note that the authenticated text size is not fixed, ie is zero or more bytes.
+// Returns true on success, false on failure.
+bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if((NULL == key) || (NULL == iv) || (NULL == ciphertextOut) || (NULL == tagOut)) { return(false); } // ERROR
+    typedef OTAES128GCMFixedWithWorkspace<32> t;
+    if(!t::isWorkspaceSufficient(workspace, workspaceSize)) { return(false); } // ERROR
+    t i(workspace, workspaceSize);
+    return(i.encrypt(key, iv, (0 == authtextSize) ? NULL : authtext, authtextSize, plaintext, ciphertextOut, tagOut));
+    }
+
+// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) decryption/authentication function using work space passed in.
+// This is an adaptor/bridge function to ease outside use in simple cases
+// without explicit type/library dependencies, but use with care.
+// A workspace is passed in (and cleared on exit);
+// this routine will fail (safely, returning false) if the workspace is NULL or too small.
+// The workspace requirement depends on the implementation used;
+// a workspace of OTAES128GCMGenericWithWorkspace<>::workspaceWithGHASHTable bytes is faster.
+// Other than the authtext, all sizes are fixed:
+//   * textSize is 32 (or zero if ciphertext is NULL)
+//   * keySize is 16
 //   * nonceSize is 12
 //   * tagSize is 16
 // The plain-text (and identical cipher-text) size is picked to be
@@ -567,19 +2146,173 @@ bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
 // Decrypts/authenticates the output of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS.)
 // Returns true on success, false on failure.
 bool fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE(
-        uint8_t *const workspace, const uint8_t workspaceSize,
+        uint8_t *const workspace, const size_t workspaceSize,
         const uint8_t *const key, const uint8_t *const iv,
         const uint8_t *const authtext, const uint8_t authtextSize,
         const uint8_t *const ciphertext, const uint8_t *const tag,
         uint8_t *const plaintextOut)
     {
     if((NULL == key) || (NULL == iv) || (NULL == tag) || (NULL == plaintextOut)) { return(false); } // ERROR
+    typedef OTAES128GCMFixedWithWorkspace<32> t;
+    if(!t::isWorkspaceSufficient(workspace, workspaceSize)) { return(false); } // ERROR
+    t i(workspace, workspaceSize);
+    return(i.decrypt(key, iv, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertext, tag, plaintextOut));
+    }
+
+
+// AES-GCM 128-bit-key variable-size text encryption/authentication function.
+// Standard GCM on the exact text size: the cipher-text is textSize bytes, not padded.
+// Stateless implementation: creates state on stack each time.
+// The state parameter is not used (is ignored) and should be NULL.
+// Returns true on success, false on failure.
+bool varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(void *const,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext, const uint8_t textSize,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if((NULL == key) || (NULL == iv) || (NULL == tagOut)) { return(false); } // ERROR
+    OTAES128GCMGeneric<> i;
+    return(i.gcmEncryptLong(key, iv, plaintext, textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut));
+    }
+
+// AES-GCM 128-bit-key variable-size text decryption/authentication function.
+// Decrypts/authenticates the output of varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS.
+// Stateless implementation: creates state on stack each time.
+// The state parameter is not used (is ignored) and should be NULL.
+// Returns true on success, false on failure.
+bool varTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(void *const,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t textSize, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if((NULL == key) || (NULL == iv) || (NULL == tag)) { return(false); } // ERROR
+    OTAES128GCMGeneric<> i;
+    return(i.gcmDecryptLong(key, iv, ciphertext, textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut));
+    }
+
+// AES-GCM 128-bit-key variable-size text encryption/authentication function using work space passed in.
+// Standard GCM on the exact text size: the cipher-text is textSize bytes, not padded.
+// A workspace is passed in (and cleared on exit);
+// this routine will fail (safely, returning false) if the workspace is NULL or too small.
+// Returns true on success, false on failure.
+bool varTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext, const uint8_t textSize,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if((NULL == key) || (NULL == iv) || (NULL == tagOut)) { return(false); } // ERROR
+    typedef OTAES128GCMGenericWithWorkspace<> t;
+    if(!t::isWorkspaceSufficient(workspace, workspaceSize)) { return(false); } // ERROR
+    t i(workspace, workspaceSize);
+    return(i.gcmEncryptLong(key, iv, plaintext, textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut));
+    }
+
+// AES-GCM 128-bit-key variable-size text decryption/authentication function using work space passed in.
+// Decrypts/authenticates the output of varTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE.
+// A workspace is passed in (and cleared on exit);
+// this routine will fail (safely, returning false) if the workspace is NULL or too small.
+// Returns true on success, false on failure.
+bool varTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE(
+        uint8_t *const workspace, const size_t workspaceSize,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t textSize, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if((NULL == key) || (NULL == iv) || (NULL == tag)) { return(false); } // ERROR
     typedef OTAES128GCMGenericWithWorkspace<> t;
     if(!t::isWorkspaceSufficient(workspace, workspaceSize)) { return(false); } // ERROR
     t i(workspace, workspaceSize);
-    return(i.gcmDecrypt(key, iv, ciphertext, (NULL == ciphertext) ? 0 : 32, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut));
+    return(i.gcmDecryptLong(key, iv, ciphertext, textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut));
+    }
+
+
+
+/**
+ * @brief   returns the context keyed with key, rekeying only if key is not the one cached
+ * @param   key             pointer to 16 byte (128 bit) key
+ * @retval  the keyed context, or NULL if key is NULL
+ */
+const OTAES128GCMKeyedBase *OTAES128GCMBridgeState::forKey(const uint8_t *const key)
+    {
+    if(NULL == key) { return(NULL); }
+    // Compare in constant time, as for tags.
+    if(ctx.isKeyed() && (0 == checkTag(cachedKey, key, AES128GCM_KEY_SIZE))) { return(&ctx); }
+    ctx.setKey(key);
+    memcpy(cachedKey, key, AES128GCM_KEY_SIZE);
+    return(&ctx);
+    }
+
+/**
+ * @brief   securely wipes the cached key, key schedule and H
+ */
+void OTAES128GCMBridgeState::clear()
+    {
+    ctx.clearKey();
+    secureWipe(cachedKey, sizeof(cachedKey));
+    }
+
+// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) encryption/authentication function
+// caching the key setup between calls in the OTAES128GCMBridgeState pointed to by state.
+// Output is identical to that of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS().
+// Returns true on success, false on failure (including if state is NULL).
+bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED(void *const state,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if((NULL == state) || (NULL == key) || (NULL == iv) || (NULL == ciphertextOut) || (NULL == tagOut)) { return(false); } // ERROR
+    const OTAES128GCMKeyedBase *const ctx = ((OTAES128GCMBridgeState *)state)->forKey(key);
+    return(ctx->sealLong(iv, plaintext, (NULL == plaintext) ? 0 : 32, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut));
+    }
+
+// AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) decryption/authentication function
+// caching the key setup between calls in the OTAES128GCMBridgeState pointed to by state.
+// Decrypts/authenticates the output of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS or _CACHED.
+// Returns true on success, false on failure (including if state is NULL).
+bool fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_CACHED(void *const state,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if((NULL == state) || (NULL == key) || (NULL == iv) || (NULL == tag) || (NULL == plaintextOut)) { return(false); } // ERROR
+    const OTAES128GCMKeyedBase *const ctx = ((OTAES128GCMBridgeState *)state)->forKey(key);
+    return(ctx->openLong(iv, ciphertext, (NULL == ciphertext) ? 0 : 32, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut));
+    }
+
+// AES-GCM 128-bit-key variable-size text encryption/authentication function
+// caching the key setup between calls in the OTAES128GCMBridgeState pointed to by state.
+// Returns true on success, false on failure (including if state is NULL).
+bool varTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED(void *const state,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const plaintext, const uint8_t textSize,
+        uint8_t *const ciphertextOut, uint8_t *const tagOut)
+    {
+    if((NULL == state) || (NULL == key) || (NULL == iv) || (NULL == tagOut)) { return(false); } // ERROR
+    const OTAES128GCMKeyedBase *const ctx = ((OTAES128GCMBridgeState *)state)->forKey(key);
+    return(ctx->sealLong(iv, plaintext, textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut));
     }
 
+// AES-GCM 128-bit-key variable-size text decryption/authentication function
+// caching the key setup between calls in the OTAES128GCMBridgeState pointed to by state.
+// Returns true on success, false on failure (including if state is NULL).
+bool varTextSize12BNonce16BTagSimpleDec_DEFAULT_CACHED(void *const state,
+        const uint8_t *const key, const uint8_t *const iv,
+        const uint8_t *const authtext, const uint8_t authtextSize,
+        const uint8_t *const ciphertext, const uint8_t textSize, const uint8_t *const tag,
+        uint8_t *const plaintextOut)
+    {
+    if((NULL == state) || (NULL == key) || (NULL == iv) || (NULL == tag)) { return(false); } // ERROR
+    const OTAES128GCMKeyedBase *const ctx = ((OTAES128GCMBridgeState *)state)->forKey(key);
+    return(ctx->openLong(iv, ciphertext, textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut));
+    }
 
 
     }
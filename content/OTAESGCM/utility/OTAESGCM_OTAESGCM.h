@@ -24,10 +24,13 @@ Author(s) / Copyright (s): Deniz Erbilgin 2015
 
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 // Get available AES API and cipher implementations.
 #include "OTAESGCM_OTAES128.h"
 #include "OTAESGCM_OTAES128Impls.h"
+// Get GHASH implementations.
+#include "OTAESGCM_GHASH.h"
 
 
 // Use namespaces to help avoid collisions.
@@ -36,8 +39,23 @@ namespace OTAESGCM
 
 
 static constexpr uint8_t AES128GCM_BLOCK_SIZE = 16; // GCM block size in bytes. This must be the same as the AES block size.
+static constexpr uint8_t AES128GCM_KEY_SIZE   = 16; // AES128 key size in bytes.
 static constexpr uint8_t AES128GCM_IV_SIZE    = 12; // GCM initialisation size in bytes.
 static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag size in bytes.
+static constexpr uint64_t AES128GCM_MAX_TEXT_LENGTH = (((uint64_t)1) << 36) - 32; // 2^39 - 256 bits, limited by the 32-bit counter.
+static constexpr uint64_t AES128GCM_MAX_AAD_LENGTH  = (((uint64_t)1) << 61) - 1;  // 2^64 - 1 bits.
+
+    // True if tagLength (bytes) is a GCM tag length allowed by NIST SP 800-38D:
+    // the full 16 bytes, 12 to 15, or the 8 and 4 bytes only for constrained uses
+    // (with limits on the message lengths and number of forgery attempts; see Appendix C).
+    constexpr bool isValidGCMTagLength(const uint8_t tagLength)
+        { return(((tagLength >= 12) && (tagLength <= AES128GCM_TAG_SIZE)) || (8 == tagLength) || (4 == tagLength)); }
+
+    // Bytes of caller buffer for OTAES128GCMKeyedBase::prepare() to cover texts of up to maxTextLength bytes:
+    // a flag, the IV, the tag mask E(K, J0) and maxTextLength bytes of keystream.
+    static constexpr uint8_t AES128GCM_PREPARED_OVERHEAD = 1 + AES128GCM_IV_SIZE + AES128GCM_BLOCK_SIZE;
+    constexpr size_t gcmPreparedSize(const size_t maxTextLength)
+        { return(AES128GCM_PREPARED_OVERHEAD + maxTextLength); }
 
 
     // Base class / interface for AES128-GCM encryption/decryption.
@@ -79,7 +97,8 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
              * @param    CDATALength     length of ciphertext array
              * @param    ADATA           pointer to additional data array
              * @param    ADATALength     length of additional data
-             * @param    PDATA           buffer to output plaintext to; must be same length as CDATA
+             * @param    PDATA           buffer to output plaintext to; must be same length as CDATA;
+             *                           not written to if authentication fails
              * @retval   true if decryption and authentication successful, else false
              */
             virtual bool gcmDecrypt(
@@ -98,20 +117,45 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
 #endif
         };
 
+    // One piece of scatter-gather AAD, eg a header field.
+    struct OTAES128GCMSegment
+        {
+        // Data; NULL only if length is 0.
+        const uint8_t *data;
+        size_t length;
+        };
+
+    // One piece of scatter-gather text; output may be the same as input.
+    // Pieces are processed in order as if concatenated,
+    // so eg several fields can be encrypted straight into one frame buffer.
+    struct OTAES128GCMTextSegment
+        {
+        // Input and output text; NULL only if length is 0.
+        const uint8_t *input;
+        uint8_t *output;
+        size_t length;
+        };
+
     // Generic implementation, parameterised with type of underlying AES implementation.
     // The default AES implementation for the architecture is used unless otherwise specified.
     // This implementation is not specialised for a particular CPU/MCU for example.
-    // This implementation carries no state beyond that of the AES128 implementation.
+    // This implementation carries no state beyond that of the AES128 implementation
+    // and the optional GHASH table workspace.
     class OTAES128GCMGenericBase : public OTAES128GCM
         {
         private:
             // Pointer to an AES block encryption implementation instance; never NULL.
             OTAES128E * const ap;
+            // Optional workspace of GHASH_TABLE4_SIZE bytes for a 4-bit GHASH table; NULL if none.
+            uint8_t * const ghashTable4;
         public:
             // Create an instance pointing at a suitable AES block enc/dec implementation.
             // The AES impl should not carry logical state between operations,
             // but may hold temporary workspace or non-key/data-dependent state.
-            constexpr OTAES128GCMGenericBase(OTAES128E *aptr) : ap(aptr) { }
+            // If ghashTable4Workspace is not NULL it is used (and cleared) by each operation
+            // for a faster table-driven GHASH.
+            constexpr OTAES128GCMGenericBase(OTAES128E *aptr, uint8_t *ghashTable4Workspace = NULL)
+                : ap(aptr), ghashTable4(ghashTable4Workspace) { }
             // Encrypt; true iff successful.
             virtual bool gcmEncrypt(
                 const uint8_t* key, const uint8_t* IV,
@@ -124,6 +168,110 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
                  const uint8_t* CDATA, uint8_t CDATALength,
                  const uint8_t* ADATA, uint8_t ADATALength,
                  const uint8_t* messageTag, uint8_t *PDATA) const override;
+
+            /**
+             * @brief   performs standard AES-GCM encryption on the exact lengths, eg for large logs or images.
+             *          Unlike gcmEncrypt() the text is not padded and CDATA is exactly PDATALength bytes.
+             * @param   PDATALength     length of plaintext in bytes, at most 2^36 - 32 (2^39 - 256 bits)
+             * @param   ADATALength     length of additional data in bytes
+             * @param   tagLength       tag length in bytes, 16 or truncated (see isValidGCMTagLength()); the leading bytes of the full tag
+             * @retval  true if encryption is successful, else false (including if a length limit is exceeded)
+             */
+            bool gcmEncryptLong(
+                const uint8_t* key, const uint8_t* IV,
+                const uint8_t* PDATA, size_t PDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                uint8_t* CDATA, uint8_t *tag, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+            /**
+             * @brief   performs standard AES-GCM decryption and authentication on the exact lengths.
+             *          PDATA must be CDATALength bytes.
+             * @retval  true if decryption and authentication successful, else false
+             */
+            bool gcmDecryptLong(
+                const uint8_t* key, const uint8_t* IV,
+                const uint8_t* CDATA, size_t CDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                const uint8_t* messageTag, uint8_t *PDATA, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+
+            /**
+             * @brief   performs standard AES-GCM encryption in place on one frame buffer, eg a radio TX buffer.
+             *          The additional data (eg header) is frame[0, ADATALength),
+             *          the body frame[bodyOffset, bodyOffset+bodyLength) is encrypted where it lies (not padded),
+             *          and the tag is written to frame[tagOffset, tagOffset+tagLength).
+             *          The body and tag slot must follow the additional data and must not overlap.
+             * @retval  true if encryption is successful, else false (and the frame is unchanged)
+             */
+            bool gcmEncryptInPlace(
+                const uint8_t* key, const uint8_t* IV,
+                uint8_t *frame, uint8_t frameLength,
+                uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                uint8_t tagOffset, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+            /**
+             * @brief   performs standard AES-GCM decryption and authentication in place on one frame buffer
+             *          laid out as for gcmEncryptInPlace(); the body is decrypted only if the tag is authentic.
+             * @retval  true if decryption and authentication successful, else false (and the frame is unchanged)
+             */
+            bool gcmDecryptInPlace(
+                const uint8_t* key, const uint8_t* IV,
+                uint8_t *frame, uint8_t frameLength,
+                uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                uint8_t tagOffset, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+
+            /**
+             * @brief   computes a GMAC tag, ie authenticate-only GCM (eg for heartbeats and beacons).
+             *          Costs only the GHASH of ADATA and one block encryption for the tag mask;
+             *          the tag is the same as from gcmEncrypt() with no plaintext.
+             * @param   ADATA           pointer to data to authenticate; never NULL
+             * @param   ADATALength     length of ADATA in bytes, strictly positive
+             * @param   tag             pointer to 16 byte buffer to output tag to; never NULL
+             * @retval  true if successful, else false
+             */
+            bool gmacCompute(
+                const uint8_t* key, const uint8_t* IV,
+                const uint8_t* ADATA, size_t ADATALength,
+                uint8_t *tag) const;
+            /**
+             * @brief   checks a GMAC tag over ADATA, in constant time.
+             * @retval  true if ADATA is authentic, else false
+             */
+            bool gmacVerify(
+                const uint8_t* key, const uint8_t* IV,
+                const uint8_t* ADATA, size_t ADATALength,
+                const uint8_t *messageTag) const;
+
+            /**
+             * @brief   performs standard AES-GCM encryption with the AAD and text each given
+             *          as a list of segments, processed as if concatenated, so needing no staging copies.
+             *          Lengths and limits are as for gcmEncryptLong() on the totals.
+             * @param   key             pointer to 16 byte (128 bit) key; never NULL
+             * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+             * @param   ADATA           array of nADATA AAD segments; NULL if nADATA is 0
+             * @param   nADATA          number of AAD segments, can be zero
+             * @param   text            array of nText segments of plaintext in and ciphertext out; NULL if nText is 0
+             * @param   nText           number of text segments, can be zero
+             * @param   tag             pointer to tagLength byte buffer to output tag to; never NULL
+             * @param   tagLength       tag length in bytes: 16, or truncated to 15, 14, 13, 12, 8 or 4
+             * @retval  true if encryption successful, else false
+             */
+            bool gcmEncryptSegments(
+                const uint8_t* key, const uint8_t* IV,
+                const OTAES128GCMSegment *ADATA, size_t nADATA,
+                const OTAES128GCMTextSegment *text, size_t nText,
+                uint8_t *tag, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+
+            /**
+             * @brief   performs standard AES-GCM decryption and authentication with the AAD and text
+             *          each given as a list of segments; see gcmEncryptSegments().
+             *          Nothing is written to the output segments unless the message is authentic.
+             * @param   text            array of nText segments of ciphertext in and plaintext out; NULL if nText is 0
+             * @param   messageTag      pointer to tagLength byte tag to authenticate against; never NULL
+             * @retval  true if decryption and authentication successful, else false
+             */
+            bool gcmDecryptSegments(
+                const uint8_t* key, const uint8_t* IV,
+                const OTAES128GCMSegment *ADATA, size_t nADATA,
+                const OTAES128GCMTextSegment *text, size_t nText,
+                const uint8_t *messageTag, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
         };
 
     // Generic implementation, parameterised with type of underlying AES implementation.
@@ -144,22 +292,674 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
     // Generic implementation, parameterised with type of underlying AES implementation.
     // Carries the AES working state with it.
     // The OTAESImpl should clear up private state before returning from its methods.
+    // If the supplied workspace is at least workspaceWithGHASHTable bytes
+    // the extra space holds a 4-bit GHASH table, much faster on MCUs such as AVR.
     template<class OTAESImpl = OTAESGCM::OTAES128E_default_t>
     class OTAES128GCMGenericWithWorkspace final : OTAESImpl, public OTAES128GCMGenericBase
         {
         public:
             // Minimum size of workspace required.
             constexpr static uint8_t workspaceRequired = OTAESImpl::workspaceRequired;
+            // Size of workspace to also enable the table-driven GHASH.
+            constexpr static size_t workspaceWithGHASHTable = workspaceRequired + (size_t)GHASH_TABLE4_SIZE;
+            // Construct an instance, supplied with workspace.
+            constexpr OTAES128GCMGenericWithWorkspace(uint8_t *const workspace, const size_t workspaceSize)
+                : OTAESImpl(workspace, (workspaceSize >= workspaceRequired) ? workspaceRequired : uint8_t(0)),
+                  OTAES128GCMGenericBase(this, (workspaceSize >= workspaceWithGHASHTable) ? workspace + workspaceRequired : NULL)
+                { }
+            // Verify that the workspace would be adequate before constructing an instance.
+            static constexpr bool isWorkspaceSufficient(uint8_t *const workspace, const size_t workspaceSize)
+                { return((NULL != workspace) && (workspaceSize >= workspaceRequired)); }
+        };
+
+
+    // Fixed-shape AES128-GCM, eg for the 32-byte OpenTRV frame body:
+    // text length, maximum AAD length and tag length are fixed at compile time,
+    // so there is no runtime padding or length logic.
+    // Standard GCM on exactly TextLen bytes of text (no padding), with a TagLen-byte tag.
+    // The text may be omitted (NULL) to authenticate the AAD alone.
+    // Calls the AES implementation directly (not through OTAES128E's virtual interface),
+    // and encrypts H, the tag mask and all the text counter blocks of a message in one pass,
+    // eg for a 32-byte body 4 AES blocks, then (when encrypting) the 2 ciphertext blocks and the length block hashed as one run of 3.
+    // Only the powers of H that the shape can use are precomputed for PCLMULQDQ.
+    // Uses about (TextLen/16 + 5) * 16 bytes of stack.
+    // Carries no state beyond that of the AES128 implementation and the optional GHASH table workspace.
+    template<uint8_t TextLen, uint8_t MaxAADLen, uint8_t TagLen, class OTAESImpl>
+    class OTAES128GCMFixedBase
+        {
+        static_assert(isValidGCMTagLength(TagLen), "tag size not allowed for GCM");
+        static_assert(TextLen <= 240, "counter kept to its low byte");
+
+        private:
+            // Pointer to the AES block encryption implementation instance; never NULL.
+            OTAESImpl * const ap;
+            // Caller-supplied workspace for the 4-bit GHASH table, else NULL.
+            uint8_t * const ghashTable4;
+
+            // Text blocks, including any partial last block.
+            static constexpr uint8_t nBlocks = (TextLen + AES128GCM_BLOCK_SIZE - 1) / AES128GCM_BLOCK_SIZE;
+            // AES blocks per message: H, the tag mask E(K, J0), then one per text block.
+            static constexpr uint8_t nAESBlocks = 2 + nBlocks;
+            // The most blocks in any one GHASH() call: the AAD, or C and the lengths; the powers of H needed.
+            static constexpr uint8_t maxAADBlocks = (uint8_t)(((unsigned)MaxAADLen + AES128GCM_BLOCK_SIZE - 1) / AES128GCM_BLOCK_SIZE);
+            static constexpr uint8_t hPowers = (maxAADBlocks > nBlocks + 1) ? maxAADBlocks : (uint8_t)(nBlocks + 1);
+
+            // Wipe working data in a way the compiler should not elide.
+            static void wipe(uint8_t *p, size_t n) { volatile uint8_t *vp = p; while(n-- > 0) { *vp++ = 0; } }
+
+            // Encrypts n independent blocks in place, one at a time.
+            static void encryptBlocks(const OTAES128E *, const OTAESImpl *e, uint8_t *buf, uint8_t n)
+                {
+                for(uint8_t i = 0; i < n; ++i)
+                    { e->OTAESImpl::blockEncryptKeyed(buf + i * AES128GCM_BLOCK_SIZE, buf + i * AES128GCM_BLOCK_SIZE); }
+                }
+#ifdef OTAESGCM_X86_INTRINSICS
+            // Encrypts n independent blocks in place, interleaved by AES-NI where available.
+            static void encryptBlocks(const OTAES128E_AESNI *, const OTAESImpl *e, uint8_t *buf, uint8_t n)
+                { e->OTAESImpl::ecbEncryptKeyed(buf, buf, n); }
+#endif
+
+            // Sets the key, then encrypts 0^128, J0 and (if hasText) the text counter blocks in buf,
+            // sets up the GHASH key from H and hashes the AAD into S.
+            // On return buf holds H (wiped), E(K, J0) and the text keystream.
+            void start(const uint8_t *key, const uint8_t *IV, bool hasText, GHASHKey &hk,
+                       const uint8_t *ADATA, uint8_t ADATALength, uint8_t *buf, uint8_t *S) const
+                {
+                memset(buf, 0, AES128GCM_BLOCK_SIZE);
+                uint8_t *const J0 = buf + AES128GCM_BLOCK_SIZE;
+                memcpy(J0, IV, AES128GCM_IV_SIZE);
+                J0[12] = 0; J0[13] = 0; J0[14] = 0; J0[15] = 1;
+                const uint8_t n = hasText ? nAESBlocks : 2;
+                for(uint8_t b = 2; b < n; ++b)
+                    {
+                    memcpy(buf + b * AES128GCM_BLOCK_SIZE, J0, AES128GCM_BLOCK_SIZE - 1);
+                    buf[b * AES128GCM_BLOCK_SIZE + 15] = b;
+                    }
+                ap->OTAESImpl::setKey(key);
+                encryptBlocks(ap, ap, buf, n);
+                hk.init(buf, true, false, (hPowers < GHASH_HPOWERS) ? hPowers : GHASH_HPOWERS);
+                wipe(buf, AES128GCM_BLOCK_SIZE);
+                memset(S, 0, AES128GCM_BLOCK_SIZE);
+                GHASH(ADATA, ADATALength, &hk, S);
+                }
+
+            // [len(A)]64 || [len(C)]64 in bits, both under 2^11; the text part is a constant.
+            static void lengthBlock(uint8_t ADATALength, bool hasText, uint8_t *out)
+                {
+                memset(out, 0, AES128GCM_BLOCK_SIZE);
+                out[6] = (uint8_t)(ADATALength >> 5);
+                out[7] = (uint8_t)(ADATALength << 3);
+                if(hasText)
+                    {
+                    out[14] = (uint8_t)(TextLen >> 5);
+                    out[15] = (uint8_t)(TextLen << 3);
+                    }
+                }
+
+            // XORs the text with the keystream from start().
+            static void applyKeystream(const uint8_t *buf, const uint8_t *input, uint8_t *output)
+                {
+                const uint8_t *const ks = buf + 2 * AES128GCM_BLOCK_SIZE;
+                for(uint8_t i = 0; i < TextLen; ++i) { output[i] = (uint8_t)(input[i] ^ ks[i]); }
+                }
+
+            // Masks S with E(K, J0) from start() to give the full tag, and wipes the key schedule and H.
+            void finish(GHASHKey &hk, uint8_t *buf, uint8_t *S) const
+                {
+                for(uint8_t i = 0; i < AES128GCM_BLOCK_SIZE; ++i) { S[i] ^= buf[AES128GCM_BLOCK_SIZE + i]; }
+                ap->OTAESImpl::clearKey();
+                hk.clear();
+                }
+
+            // True if the lengths and pointers are acceptable.
+            static bool checkParams(const uint8_t *key, const uint8_t *IV, const uint8_t *tag,
+                                    const uint8_t *ADATA, uint8_t ADATALength,
+                                    const uint8_t *input, uint8_t *output)
+                {
+                if((NULL == key) || (NULL == IV) || (NULL == tag)) { return(false); }
+                if((ADATALength > MaxAADLen) || ((0 != ADATALength) && (NULL == ADATA))) { return(false); }
+                // Fail if there is nothing to encrypt and/or authenticate.
+                if(NULL == input) { return(0 != ADATALength); }
+                return((NULL != output) && (0 != (TextLen | ADATALength)));
+                }
+
+        protected:
+            // Only derived classes can construct an instance.
+            constexpr OTAES128GCMFixedBase(OTAESImpl *aptr, uint8_t *const table4Workspace = NULL)
+                : ap(aptr), ghashTable4(table4Workspace) { }
+
+        public:
+            /**
+             * @brief   performs AES-GCM encryption of TextLen bytes.
+             * @param   key             pointer to 16 byte (128 bit) key; never NULL
+             * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+             * @param   ADATA           pointer to additional data; NULL if length 0
+             * @param   ADATALength     length of additional data, at most MaxAADLen
+             * @param   PDATA           pointer to TextLen bytes of plaintext; NULL to authenticate ADATA only
+             * @param   CDATA           buffer for TextLen bytes of ciphertext; may be NULL if PDATA is
+             * @param   tag             pointer to TagLen byte buffer for the tag; never NULL
+             * @retval  true if encryption is successful, else false
+             */
+            bool encrypt(const uint8_t *key, const uint8_t *IV,
+                         const uint8_t *ADATA, uint8_t ADATALength,
+                         const uint8_t *PDATA, uint8_t *CDATA, uint8_t *tag) const
+                {
+                if(!checkParams(key, IV, tag, ADATA, ADATALength, PDATA, CDATA)) { return(false); }
+                const bool hasText = (NULL != PDATA);
+                GHASHKey hk(ghashTable4);
+                uint8_t buf[(nAESBlocks + 1) * AES128GCM_BLOCK_SIZE];
+                uint8_t S[AES128GCM_BLOCK_SIZE];
+                start(key, IV, hasText, hk, ADATA, ADATALength, buf, S);
+                // Turn the keystream into C in place, zero-padded and followed by the lengths,
+                // and hash that as one run of blocks.
+                uint8_t *const C = buf + 2 * AES128GCM_BLOCK_SIZE;
+                uint8_t *const lengths = hasText ? C + nBlocks * AES128GCM_BLOCK_SIZE : C;
+                if(hasText)
+                    {
+                    applyKeystream(buf, PDATA, C);
+                    memset(C + TextLen, 0, nBlocks * AES128GCM_BLOCK_SIZE - TextLen);
+                    memcpy(CDATA, C, TextLen);
+                    }
+                lengthBlock(ADATALength, hasText, lengths);
+                GHASH(C, (size_t)(lengths - C) + AES128GCM_BLOCK_SIZE, &hk, S);
+                finish(hk, buf, S);
+                memcpy(tag, S, TagLen);
+                wipe(buf, sizeof(buf));
+                wipe(S, sizeof(S));
+                return(true);
+                }
+
+            /**
+             * @brief   performs AES-GCM decryption and authentication of TextLen bytes;
+             *          nothing is written to PDATA unless the message is authentic.
+             * @param   CDATA           pointer to TextLen bytes of ciphertext; NULL to authenticate ADATA only
+             * @param   tag             pointer to TagLen byte tag to authenticate against; never NULL
+             * @param   PDATA           buffer for TextLen bytes of plaintext; may be NULL if CDATA is
+             * @retval  true if decryption and authentication successful, else false
+             * @note    other parameters as for encrypt()
+             */
+            bool decrypt(const uint8_t *key, const uint8_t *IV,
+                         const uint8_t *ADATA, uint8_t ADATALength,
+                         const uint8_t *CDATA, const uint8_t *tag, uint8_t *PDATA) const
+                {
+                if(!checkParams(key, IV, tag, ADATA, ADATALength, CDATA, PDATA)) { return(false); }
+                const bool hasText = (NULL != CDATA);
+                GHASHKey hk(ghashTable4);
+                uint8_t buf[(nAESBlocks + 1) * AES128GCM_BLOCK_SIZE];
+                uint8_t S[AES128GCM_BLOCK_SIZE];
+                start(key, IV, hasText, hk, ADATA, ADATALength, buf, S);
+                // The keystream is still needed, so hash C where it is, then the lengths.
+                uint8_t *const lengths = buf + nAESBlocks * AES128GCM_BLOCK_SIZE;
+                if(hasText) { GHASH(CDATA, TextLen, &hk, S); }
+                lengthBlock(ADATALength, hasText, lengths);
+                GHASH(lengths, AES128GCM_BLOCK_SIZE, &hk, S);
+                finish(hk, buf, S);
+                // Constant-time tag comparison.
+                uint8_t diff = 0;
+                for(uint8_t i = 0; i < TagLen; ++i) { diff |= (uint8_t)(S[i] ^ tag[i]); }
+                if((0 == diff) && hasText) { applyKeystream(buf, CDATA, PDATA); }
+                wipe(buf, sizeof(buf));
+                wipe(S, sizeof(S));
+                return(0 == diff);
+                }
+        };
+
+    // Fixed-shape implementation, parameterised with type of underlying AES implementation,
+    // carrying the AES working state with it.
+    template<uint8_t TextLen, uint8_t MaxAADLen = 255, uint8_t TagLen = AES128GCM_TAG_SIZE,
+             class OTAESImpl = OTAESGCM::OTAES128E_default_t>
+    class OTAES128GCMFixed final : OTAESImpl, public OTAES128GCMFixedBase<TextLen, MaxAADLen, TagLen, OTAESImpl>
+        {
+        private:
+            // Minimum size of workspace required.
+            constexpr static uint8_t workspaceRequired = OTAESImpl::workspaceRequired;
+            uint8_t workspace[workspaceRequired];
+        public:
+            // Construct an instance.
+            constexpr OTAES128GCMFixed()
+                : OTAESImpl(workspace, workspaceRequired), OTAES128GCMFixedBase<TextLen, MaxAADLen, TagLen, OTAESImpl>(this) { }
+        };
+
+    // Fixed-shape implementation using a caller-supplied workspace,
+    // with the optional 4-bit GHASH table as for OTAES128GCMGenericWithWorkspace.
+    template<uint8_t TextLen, uint8_t MaxAADLen = 255, uint8_t TagLen = AES128GCM_TAG_SIZE,
+             class OTAESImpl = OTAESGCM::OTAES128E_default_t>
+    class OTAES128GCMFixedWithWorkspace final : OTAESImpl, public OTAES128GCMFixedBase<TextLen, MaxAADLen, TagLen, OTAESImpl>
+        {
+        public:
+            // Minimum size of workspace required.
+            constexpr static uint8_t workspaceRequired = OTAESImpl::workspaceRequired;
+            // Size of workspace to also enable the table-driven GHASH.
+            constexpr static size_t workspaceWithGHASHTable = workspaceRequired + (size_t)GHASH_TABLE4_SIZE;
             // Construct an instance, supplied with workspace.
-            constexpr OTAES128GCMGenericWithWorkspace(uint8_t *const workspace, const uint8_t workspaceSize)
-                : OTAESImpl(workspace, workspaceSize), OTAES128GCMGenericBase(this)
+            constexpr OTAES128GCMFixedWithWorkspace(uint8_t *const workspace, const size_t workspaceSize)
+                : OTAESImpl(workspace, (workspaceSize >= workspaceRequired) ? workspaceRequired : uint8_t(0)),
+                  OTAES128GCMFixedBase<TextLen, MaxAADLen, TagLen, OTAESImpl>(this,
+                      (workspaceSize >= workspaceWithGHASHTable) ? workspace + workspaceRequired : NULL)
                 { }
             // Verify that the workspace would be adequate before constructing an instance.
-            static constexpr bool isWorkspaceSufficient(uint8_t *const workspace, const uint8_t workspaceSize)
+            static constexpr bool isWorkspaceSufficient(uint8_t *const workspace, const size_t workspaceSize)
                 { return((NULL != workspace) && (workspaceSize >= workspaceRequired)); }
         };
 
 
+    class OTAES128GCMKeyedBase;
+#ifdef OTAESGCM_THREADS
+    class OTAES128GCMThreadPool;
+#endif
+
+    // One message for OTAES128GCMKeyedBase::sealBatch()/openBatch().
+    // Lengths are exact, as for sealLong()/openLong().
+    struct OTAES128GCMBatchFrame
+        {
+        // Keyed context to use; never NULL.
+        const OTAES128GCMKeyedBase *context;
+        // Pointer to 12 byte (96 bit) IV; never NULL.
+        const uint8_t *IV;
+        // Additional data; NULL if length 0.
+        const uint8_t *ADATA;
+        size_t ADATALength;
+        // Text in and out (plaintext to seal or ciphertext to open); NULL if length 0.
+        // output may be the same as input.
+        const uint8_t *input;
+        size_t textLength;
+        uint8_t *output;
+        // Tag written by sealBatch() or checked by openBatch(); never NULL.
+        uint8_t *tag;
+        uint8_t tagLength;
+        };
+
+    // Keyed AES128-GCM context, for many messages under one key.
+    // Caches the expanded AES key schedule and the hash subkey H
+    // so that each message costs only its CTR and GHASH work.
+    // Encryption/decryption semantics (eg padding) are as for OTAES128GCM.
+    // Holds sensitive state, wiped by clearKey() or when rekeyed.
+    // Neither re-entrant nor ISR-safe except where stated.
+    // Once keyed, the const methods only read the context and keep their scratch on the stack,
+    // so one keyed context may be shared read-only by many threads (eg one per worker core)
+    // as long as setKey() and clearKey() are not called meanwhile.
+    class OTAES128GCMKeyedBase
+        {
+        private:
+            // Pointer to an AES block encryption implementation instance; never NULL.
+            OTAES128E * const ap;
+            // Hash subkey H and any multiplier precomputation; all zeros unless keyed.
+            GHASHKey hashKey;
+            // True iff a key is set.
+            bool keyed;
+
+        protected:
+            // Only derived classes can construct an instance.
+            constexpr OTAES128GCMKeyedBase(OTAES128E *aptr) : ap(aptr), hashKey(), keyed(false) { }
+
+        public:
+            // Set (or replace) the 16-byte key; any previous key state is wiped first.
+            // Returns false (and leaves the context unkeyed) if key is NULL.
+            bool setKey(const uint8_t *key);
+            // Securely wipe the key schedule and H; safe to call repeatedly.
+            void clearKey();
+            // True iff a key is set.
+            bool isKeyed() const { return(keyed); }
+
+            /**
+             * @brief   performs AES-GCM encryption with the cached key.
+             * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+             * @param   PDATA           pointer to plaintext array, internally padded up to a multiple of the blocksize; NULL if length 0.
+             * @param   PDATALength     length of plaintext array in bytes, can be zero
+             * @param   ADATA           pointer to additional data array; NULL if length 0.
+             * @param   ADATALength     length of additional data in bytes, can be zero
+             * @param   CDATA           buffer to output ciphertext to, size MUST BE PADDED/EXPANDED TO FULL BLOCKSIZE MULTIPLE at/above PDATAlength
+             * @param   tag             pointer to 16 byte buffer to output tag to; never NULL
+             * @retval  true if encryption is successful, else false (including if not keyed)
+             */
+            bool seal(const uint8_t* IV,
+                const uint8_t* PDATA, uint8_t PDATALength,
+                const uint8_t* ADATA, uint8_t ADATALength,
+                uint8_t* CDATA, uint8_t *tag) const;
+
+            /**
+             * @brief   performs AES-GCM decryption and authentication with the cached key.
+             * @param   IV              pointer to 12 byte (96 bit) IV; never NULL
+             * @param   CDATA           pointer to ciphertext array (multiple of block size, 16 bytes)
+             * @param   CDATALength     length of ciphertext array
+             * @param   ADATA           pointer to additional data array
+             * @param   ADATALength     length of additional data
+             * @param   messageTag      pointer to 16 byte tag to authenticate against; never NULL
+             * @param   PDATA           buffer to output plaintext to; must be same length as CDATA
+             * @retval  true if decryption and authentication successful, else false (including if not keyed)
+             */
+            bool open(const uint8_t* IV,
+                const uint8_t* CDATA, uint8_t CDATALength,
+                const uint8_t* ADATA, uint8_t ADATALength,
+                const uint8_t* messageTag, uint8_t *PDATA) const;
+
+            // As gcmEncryptLong() with the cached key; false if not keyed.
+            bool sealLong(const uint8_t* IV,
+                const uint8_t* PDATA, size_t PDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                uint8_t* CDATA, uint8_t *tag, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+            // As gcmDecryptLong() with the cached key; false if not keyed.
+            bool openLong(const uint8_t* IV,
+                const uint8_t* CDATA, size_t CDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                const uint8_t* messageTag, uint8_t *PDATA, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+
+            // As gcmEncryptInPlace() with the cached key; false if not keyed.
+            bool sealInPlace(const uint8_t* IV,
+                uint8_t *frame, uint8_t frameLength,
+                uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                uint8_t tagOffset, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+            // As gcmDecryptInPlace() with the cached key; false if not keyed.
+            bool openInPlace(const uint8_t* IV,
+                uint8_t *frame, uint8_t frameLength,
+                uint8_t ADATALength, uint8_t bodyOffset, uint8_t bodyLength,
+                uint8_t tagOffset, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+
+            // As gmacCompute() on the generic implementation, with the cached key; false if not keyed.
+            bool gmacCompute(const uint8_t* IV,
+                const uint8_t* ADATA, size_t ADATALength,
+                uint8_t *tag) const;
+            // As gmacVerify() on the generic implementation, with the cached key; false if not keyed.
+            bool gmacVerify(const uint8_t* IV,
+                const uint8_t* ADATA, size_t ADATALength,
+                const uint8_t *messageTag) const;
+
+            /**
+             * @brief   does the AES work for sealing one future message ahead of time, eg while idle,
+             *          so that sealPrepared() is then just XOR and GHASH.
+             *          Precomputes the tag mask E(K, J0) and the counter-mode keystream for the IV
+             *          into a caller buffer of gcmPreparedSize(maxTextLength) bytes.
+             * @param   IV              pointer to 12 byte (96 bit) IV the message will use; never NULL
+             * @param   prepared        buffer to fill; never NULL
+             * @param   preparedSize    size of prepared, at least AES128GCM_PREPARED_OVERHEAD
+             * @retval  true if successful, else false (including if not keyed)
+             * @note    The buffer holds keystream so is as sensitive as the plaintext it will protect,
+             *          and is only for the key current when prepared.
+             */
+            bool prepare(const uint8_t* IV, uint8_t *prepared, size_t preparedSize) const;
+            /**
+             * @brief   seals one message with the IV and material from prepare(), then wipes the buffer
+             *          so that it can never be used again (reusing keystream would be fatal).
+             * @param   prepared        buffer filled by prepare(); never NULL
+             * @param   preparedSize    size of prepared, as passed to prepare()
+             * @retval  true if successful, else false (eg if not prepared, already used, or PDATALength too long)
+             * @note    other parameters as for sealLong()
+             */
+            bool sealPrepared(uint8_t *prepared, size_t preparedSize,
+                const uint8_t* PDATA, size_t PDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                uint8_t* CDATA, uint8_t *tag, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+
+            // As gcmEncryptSegments() with the cached key; false if not keyed.
+            bool sealSegments(const uint8_t* IV,
+                const OTAES128GCMSegment *ADATA, size_t nADATA,
+                const OTAES128GCMTextSegment *text, size_t nText,
+                uint8_t *tag, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+            // As gcmDecryptSegments() with the cached key; false if not keyed.
+            bool openSegments(const uint8_t* IV,
+                const OTAES128GCMSegment *ADATA, size_t nADATA,
+                const OTAES128GCMTextSegment *text, size_t nText,
+                const uint8_t *messageTag, uint8_t tagLength = AES128GCM_TAG_SIZE) const;
+
+            /**
+             * @brief   seals (or opens) many independent messages, possibly under different keys.
+             *          The AES blocks of a window of consecutive frames, whatever their contexts,
+             *          (tag masks, and the keystream of small frames or else final partial-block counters)
+             *          are computed together, interleaved where the engines can (across keys with AES-NI);
+             *          results do not depend on the order of frames.
+             * @param   frames          array of nFrames message descriptors; never NULL
+             * @param   nFrames         number of frames
+             * @param   okBitmap        (nFrames+7)/8 bytes to output per-frame success to,
+             *                          bit (i%8) of byte (i/8) set iff frame i succeeded; never NULL
+             * @retval  number of frames that succeeded; 0 if frames or okBitmap is NULL
+             * @note    Each frame is processed as by sealLong()/openLong() on its context;
+             *          a failed openBatch() frame has nothing written to its output.
+             */
+            static size_t sealBatch(const OTAES128GCMBatchFrame *frames, size_t nFrames, uint8_t *okBitmap)
+                { return(processBatch(frames, nFrames, okBitmap, false)); }
+            static size_t openBatch(const OTAES128GCMBatchFrame *frames, size_t nFrames, uint8_t *okBitmap)
+                { return(processBatch(frames, nFrames, okBitmap, true)); }
+
+#ifdef OTAESGCM_THREADS
+            /**
+             * @brief   multi-threaded sealLong()/openLong() for large messages.
+             *          The text is split into contiguous shares, each run as counter mode plus a partial GHASH;
+             *          the partial hashes are then folded together with powers of H.
+             *          With a started pool its workers and the caller's thread take the shares,
+             *          one per thread, using the contexts in turn;
+             *          otherwise there is one share per context, each run on a thread started for the call
+             *          (the first on the caller's thread).
+             * @param   pool            started pool of worker threads to use, else NULL
+             * @param   contexts        array of nContexts contexts, all keyed with the same key; never NULL.
+             *                          The same context may be repeated as the keyed operations are re-entrant;
+             *                          none may be rekeyed or cleared during the call.
+             * @param   nContexts       number of contexts; without a pool, the most threads to use; at least 1
+             * @note    other parameters as for sealLong()/openLong()
+             * @retval  true if successful, else false (including if any context is unkeyed or has a different key)
+             * @note    At most GCM_PARALLEL_MAX_THREADS threads are used, and fewer where a share
+             *          would be under GCM_PARALLEL_MIN_SHARE bytes or if a thread cannot be started.
+             *          openParallel() authenticates in one parallel pass and decrypts in a second,
+             *          so it never writes unauthenticated plaintext.
+             */
+            static bool sealParallel(OTAES128GCMThreadPool *pool,
+                const OTAES128GCMKeyedBase *const *contexts, uint8_t nContexts,
+                const uint8_t* IV,
+                const uint8_t* PDATA, size_t PDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                uint8_t* CDATA, uint8_t *tag, uint8_t tagLength = AES128GCM_TAG_SIZE);
+            static bool openParallel(OTAES128GCMThreadPool *pool,
+                const OTAES128GCMKeyedBase *const *contexts, uint8_t nContexts,
+                const uint8_t* IV,
+                const uint8_t* CDATA, size_t CDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                const uint8_t* messageTag, uint8_t *PDATA, uint8_t tagLength = AES128GCM_TAG_SIZE);
+            // As above, starting threads for the call.
+            static bool sealParallel(const OTAES128GCMKeyedBase *const *contexts, uint8_t nContexts,
+                const uint8_t* IV,
+                const uint8_t* PDATA, size_t PDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                uint8_t* CDATA, uint8_t *tag, uint8_t tagLength = AES128GCM_TAG_SIZE)
+                { return(sealParallel(NULL, contexts, nContexts, IV, PDATA, PDATALength, ADATA, ADATALength, CDATA, tag, tagLength)); }
+            static bool openParallel(const OTAES128GCMKeyedBase *const *contexts, uint8_t nContexts,
+                const uint8_t* IV,
+                const uint8_t* CDATA, size_t CDATALength,
+                const uint8_t* ADATA, size_t ADATALength,
+                const uint8_t* messageTag, uint8_t *PDATA, uint8_t tagLength = AES128GCM_TAG_SIZE)
+                { return(openParallel(NULL, contexts, nContexts, IV, CDATA, CDATALength, ADATA, ADATALength, messageTag, PDATA, tagLength)); }
+
+            // Smallest share of text worth giving a thread of its own, in bytes.
+            static constexpr size_t GCM_PARALLEL_MIN_SHARE = 64 * 1024;
+            // Most threads used for one message; further contexts are ignored.
+            // Bounds the per-thread state kept on the caller's stack.
+            static constexpr uint8_t GCM_PARALLEL_MAX_THREADS = 64;
+#endif
+
+        private:
+            static size_t processBatch(const OTAES128GCMBatchFrame *frames, size_t nFrames,
+                                       uint8_t *okBitmap, bool decrypt);
+#ifdef OTAESGCM_THREADS
+            static bool checkParallelContexts(const OTAES128GCMKeyedBase *const *contexts, uint8_t nContexts);
+            static void runShare(const OTAES128GCMKeyedBase *ctx, const uint8_t *ICB,
+                                 const uint8_t *input, uint8_t *output, size_t firstBlock, size_t length,
+                                 uint64_t foldPower, uint8_t mode, uint8_t *digest);
+            static void runShareTask(void *job, uint8_t share);
+            static void runParallel(OTAES128GCMThreadPool *pool,
+                                    const OTAES128GCMKeyedBase *const *contexts, uint8_t nContexts, uint8_t nShares,
+                                    const uint8_t *ICB, const uint8_t *input, uint8_t *output,
+                                    size_t textLength, uint8_t mode, uint8_t *S);
+#endif
+        };
+
+    // Keyed context parameterised with type of underlying AES implementation.
+    // Carries the AES workspace (and thus the expanded key) with it;
+    // the key state is wiped on destruction.
+    // Not copyable since the AES implementation points into its own workspace.
+    template<class OTAESImpl = OTAESGCM::OTAES128E_default_t>
+    class OTAES128GCMKeyed final : OTAESImpl, public OTAES128GCMKeyedBase
+        {
+        private:
+            // Minimum size of workspace required.
+            constexpr static uint8_t workspaceRequired = OTAESImpl::workspaceRequired;
+            uint8_t workspace[workspaceRequired];
+        public:
+            // Key management is that of the GCM context, not the AES implementation.
+            using OTAES128GCMKeyedBase::setKey;
+            using OTAES128GCMKeyedBase::clearKey;
+            // Construct an unkeyed instance; call setKey() before use.
+            OTAES128GCMKeyed() : OTAESImpl(workspace, workspaceRequired), OTAES128GCMKeyedBase(this) { }
+            // Construct an instance and set its key.
+            explicit OTAES128GCMKeyed(const uint8_t *key) : OTAESImpl(workspace, workspaceRequired), OTAES128GCMKeyedBase(this) { setKey(key); }
+            // Wipe the key state.
+            ~OTAES128GCMKeyed() { clearKey(); }
+            OTAES128GCMKeyed(const OTAES128GCMKeyed &) = delete;
+            OTAES128GCMKeyed &operator=(const OTAES128GCMKeyed &) = delete;
+        };
+
+
+    // Streaming (incremental) AES128-GCM context, for one message at a time.
+    // Use: initEncrypt() or initDecrypt(), then zero or more updateAAD(),
+    // then zero or more update(), then finish() (encrypt) or verify() (decrypt).
+    // Data may be supplied in chunks of any size; partial blocks are buffered internally.
+    // Unlike gcmEncrypt()/gcmDecrypt() this is standard GCM on the exact lengths,
+    // ie text is not padded and output is the same length as input.
+    // When decrypting, plaintext is released by update() before the tag is checked,
+    // so the caller must not act on any of it until verify() returns true.
+    // Holds sensitive state from init until finish()/verify()/clear().
+    // Neither re-entrant nor ISR-safe except where stated.
+    class OTAES128GCMStreamBase
+        {
+        private:
+            // Stages of processing a message.
+            enum : uint8_t { stateIdle, stateAAD, stateText };
+            // Pointer to an AES block encryption implementation instance; never NULL.
+            OTAES128E * const ap;
+            // Hash subkey H and any multiplier precomputation.
+            GHASHKey hashKey;
+            // Initial counter block J0, used for the tag.
+            uint8_t ICB[AES128GCM_BLOCK_SIZE];
+            // Counter block for the next text block.
+            uint8_t ctrBlock[AES128GCM_BLOCK_SIZE];
+            // Running GHASH value.
+            uint8_t S[AES128GCM_BLOCK_SIZE];
+            // Partial AAD or ciphertext block awaiting GHASH.
+            uint8_t buf[AES128GCM_BLOCK_SIZE];
+            // Keystream for the partial text block.
+            uint8_t keystream[AES128GCM_BLOCK_SIZE];
+            // Total AAD and text lengths so far in bytes.
+            uint64_t ADATALength;
+            uint64_t textLength;
+            // Bytes held in buf, [0,15].
+            uint8_t bufLength;
+            // Current stage.
+            uint8_t state;
+            // True if decrypting.
+            bool decrypting;
+
+            // Common initialisation; true if successful.
+            bool init(const uint8_t *key, const uint8_t *IV, bool decrypt);
+            // Hash any pending partial block and the lengths, and compute the tag into tag.
+            void computeTag(uint8_t *tag);
+
+        protected:
+            // Only derived classes can construct an instance.
+            constexpr OTAES128GCMStreamBase(OTAES128E *aptr)
+              : ap(aptr), hashKey(), ICB(), ctrBlock(), S(), buf(), keystream(),
+                ADATALength(0), textLength(0), bufLength(0), state(stateIdle), decrypting(false) { }
+
+        public:
+            // Start encrypting a message with the 16-byte key and 12-byte IV; neither NULL.
+            // Any message in progress is abandoned.
+            bool initEncrypt(const uint8_t *key, const uint8_t *IV) { return(init(key, IV, false)); }
+            // Start decrypting a message with the 16-byte key and 12-byte IV; neither NULL.
+            // Any message in progress is abandoned.
+            bool initDecrypt(const uint8_t *key, const uint8_t *IV) { return(init(key, IV, true)); }
+
+            /**
+             * @brief   adds additional authenticated data; all must be added before any text
+             * @param   ADATA           pointer to additional data; NULL if length 0
+             * @param   ADATALength     length of additional data in bytes, can be zero
+             * @retval  true if successful, else false (eg if not initialised or text already started)
+             */
+            bool updateAAD(const uint8_t *ADATA, size_t ADATALength);
+
+            /**
+             * @brief   encrypts or decrypts the next chunk of text
+             * @param   input           pointer to input text; NULL if length 0
+             * @param   length          length of input in bytes, can be zero
+             * @param   output          buffer for length bytes of output; may be the same as input
+             * @retval  true if successful, else false (eg if not initialised or text too long)
+             */
+            bool update(const uint8_t *input, size_t length, uint8_t *output);
+
+            /**
+             * @brief   completes encryption, generating the tag and wiping state
+             * @param   tag             pointer to 16 byte buffer to output tag to; never NULL
+             * @retval  true if successful, else false (eg if not initialised for encryption)
+             */
+            bool finish(uint8_t *tag);
+
+            /**
+             * @brief   completes decryption, checking the tag and wiping state
+             * @param   messageTag      pointer to 16 byte tag to authenticate against; never NULL
+             * @retval  true if the message is authentic, else false
+             */
+            bool verify(const uint8_t *messageTag);
+
+            // Abandon any message in progress, securely wiping the key schedule and state.
+            void clear();
+        };
+
+    // Streaming context parameterised with type of underlying AES implementation.
+    // Carries the AES workspace with it; state is wiped on destruction.
+    // Not copyable since the AES implementation points into its own workspace.
+    template<class OTAESImpl = OTAESGCM::OTAES128E_default_t>
+    class OTAES128GCMStream final : OTAESImpl, public OTAES128GCMStreamBase
+        {
+        private:
+            // Minimum size of workspace required.
+            constexpr static uint8_t workspaceRequired = OTAESImpl::workspaceRequired;
+            uint8_t workspace[workspaceRequired];
+        public:
+            // State management is that of the GCM context, not the AES implementation.
+            using OTAES128GCMStreamBase::clear;
+            // Construct an idle instance.
+            OTAES128GCMStream() : OTAESImpl(workspace, workspaceRequired), OTAES128GCMStreamBase(this) { }
+            // Wipe any state.
+            ~OTAES128GCMStream() { clear(); }
+            OTAES128GCMStream(const OTAES128GCMStream &) = delete;
+            OTAES128GCMStream &operator=(const OTAES128GCMStream &) = delete;
+        };
+
+
+    // Caller-allocated state for the ..._DEFAULT_CACHED bridge functions, passed as their state parameter.
+    // Caches the expanded key and H, with a copy of the key to recognise it by,
+    // and rebuilds them only when a call uses a different key,
+    // so that a frame layer calling once per frame with the same key skips the key setup.
+    // Opaque to callers beyond construction and clear().
+    // Holds sensitive key material until clear() or destruction.
+    // Neither re-entrant nor ISR-safe: use one per thread/context.
+    class OTAES128GCMBridgeState final
+        {
+        private:
+            // Keyed context holding the expanded key and H;
+            // the fast engine for the platform (the AVR one on AVR), as for OTAES128GCMKeyCacheShard.
+            OTAES128GCMKeyed<OTAES128E_fast_t> ctx;
+            // Copy of the key that ctx holds; all zeros unless ctx is keyed.
+            uint8_t cachedKey[AES128GCM_KEY_SIZE];
+        public:
+            // Construct an unkeyed instance.
+            OTAES128GCMBridgeState() : ctx(), cachedKey() { }
+            // Wipe the key state.
+            ~OTAES128GCMBridgeState() { clear(); }
+            OTAES128GCMBridgeState(const OTAES128GCMBridgeState &) = delete;
+            OTAES128GCMBridgeState &operator=(const OTAES128GCMBridgeState &) = delete;
+            // Returns the context keyed with key, rekeying only if key differs from the cached one;
+            // NULL if key is NULL.
+            const OTAES128GCMKeyedBase *forKey(const uint8_t *key);
+            // Securely wipe the cached key, key schedule and H; safe to call repeatedly.
+            void clear();
+        };
+
     // AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) encryption/authentication function.
     // This is an adaptor/bridge function to ease outside use in simple cases
     // without explicit type/library dependencies, but use with care.
@@ -213,7 +1013,8 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
     // without explicit type/library dependencies, but use with care.
     // A workspace is passed in (and cleared on exit);
     // this routine will fail (safely, returning false) if the workspace is NULL or too small.
-    // The workspace requirement depends on the implementation used.
+    // The workspace requirement depends on the implementation used;
+    // a workspace of OTAES128GCMGenericWithWorkspace<>::workspaceWithGHASHTable bytes is faster.
     // Other than the authtext, all sizes are fixed:
     //   * textSize is 32 (or zero if plaintext is NULL)
     //   * keySize is 16
@@ -225,7 +1026,7 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
     // Note that the authenticated text size is not fixed, ie is zero or more bytes.
     // Returns true on success, false on failure.
     bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
-            uint8_t *workspace, uint8_t workspaceSize,
+            uint8_t *workspace, size_t workspaceSize,
             const uint8_t *key, const uint8_t *iv,
             const uint8_t *authtext, uint8_t authtextSize,
             const uint8_t *plaintext,
@@ -236,7 +1037,8 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
     // without explicit type/library dependencies, but use with care.
     // A workspace is passed in (and cleared on exit);
     // this routine will fail (safely, returning false) if the workspace is NULL or too small.
-    // The workspace requirement depends on the implementation used.
+    // The workspace requirement depends on the implementation used;
+    // a workspace of OTAES128GCMGenericWithWorkspace<>::workspaceWithGHASHTable bytes is faster.
     // Other than the authtext, all sizes are fixed:
     //   * textSize is 32 (or zero if ciphertext is NULL)
     //   * keySize is 16
@@ -249,11 +1051,178 @@ static constexpr uint8_t AES128GCM_TAG_SIZE   = 16; // GCM authentication tag si
     // Decrypts/authenticates the output of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS.)
     // Returns true on success, false on failure.
     bool fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE(
-            uint8_t *workspace, uint8_t workspaceSize,
+            uint8_t *workspace, size_t workspaceSize,
             const uint8_t *key, const uint8_t *iv,
             const uint8_t *authtext, uint8_t authtextSize,
             const uint8_t *ciphertext, const uint8_t *tag,
             uint8_t *plaintextOut);
+
+
+    // AES-GCM 128-bit-key variable-size text encryption/authentication function.
+    // As fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS()
+    // but standard GCM on the exact text size (0 to 255 bytes), with no padding:
+    // the cipher-text is the same size as the plain-text,
+    // saving buffer space and airtime on short frames.
+    // With a textSize of 32 (or 0) the output is identical to that of the fixed32B... functions,
+    // so either may decrypt the other's frames.
+    // The plaintext may be NULL only if textSize is 0; likewise ciphertextOut.
+    // Returns true on success, false on failure.
+    bool varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(void *state,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *plaintext, uint8_t textSize,
+            uint8_t *ciphertextOut, uint8_t *tagOut);
+
+    // AES-GCM 128-bit-key variable-size text decryption/authentication function.
+    // Decrypts/authenticates the output of varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS();
+    // plaintextOut is textSize bytes and is not written to if authentication fails.
+    // Returns true on success, false on failure.
+    bool varTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(void *state,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *ciphertext, uint8_t textSize, const uint8_t *tag,
+            uint8_t *plaintextOut);
+
+    // AES-GCM 128-bit-key variable-size text encryption/authentication function using work space passed in.
+    // As varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS()
+    // with the workspace handling of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE().
+    // Returns true on success, false on failure.
+    bool varTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
+            uint8_t *workspace, size_t workspaceSize,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *plaintext, uint8_t textSize,
+            uint8_t *ciphertextOut, uint8_t *tagOut);
+
+    // AES-GCM 128-bit-key variable-size text decryption/authentication function using work space passed in.
+    // As varTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS()
+    // with the workspace handling of fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE().
+    // Returns true on success, false on failure.
+    bool varTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE(
+            uint8_t *workspace, size_t workspaceSize,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *ciphertext, uint8_t textSize, const uint8_t *tag,
+            uint8_t *plaintextOut);
+
+
+    // AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) encryption/authentication function
+    // caching the key setup between calls.
+    // As fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS() (with identical output)
+    // but state must point to a caller-allocated OTAES128GCMBridgeState,
+    // which keeps the expanded key and H while successive calls use the same key;
+    // this routine will fail (safely, returning false) if state is NULL.
+    // Returns true on success, false on failure.
+    bool fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED(void *state,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *plaintext,
+            uint8_t *ciphertextOut, uint8_t *tagOut);
+
+    // AES-GCM 128-bit-key fixed-size text (256-bit/32-byte) decryption/authentication function
+    // caching the key setup between calls.
+    // As fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS()
+    // with the state handling of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED().
+    // Returns true on success, false on failure.
+    bool fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_CACHED(void *state,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *ciphertext, const uint8_t *tag,
+            uint8_t *plaintextOut);
+
+    // AES-GCM 128-bit-key variable-size text encryption/authentication function
+    // caching the key setup between calls.
+    // As varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS()
+    // with the state handling of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED().
+    // Returns true on success, false on failure.
+    bool varTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED(void *state,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *plaintext, uint8_t textSize,
+            uint8_t *ciphertextOut, uint8_t *tagOut);
+
+    // AES-GCM 128-bit-key variable-size text decryption/authentication function
+    // caching the key setup between calls.
+    // As varTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS()
+    // with the state handling of fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED().
+    // Returns true on success, false on failure.
+    bool varTextSize12BNonce16BTagSimpleDec_DEFAULT_CACHED(void *state,
+            const uint8_t *key, const uint8_t *iv,
+            const uint8_t *authtext, uint8_t authtextSize,
+            const uint8_t *ciphertext, uint8_t textSize, const uint8_t *tag,
+            uint8_t *plaintextOut);
+
+
+    // AES-GCM 128-bit-key fixed-size text encryption/authentication function with a fixed tag size,
+    // which may be truncated (eg to 8 bytes) to save airtime; see isValidGCMTagLength().
+    // As fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS() but:
+    //   * textSize is as specified (or zero if plaintext is NULL), and is not padded
+    //   * tagSize is as specified, the leading bytes of the full tag
+    // With textSize 32 and tagSize 16 the output is identical to fixed32BTextSize12BNonce16BTagSimpleEnc...
+    // Returns true on success, false on failure.
+    template<uint8_t textSize, uint8_t tagSize>
+    bool fixedTextSize12BNonceTagSimpleEnc_DEFAULT_STATELESS(void *,
+            const uint8_t *const key, const uint8_t *const iv,
+            const uint8_t *const authtext, const uint8_t authtextSize,
+            const uint8_t *const plaintext,
+            uint8_t *const ciphertextOut, uint8_t *const tagOut)
+        {
+        static_assert(isValidGCMTagLength(tagSize), "tag size not allowed for GCM");
+        OTAES128GCMGeneric<> i;
+        return(i.gcmEncryptLong(key, iv, plaintext, (NULL == plaintext) ? 0 : textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut, tagSize));
+        }
+
+    // AES-GCM 128-bit-key fixed-size text decryption/authentication function with a fixed, possibly truncated, tag size.
+    // Decrypts/authenticates the output of fixedTextSize12BNonceTagSimpleEnc_DEFAULT_STATELESS();
+    // plaintextOut is not written to if authentication fails.
+    // Returns true on success, false on failure.
+    template<uint8_t textSize, uint8_t tagSize>
+    bool fixedTextSize12BNonceTagSimpleDec_DEFAULT_STATELESS(void *,
+            const uint8_t *const key, const uint8_t *const iv,
+            const uint8_t *const authtext, const uint8_t authtextSize,
+            const uint8_t *const ciphertext, const uint8_t *const tag,
+            uint8_t *const plaintextOut)
+        {
+        static_assert(isValidGCMTagLength(tagSize), "tag size not allowed for GCM");
+        OTAES128GCMGeneric<> i;
+        return(i.gcmDecryptLong(key, iv, ciphertext, (NULL == ciphertext) ? 0 : textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut, tagSize));
+        }
+
+    // AES-GCM 128-bit-key fixed-size text encryption/authentication function with a fixed, possibly truncated, tag size,
+    // using work space passed in (and cleared on exit) as for fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE().
+    // Returns true on success, false on failure.
+    template<uint8_t textSize, uint8_t tagSize>
+    bool fixedTextSize12BNonceTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
+            uint8_t *const workspace, const size_t workspaceSize,
+            const uint8_t *const key, const uint8_t *const iv,
+            const uint8_t *const authtext, const uint8_t authtextSize,
+            const uint8_t *const plaintext,
+            uint8_t *const ciphertextOut, uint8_t *const tagOut)
+        {
+        static_assert(isValidGCMTagLength(tagSize), "tag size not allowed for GCM");
+        typedef OTAES128GCMGenericWithWorkspace<> t;
+        if(!t::isWorkspaceSufficient(workspace, workspaceSize)) { return(false); } // ERROR
+        t i(workspace, workspaceSize);
+        return(i.gcmEncryptLong(key, iv, plaintext, (NULL == plaintext) ? 0 : textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, ciphertextOut, tagOut, tagSize));
+        }
+
+    // AES-GCM 128-bit-key fixed-size text decryption/authentication function with a fixed, possibly truncated, tag size,
+    // using work space passed in (and cleared on exit) as for fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE().
+    // Returns true on success, false on failure.
+    template<uint8_t textSize, uint8_t tagSize>
+    bool fixedTextSize12BNonceTagSimpleDec_DEFAULT_WITH_WORKSPACE(
+            uint8_t *const workspace, const size_t workspaceSize,
+            const uint8_t *const key, const uint8_t *const iv,
+            const uint8_t *const authtext, const uint8_t authtextSize,
+            const uint8_t *const ciphertext, const uint8_t *const tag,
+            uint8_t *const plaintextOut)
+        {
+        static_assert(isValidGCMTagLength(tagSize), "tag size not allowed for GCM");
+        typedef OTAES128GCMGenericWithWorkspace<> t;
+        if(!t::isWorkspaceSufficient(workspace, workspaceSize)) { return(false); } // ERROR
+        t i(workspace, workspaceSize);
+        return(i.gcmDecryptLong(key, iv, ciphertext, (NULL == ciphertext) ? 0 : textSize, (0 == authtextSize) ? NULL : authtext, authtextSize, tag, plaintextOut, tagSize));
+        }
     }
 
 
@@ -0,0 +1,243 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* OpenTRV OTAESGCM per-node keyed-context cache, eg for a gateway/concentrator. */
+
+#ifndef ARDUINO_LIB_OTAESGCM_OTAESGCMKEYCACHE_H
+#define ARDUINO_LIB_OTAESGCM_OTAESGCMKEYCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "OTAESGCM_CPUFeatures.h"
+#include "OTAESGCM_OTAESGCM.h"
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+    // Smallest power of two at least n; for sizing the key cache index.
+    constexpr uint32_t keyCacheIndexSize(const uint32_t n, const uint32_t p = 1)
+        { return((p >= n) ? p : keyCacheIndexSize(n, p << 1)); }
+
+    // Cache of up to Capacity keyed contexts indexed by node ID, eg one per leaf node at a gateway,
+    // so that each frame costs only the CTR and GHASH work, not the key schedule and H setup.
+    // The contexts are held in a fixed slab of cache-line-aligned slots inside this object,
+    // so memory is bounded and nothing is allocated after construction;
+    // allocate statically (or with C++17 aligned new) as large instances are too big for a stack.
+    // When full, the least recently useful context is evicted by CLOCK (second chance):
+    // find() sets a slot's reference bit, and a newly inserted context starts without one,
+    // so a burst of nodes each heard once cannot flush the regular ones.
+    // An evicted or removed context's key schedule and H are securely wiped.
+    // A context pointer is valid only until the next insert(), remove() or clear().
+    // Neither re-entrant nor ISR-safe: use one shard per thread/core (see OTAES128GCMShardedKeyCache).
+    template<uint16_t Capacity, class OTAESImpl = OTAESGCM::OTAES128E_fast_t>
+    class alignas(CACHE_LINE_SIZE) OTAES128GCMKeyCacheShard final
+        {
+        static_assert((Capacity > 0) && (Capacity <= 16384), "capacity out of range");
+
+        private:
+            // One cached context with its node ID and CLOCK reference bit.
+            struct alignas(CACHE_LINE_SIZE) Slot
+                {
+                OTAES128GCMKeyed<OTAESImpl> ctx;
+                // Node ID; valid iff ctx is keyed.
+                uint64_t nodeID;
+                bool referenced;
+                Slot() : ctx(), nodeID(0), referenced(false) { }
+                };
+
+            // Open-addressed index of (slot number + 1), 0 if empty, at most half full.
+            static constexpr uint16_t IndexSize = (uint16_t)keyCacheIndexSize(2U * Capacity);
+            static constexpr uint16_t IndexMask = IndexSize - 1;
+
+            Slot slots[Capacity];
+            uint16_t index[IndexSize];
+            // Slots used at least once; slots from here on have never been keyed.
+            uint16_t used;
+            // Keyed slots.
+            uint16_t count;
+            // CLOCK hand.
+            uint16_t hand;
+
+            // Index position holding nodeID, else the empty position that ends its probe sequence.
+            uint16_t probe(const uint64_t nodeID) const
+                {
+                uint16_t i = (uint16_t)(hashNodeID(nodeID) & IndexMask);
+                while((0 != index[i]) && (slots[index[i] - 1].nodeID != nodeID)) { i = (uint16_t)((i + 1) & IndexMask); }
+                return(i);
+                }
+
+            // Empties index position i, moving back any later entries of its run (no tombstones).
+            void unindex(uint16_t i)
+                {
+                index[i] = 0;
+                for(uint16_t j = (uint16_t)((i + 1) & IndexMask); 0 != index[j]; j = (uint16_t)((j + 1) & IndexMask))
+                    {
+                    const uint16_t home = (uint16_t)(hashNodeID(slots[index[j] - 1].nodeID) & IndexMask);
+                    // The entry at j may move to i unless its home lies cyclically in (i, j].
+                    const bool stays = (i <= j) ? ((home > i) && (home <= j)) : ((home > i) || (home <= j));
+                    if(stays) { continue; }
+                    index[i] = index[j];
+                    index[j] = 0;
+                    i = j;
+                    }
+                }
+
+            // Wipes slot s and removes it from the index position i.
+            void evict(Slot &s, const uint16_t i)
+                {
+                s.ctx.clearKey();
+                s.referenced = false;
+                unindex(i);
+                --count;
+                }
+
+            // A slot to (re)use: one never used, else chosen by CLOCK and wiped.
+            Slot &victim()
+                {
+                if(used < Capacity) { return(slots[used++]); }
+                for( ; ; )
+                    {
+                    Slot &s = slots[hand];
+                    hand = (uint16_t)((hand + 1 == Capacity) ? 0 : hand + 1);
+                    if(!s.ctx.isKeyed()) { return(s); }
+                    if(s.referenced) { s.referenced = false; continue; }
+                    evict(s, probe(s.nodeID));
+                    return(s);
+                    }
+                }
+
+        public:
+            // Construct an empty cache.
+            OTAES128GCMKeyCacheShard() : slots(), index(), used(0), count(0), hand(0) { }
+
+            OTAES128GCMKeyCacheShard(const OTAES128GCMKeyCacheShard &) = delete;
+            OTAES128GCMKeyCacheShard &operator=(const OTAES128GCMKeyCacheShard &) = delete;
+
+            // Well-mixed hash of a node ID (the splitmix64 finaliser);
+            // the low bits index a shard's slots and the high bits pick the shard.
+            static uint64_t hashNodeID(uint64_t x)
+                {
+                x ^= x >> 30;
+                x *= 0xbf58476d1ce4e5b9ULL;
+                x ^= x >> 27;
+                x *= 0x94d049bb133111ebULL;
+                return(x ^ (x >> 31));
+                }
+
+            // Returns the cached context for nodeID, marking it recently used; NULL if not cached.
+            const OTAES128GCMKeyedBase *find(const uint64_t nodeID)
+                {
+                const uint16_t i = probe(nodeID);
+                if(0 == index[i]) { return(NULL); }
+                Slot &s = slots[index[i] - 1];
+                s.referenced = true;
+                return(&s.ctx);
+                }
+
+            // Caches a context for nodeID keyed with the 16-byte key, evicting another if full,
+            // or rekeys the existing one (eg after a key change);
+            // returns the keyed context, or NULL if key is NULL.
+            const OTAES128GCMKeyedBase *insert(const uint64_t nodeID, const uint8_t *const key)
+                {
+                if(NULL == key) { return(NULL); }
+                uint16_t i = probe(nodeID);
+                if(0 != index[i])
+                    {
+                    Slot &s = slots[index[i] - 1];
+                    s.ctx.setKey(key);
+                    return(&s.ctx);
+                    }
+                Slot &s = victim();
+                // Eviction may have moved index entries.
+                i = probe(nodeID);
+                s.ctx.setKey(key);
+                s.nodeID = nodeID;
+                s.referenced = false;
+                index[i] = (uint16_t)(&s - slots + 1);
+                ++count;
+                return(&s.ctx);
+                }
+
+            // Removes and wipes any context for nodeID, eg when its key is revoked; true if there was one.
+            bool remove(const uint64_t nodeID)
+                {
+                const uint16_t i = probe(nodeID);
+                if(0 == index[i]) { return(false); }
+                evict(slots[index[i] - 1], i);
+                return(true);
+                }
+
+            // Removes and wipes all contexts.
+            void clear()
+                {
+                for(uint16_t s = 0; s < used; ++s) { slots[s].ctx.clearKey(); slots[s].referenced = false; }
+                memset(index, 0, sizeof(index));
+                used = 0;
+                count = 0;
+                hand = 0;
+                }
+
+            // Number of contexts cached.
+            uint16_t size() const { return(count); }
+            // Maximum number of contexts cached.
+            static constexpr uint16_t capacity() { return(Capacity); }
+        };
+
+    // Key-context cache split into NShards independent shards of CapacityPerShard contexts each,
+    // eg one per receive worker thread/core at a gateway.
+    // Each node ID belongs to exactly one shard, given by shardFor(),
+    // so frames routed to the worker owning that shard need no cross-core locking:
+    // a shard must only ever be used from one thread at a time.
+    // Shards are cache-line aligned so that workers do not falsely share lines.
+    // Allocate statically (or with C++17 aligned new); see OTAES128GCMKeyCacheShard.
+    template<uint8_t NShards, uint16_t CapacityPerShard, class OTAESImpl = OTAESGCM::OTAES128E_fast_t>
+    class OTAES128GCMShardedKeyCache final
+        {
+        static_assert(NShards > 0, "at least one shard needed");
+
+        public:
+            typedef OTAES128GCMKeyCacheShard<CapacityPerShard, OTAESImpl> shard_t;
+
+        private:
+            shard_t shards[NShards];
+
+        public:
+            // Construct an empty cache.
+            OTAES128GCMShardedKeyCache() : shards() { }
+
+            // The shard [0, NShards) holding any context for nodeID.
+            static uint8_t shardFor(const uint64_t nodeID)
+                { return((uint8_t)((shard_t::hashNodeID(nodeID) >> 32) % NShards)); }
+            // Shard i; i must be less than NShards.
+            shard_t &shard(const uint8_t i) { return(shards[i]); }
+            // Number of shards.
+            static constexpr uint8_t shardCount() { return(NShards); }
+
+            // Removes and wipes all contexts in all shards; only while no shard is in use.
+            void clear() { for(uint8_t i = 0; i < NShards; ++i) { shards[i].clear(); } }
+        };
+
+
+    }
+
+#endif
@@ -0,0 +1,410 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* OpenTRV OTAESGCM multi-core received-frame authentication/decryption pipeline, eg for a gateway. */
+
+#ifndef ARDUINO_LIB_OTAESGCM_OTAESGCMPIPELINE_H
+#define ARDUINO_LIB_OTAESGCM_OTAESGCMPIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "OTAESGCM_CPUFeatures.h"
+#include "OTAESGCM_OTAESGCM.h"
+#include "OTAESGCM_OTAESGCMKeyCache.h"
+
+// Hosted (multi-threaded) builds only.
+#ifdef OTAESGCM_THREADS
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+    // Bounded lock-free multi-producer multi-consumer queue of up to Capacity items (a power of two).
+    // Each cell carries a sequence number saying whether it is ready for the producer or consumer of that lap,
+    // so producers and consumers contend only on their own position counter
+    // (D. Vyukov's bounded MPMC queue).
+    // Nothing is allocated; T should be small and trivially copyable, eg a pointer.
+    template<class T, uint16_t Capacity>
+    class OTAESGCMBoundedQueue final
+        {
+        static_assert((Capacity >= 2) && (0 == (Capacity & (Capacity - 1))), "capacity must be a power of two");
+
+        private:
+            static constexpr size_t Mask = Capacity - 1;
+
+            struct Cell
+                {
+                // Position + 1 when holding the item for position, else position when free for it.
+                std::atomic<size_t> seq;
+                T item;
+                };
+
+            Cell cells[Capacity];
+            // Next position to push to and to pop from, on separate cache lines.
+            alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+            alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+
+        public:
+            // Construct an empty queue.
+            OTAESGCMBoundedQueue() : tail(0), head(0)
+                { for(size_t i = 0; i < Capacity; ++i) { cells[i].seq.store(i, std::memory_order_relaxed); } }
+
+            OTAESGCMBoundedQueue(const OTAESGCMBoundedQueue &) = delete;
+            OTAESGCMBoundedQueue &operator=(const OTAESGCMBoundedQueue &) = delete;
+
+            // Appends item; false if the queue is full.
+            bool tryPush(const T &item)
+                {
+                size_t pos = tail.load(std::memory_order_relaxed);
+                for( ; ; )
+                    {
+                    Cell &c = cells[pos & Mask];
+                    const intptr_t diff = (intptr_t)c.seq.load(std::memory_order_acquire) - (intptr_t)pos;
+                    if(diff < 0) { return(false); }
+                    if(diff > 0) { pos = tail.load(std::memory_order_relaxed); continue; }
+                    if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        {
+                        c.item = item;
+                        c.seq.store(pos + 1, std::memory_order_release);
+                        return(true);
+                        }
+                    }
+                }
+
+            // Removes up to maxItems of the oldest items into items, claiming them with one update of head;
+            // returns the number removed, 0 if the queue is empty.
+            size_t popBatch(T *const items, const size_t maxItems)
+                {
+                size_t pos = head.load(std::memory_order_relaxed);
+                for( ; ; )
+                    {
+                    // Count the run of published items from pos.
+                    size_t n = 0;
+                    while((n < maxItems) && (n < Capacity) &&
+                          (cells[(pos + n) & Mask].seq.load(std::memory_order_acquire) == pos + n + 1)) { ++n; }
+                    if(0 == n)
+                        {
+                        // Empty, unless another consumer has just moved head on.
+                        const size_t now = head.load(std::memory_order_relaxed);
+                        if(now == pos) { return(0); }
+                        pos = now;
+                        continue;
+                        }
+                    if(!head.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) { continue; }
+                    for(size_t i = 0; i < n; ++i)
+                        {
+                        Cell &c = cells[(pos + i) & Mask];
+                        items[i] = c.item;
+                        c.seq.store(pos + i + Capacity, std::memory_order_release);
+                        }
+                    return(n);
+                    }
+                }
+
+            // Removes the oldest item into item; false if the queue is empty.
+            bool tryPop(T &item) { return(1 == popBatch(&item, 1)); }
+
+            // Maximum number of items held.
+            static constexpr uint16_t capacity() { return(Capacity); }
+        };
+
+    // One received frame for OTAES128GCMPipeline::submit().
+    // Lengths are exact, as for openLong().
+    // Owned by the submitter, and must stay valid and untouched until its completion callback.
+    struct OTAES128GCMPipelineFrame
+        {
+        // Sending node, whose key is looked up and cached by the pipeline.
+        uint64_t nodeID;
+        // Pointer to 12 byte (96 bit) IV; never NULL.
+        const uint8_t *IV;
+        // Additional data; NULL if length 0.
+        const uint8_t *ADATA;
+        size_t ADATALength;
+        // Ciphertext in and plaintext out; NULL if length 0.
+        // PDATA may be the same as CDATA.
+        const uint8_t *CDATA;
+        size_t textLength;
+        uint8_t *PDATA;
+        // Tag to check; never NULL.
+        uint8_t *tag;
+        uint8_t tagLength;
+        // Passed back untouched, eg to identify the frame or its receive buffer.
+        void *user;
+        };
+
+    // Fetches the 16-byte key for nodeID into key; returns false if the node is unknown.
+    // Called from worker threads (possibly several at once) on a key-cache miss.
+    typedef bool (*OTAES128GCMPipelineKeyLookup)(uint64_t nodeID, uint8_t *key, void *arg);
+    // Called once per submitted frame from the worker thread that processed it:
+    // ok is true iff the frame authenticated and its plaintext is in PDATA;
+    // if false nothing has been written to PDATA.
+    // The frame may be reused or released from here on.
+    typedef void (*OTAES128GCMPipelineCompletion)(OTAES128GCMPipelineFrame *frame, bool ok, void *arg);
+
+    // Multi-core pipeline to authenticate and decrypt received frames from many nodes, eg at a gateway.
+    // Receivers (any number of threads) submit() frames to bounded lock-free ingress queues,
+    // one per key-cache shard, chosen by node ID;
+    // each of up to MaxWorkers worker threads, optionally pinned to its own core,
+    // owns a fixed subset of the shards, so that each node's keyed context stays with one core
+    // and the per-node key cache needs no locking.
+    // Workers dequeue frames in batches, open them with openBatch() on the cached keyed contexts
+    // (which interleaves the AES blocks of frames from different nodes),
+    // and report each result to the completion callback.
+    // Frames from one node complete in submission order if submitted from one thread.
+    // A full queue is reported back to the submitter (backpressure) rather than blocking.
+    // An idle worker spins for up to IDLE_SPINS polls, yielding the CPU, then sleeps until
+    // a frame is submitted to one of its shards or the pipeline is stopped.
+    // Allocate statically (or with C++17 aligned new) as instances are large and cache-line aligned.
+    template<uint8_t MaxWorkers, uint16_t QueueCapacity = 256, uint16_t KeysPerShard = 64,
+             class OTAESImpl = OTAESGCM::OTAES128E_fast_t>
+    class OTAES128GCMPipeline final
+        {
+        public:
+            // Most frames taken from a queue at once.
+            static constexpr uint8_t BATCH_SIZE = 16;
+            // Empty polls an idle worker makes before it sleeps.
+            static constexpr uint16_t IDLE_SPINS = 256;
+
+        private:
+            typedef OTAES128GCMShardedKeyCache<MaxWorkers, KeysPerShard, OTAESImpl> cache_t;
+
+            // Keyed contexts, one shard per ingress queue.
+            cache_t cache;
+            // Ingress queue for each shard.
+            OTAESGCMBoundedQueue<OTAES128GCMPipelineFrame *, QueueCapacity> queues[MaxWorkers];
+            std::thread workers[MaxWorkers];
+            // Where worker w sleeps when idle; a submitter to one of its shards wakes it.
+            struct alignas(CACHE_LINE_SIZE) Sleeper
+                {
+                // Count of frames submitted to the worker's shards, wrapping.
+                std::atomic<uint32_t> submitted;
+                // True while the worker is asleep or about to be.
+                std::atomic<bool> sleeping;
+                std::mutex lock;
+                std::condition_variable wake;
+                Sleeper() : submitted(0), sleeping(false) { }
+                };
+            Sleeper sleepers[MaxWorkers];
+            // Workers started, [0, MaxWorkers]; 0 when stopped.
+            uint8_t nWorkers;
+            // Workers asked for by start(), so shard s is served by worker s % workerStep;
+            // set only while stopped.
+            uint8_t workerStep;
+            // True while frames are accepted and workers run.
+            std::atomic<bool> running;
+            const OTAES128GCMPipelineKeyLookup keyLookup;
+            const OTAES128GCMPipelineCompletion completion;
+            void *const arg;
+
+            // Opens n frames from shard s's queue, reporting each.
+            void processBatch(const uint8_t s, OTAES128GCMPipelineFrame *const *const frames, const size_t n)
+                {
+                typename cache_t::shard_t &shard = cache.shard(s);
+                OTAES128GCMBatchFrame batch[BATCH_SIZE];
+                OTAES128GCMPipelineFrame *pending[BATCH_SIZE];
+                size_t nPending = 0;
+                for(size_t i = 0; i <= n; ++i)
+                    {
+                    OTAES128GCMPipelineFrame *const f = (i < n) ? frames[i] : NULL;
+                    const OTAES128GCMKeyedBase *ctx = (NULL == f) ? NULL : shard.find(f->nodeID);
+                    // Open the pending frames before a cache insert can evict one of their contexts, and at the end.
+                    if((NULL == ctx) && (0 != nPending))
+                        {
+                        uint8_t ok[(BATCH_SIZE + 7) / 8];
+                        OTAES128GCMKeyedBase::openBatch(batch, nPending, ok);
+                        for(size_t j = 0; j < nPending; ++j) { completion(pending[j], 0 != (ok[j / 8] & (1U << (j % 8))), arg); }
+                        nPending = 0;
+                        }
+                    if(NULL == f) { break; }
+                    if(NULL == ctx)
+                        {
+                        uint8_t key[AES128GCM_KEY_SIZE];
+                        if(keyLookup(f->nodeID, key, arg)) { ctx = shard.insert(f->nodeID, key); }
+                        volatile uint8_t *vp = key;
+                        for(size_t j = 0; j < sizeof(key); ++j) { vp[j] = 0; }
+                        if(NULL == ctx) { completion(f, false, arg); continue; }
+                        }
+                    batch[nPending] = { ctx, f->IV, f->ADATA, f->ADATALength, f->CDATA, f->textLength, f->PDATA, f->tag, f->tagLength };
+                    pending[nPending++] = f;
+                    }
+                }
+
+            // Takes and processes one batch from each shard in [first, MaxWorkers) stepping by step;
+            // returns false if they were all empty.
+            bool pollShards(const uint8_t first, const uint8_t step)
+                {
+                bool any = false;
+                OTAES128GCMPipelineFrame *frames[BATCH_SIZE];
+                for(uint8_t s = first; s < MaxWorkers; s = (uint8_t)(s + step))
+                    {
+                    const size_t n = queues[s].popBatch(frames, BATCH_SIZE);
+                    if(0 == n) { continue; }
+                    processBatch(s, frames, n);
+                    any = true;
+                    }
+                return(any);
+                }
+
+            // Records a frame queued for worker w, and wakes it if it is asleep or about to be.
+            void wakeWorker(const uint8_t w)
+                {
+                Sleeper &z = sleepers[w];
+                z.submitted.fetch_add(1, std::memory_order_seq_cst);
+                if(!z.sleeping.load(std::memory_order_seq_cst)) { return; }
+                    {
+                    std::lock_guard<std::mutex> guard(z.lock);
+                    z.sleeping.store(false, std::memory_order_relaxed);
+                    }
+                z.wake.notify_one();
+                }
+
+            // Worker w: serves shards w, w+nWorkers, ... until stopped and they are empty.
+            void runWorker(const uint8_t w, const uint8_t step)
+                {
+                Sleeper &z = sleepers[w];
+                uint16_t idle = 0;
+                for( ; ; )
+                    {
+                    // Any frame counted by now is visible to this poll.
+                    const uint32_t seen = z.submitted.load(std::memory_order_seq_cst);
+                    if(pollShards(w, step)) { idle = 0; continue; }
+                    if(!running.load(std::memory_order_acquire)) { return; }
+                    if(++idle < IDLE_SPINS) { std::this_thread::yield(); continue; }
+                    idle = 0;
+                    // Announce sleep, then check for frames counted since the poll:
+                    // either this sees one or its submitter sees sleeping and wakes this worker.
+                    z.sleeping.store(true, std::memory_order_seq_cst);
+                    if(z.submitted.load(std::memory_order_seq_cst) != seen) { z.sleeping.store(false, std::memory_order_relaxed); continue; }
+                    std::unique_lock<std::mutex> guard(z.lock);
+                    while(z.sleeping.load(std::memory_order_relaxed) && running.load(std::memory_order_acquire)) { z.wake.wait(guard); }
+                    z.sleeping.store(false, std::memory_order_relaxed);
+                    }
+                }
+
+        public:
+            // Construct a stopped pipeline; keyLookup and completion must not be NULL,
+            // and are passed arg on each call.
+            OTAES128GCMPipeline(const OTAES128GCMPipelineKeyLookup keyLookupFn,
+                                const OTAES128GCMPipelineCompletion completionFn, void *const cbArg)
+              : cache(), queues(), workers(), sleepers(), nWorkers(0), workerStep(1), running(false),
+                keyLookup(keyLookupFn), completion(completionFn), arg(cbArg)
+                { }
+
+            OTAES128GCMPipeline(const OTAES128GCMPipeline &) = delete;
+            OTAES128GCMPipeline &operator=(const OTAES128GCMPipeline &) = delete;
+
+            // Stops any workers, completing all frames already submitted.
+            ~OTAES128GCMPipeline() { stop(); }
+
+            /**
+             * @brief   starts n worker threads to process submitted frames.
+             * @param   n       number of workers, [1, MaxWorkers]; each serves MaxWorkers/n shards or so
+             * @param   pin     if true, pin worker i to CPU i modulo the number of CPUs where supported (Linux)
+             * @retval  true if started; false if n is out of range, already running, or a thread cannot be started
+             */
+            bool start(const uint8_t n, const bool pin = true)
+                {
+                if((0 == n) || (n > MaxWorkers) || (0 != nWorkers) || (NULL == keyLookup) || (NULL == completion)) { return(false); }
+                workerStep = n;
+                running.store(true, std::memory_order_release);
+                for(uint8_t w = 0; w < n; ++w)
+                    {
+                    try { workers[w] = std::thread(&OTAES128GCMPipeline::runWorker, this, w, n); }
+                    catch(...) { nWorkers = w; stop(); return(false); }
+#if defined(__linux__)
+                    if(pin)
+                        {
+                        const unsigned nCPUs = std::thread::hardware_concurrency();
+                        cpu_set_t cpus;
+                        CPU_ZERO(&cpus);
+                        CPU_SET((0 == nCPUs) ? 0 : (w % nCPUs), &cpus);
+                        // Best effort: an unpinned worker still works.
+                        (void)pthread_setaffinity_np(workers[w].native_handle(), sizeof(cpus), &cpus);
+                        }
+#else
+                    (void)pin;
+#endif
+                    }
+                nWorkers = n;
+                return(true);
+                }
+
+            // Stops accepting frames, waits for the workers to complete all frames already queued, and stops them.
+            // Call only once all submit() calls have returned; safe to call when stopped.
+            // The pipeline may then be started again; cached keyed contexts are kept until clearKeys().
+            void stop()
+                {
+                running.store(false, std::memory_order_release);
+                for(uint8_t w = 0; w < nWorkers; ++w)
+                    {
+                    // Take the lock so that a worker about to wait sees running cleared, or is woken.
+                        {
+                        std::lock_guard<std::mutex> guard(sleepers[w].lock);
+                        sleepers[w].sleeping.store(false, std::memory_order_relaxed);
+                        }
+                    sleepers[w].wake.notify_one();
+                    workers[w].join();
+                    }
+                nWorkers = 0;
+                // Anything left (eg if no workers started) is completed on this thread.
+                while(pollShards(0, 1)) { }
+                }
+
+            /**
+             * @brief   queues frame for its node's worker; safe to call from any number of threads while running.
+             * @param   frame   frame to open, owned by the caller until its completion callback; never NULL
+             * @retval  true if queued; false if frame is NULL, the pipeline is not running,
+             *          or the queue for the node is full (retry later or drop)
+             */
+            bool submit(OTAES128GCMPipelineFrame *const frame)
+                {
+                if((NULL == frame) || !running.load(std::memory_order_acquire)) { return(false); }
+                const uint8_t s = cache_t::shardFor(frame->nodeID);
+                if(!queues[s].tryPush(frame)) { return(false); }
+                wakeWorker((uint8_t)(s % workerStep));
+                return(true);
+                }
+
+            // True while running.
+            bool isRunning() const { return(running.load(std::memory_order_acquire)); }
+            // Number of workers running.
+            uint8_t workerCount() const { return(nWorkers); }
+
+            // Removes and wipes all cached keyed contexts, eg after key changes; only while stopped.
+            void clearKeys() { if(0 == nWorkers) { cache.clear(); } }
+        };
+
+
+    }
+
+#endif // OTAESGCM_THREADS
+
+#endif
@@ -0,0 +1,208 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/* OpenTRV OTAESGCM persistent worker threads for sealParallel()/openParallel(). */
+
+#ifndef ARDUINO_LIB_OTAESGCM_OTAESGCMTHREADPOOL_H
+#define ARDUINO_LIB_OTAESGCM_OTAESGCMTHREADPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "OTAESGCM_CPUFeatures.h"
+#include "OTAESGCM_OTAESGCM.h"
+
+// Hosted (multi-threaded) builds only.
+#ifdef OTAESGCM_THREADS
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+// Use namespaces to help avoid collisions.
+namespace OTAESGCM
+    {
+
+
+    // Caller-owned pool of worker threads, started once and reused by each
+    // OTAES128GCMKeyedBase::sealParallel()/openParallel() given it,
+    // so that a large message does not pay to start and join threads each time.
+    // Idle workers sleep until run() gives them tasks.
+    // Tasks are not assigned to threads: each worker (and the caller of run())
+    // takes the next unclaimed task until none is left, so a thread that starts late
+    // or runs slowly simply takes fewer.
+    // run() may be called from any number of threads; runs are done one at a time.
+    class OTAES128GCMThreadPool final
+        {
+        public:
+            // Most worker threads, as well as the caller of run(): no more than one message can use.
+            static constexpr uint8_t MAX_THREADS = OTAES128GCMKeyedBase::GCM_PARALLEL_MAX_THREADS - 1;
+            // One task: called once for each index in [0, nTasks) of a run().
+            typedef void (*Task)(void *arg, uint8_t index);
+
+        private:
+            std::thread workers[MAX_THREADS];
+            // Guards everything below, and wakes the workers and the caller of run().
+            std::mutex lock;
+            std::condition_variable work;
+            std::condition_variable finished;
+            // Serialises run() calls.
+            std::mutex runLock;
+            // The current run, if any.
+            Task task;
+            void *taskArg;
+            uint8_t nTasks;
+            // Next unclaimed task and number of tasks completed, of nTasks.
+            uint8_t nextTask;
+            uint8_t nDone;
+            // Workers started, [0, MAX_THREADS]; 0 when stopped.
+            uint8_t nWorkers;
+            // True while the workers should run.
+            bool running;
+
+            // Takes and does tasks until none are left unclaimed; called and returns with guard locked.
+            void takeTasks(std::unique_lock<std::mutex> &guard)
+                {
+                while(nextTask < nTasks)
+                    {
+                    const uint8_t i = nextTask++;
+                    const Task t = task;
+                    void *const a = taskArg;
+                    guard.unlock();
+                    t(a, i);
+                    guard.lock();
+                    if(++nDone == nTasks) { finished.notify_all(); }
+                    }
+                }
+
+            // Worker: sleeps until there are tasks, or the pool is stopped.
+            void runWorker()
+                {
+                std::unique_lock<std::mutex> guard(lock);
+                for( ; ; )
+                    {
+                    while(running && (nextTask >= nTasks)) { work.wait(guard); }
+                    if(!running) { return; }
+                    takeTasks(guard);
+                    }
+                }
+
+        public:
+            // Construct a stopped pool; run() then does all the work on its caller's thread.
+            OTAES128GCMThreadPool()
+              : workers(), task(NULL), taskArg(NULL), nTasks(0), nextTask(0), nDone(0), nWorkers(0), running(false)
+                { }
+
+            OTAES128GCMThreadPool(const OTAES128GCMThreadPool &) = delete;
+            OTAES128GCMThreadPool &operator=(const OTAES128GCMThreadPool &) = delete;
+
+            // Stops any workers.
+            ~OTAES128GCMThreadPool() { stop(); }
+
+            /**
+             * @brief   starts n worker threads.
+             * @param   n       number of workers, [1, MAX_THREADS]; eg one fewer than the cores to use
+             * @param   pin     if true, pin worker i to CPU i+1 modulo the number of CPUs where supported (Linux),
+             *                  leaving CPU 0 to the caller
+             * @retval  true if started; false if n is out of range, already running, or a thread cannot be started
+             */
+            bool start(const uint8_t n, const bool pin = true)
+                {
+                if((0 == n) || (n > MAX_THREADS) || (0 != nWorkers)) { return(false); }
+                    {
+                    std::lock_guard<std::mutex> guard(lock);
+                    running = true;
+                    }
+                for(uint8_t w = 0; w < n; ++w)
+                    {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+                    try { workers[w] = std::thread(&OTAES128GCMThreadPool::runWorker, this); }
+                    catch(...) { nWorkers = w; stop(); return(false); }
+#else
+                    workers[w] = std::thread(&OTAES128GCMThreadPool::runWorker, this);
+#endif
+#if defined(__linux__)
+                    if(pin)
+                        {
+                        const unsigned nCPUs = std::thread::hardware_concurrency();
+                        cpu_set_t cpus;
+                        CPU_ZERO(&cpus);
+                        CPU_SET((0 == nCPUs) ? 0 : ((w + 1U) % nCPUs), &cpus);
+                        // Best effort: an unpinned worker still works.
+                        (void)pthread_setaffinity_np(workers[w].native_handle(), sizeof(cpus), &cpus);
+                        }
+#else
+                    (void)pin;
+#endif
+                    }
+                nWorkers = n;
+                return(true);
+                }
+
+            // Stops and joins the workers; call only once all run() calls have returned.
+            // Safe to call when stopped; the pool may then be started again.
+            void stop()
+                {
+                    {
+                    std::lock_guard<std::mutex> guard(lock);
+                    running = false;
+                    }
+                work.notify_all();
+                for(uint8_t w = 0; w < nWorkers; ++w) { workers[w].join(); }
+                nWorkers = 0;
+                }
+
+            /**
+             * @brief   calls t(arg, i) once for each i in [0, n), on the workers and this thread,
+             *          returning once all have returned.
+             * @param   t       task; never NULL
+             * @param   arg     passed to each call of t
+             * @param   n       number of tasks
+             */
+            void run(const Task t, void *const arg, const uint8_t n)
+                {
+                std::lock_guard<std::mutex> serial(runLock);
+                std::unique_lock<std::mutex> guard(lock);
+                task = t;
+                taskArg = arg;
+                nTasks = n;
+                nextTask = 0;
+                nDone = 0;
+                work.notify_all();
+                takeTasks(guard);
+                while(nDone < nTasks) { finished.wait(guard); }
+                // Nothing left for a late worker to take.
+                nTasks = 0;
+                nextTask = 0;
+                }
+
+            // Number of workers running.
+            uint8_t workerCount() const { return(nWorkers); }
+        };
+
+
+    }
+
+#endif // OTAESGCM_THREADS
+
+#endif
@@ -0,0 +1,324 @@
+/*
+The OpenTRV project licenses this file to you
+under the Apache Licence, Version 2.0 (the "Licence");
+you may not use this file except in compliance
+with the Licence. You may obtain a copy of the Licence at
+
+http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing,
+software distributed under the Licence is distributed on an
+"AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+KIND, either express or implied. See the Licence for the
+specific language governing permissions and limitations
+under the Licence.
+
+Author(s) / Copyright (s): OpenTRV contributors 2026
+*/
+
+/*
+ * Portable C++ throughput benchmarks for this library.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <OTAESGCM.h>
+
+static const uint8_t key[16] = { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08 };
+static const uint8_t iv[12] = { 0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88 };
+static const uint8_t aad[20] = { 0 };
+
+// Message sizes from a single radio frame to well beyond L1 and L2.
+#define OTAESGCM_BENCH_SIZES ->Arg(64)->Arg(4 << 10)->Arg(256 << 10)->Arg(8 << 20)
+
+// One-shot encryption with the given AES engine, key expanded once.
+template<class AES>
+static void BM_SealLong(benchmark::State &state)
+{
+    const size_t len = (size_t)state.range(0);
+    std::vector<uint8_t> plain(len, 0x5a), cipher(len);
+    uint8_t tag[16];
+    OTAESGCM::OTAES128GCMKeyed<AES> ctx;
+    ctx.setKey(key);
+    for(auto _ : state)
+        {
+        ctx.sealLong(iv, &plain[0], len, aad, sizeof(aad), &cipher[0], tag);
+        benchmark::DoNotOptimize(tag);
+        }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)len);
+}
+BENCHMARK_TEMPLATE(BM_SealLong, OTAESGCM::OTAES128E_fast_t) OTAESGCM_BENCH_SIZES;
+BENCHMARK_TEMPLATE(BM_SealLong, OTAESGCM::OTAES128E_TTable) OTAESGCM_BENCH_SIZES;
+
+// One-shot encryption including key setup.
+template<class GCM>
+static void BM_SealOneShot(benchmark::State &state)
+{
+    const size_t len = (size_t)state.range(0);
+    std::vector<uint8_t> plain(len, 0x5a), cipher(len);
+    uint8_t tag[16];
+    GCM gcm;
+    for(auto _ : state)
+        {
+        gcm.gcmEncryptLong(key, iv, &plain[0], len, aad, sizeof(aad), &cipher[0], tag);
+        benchmark::DoNotOptimize(tag);
+        }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)len);
+}
+BENCHMARK_TEMPLATE(BM_SealOneShot, OTAESGCM::OTAES128GCMGeneric<>)->Arg(64)->Arg(4 << 10);
+
+// One-shot authenticated decryption with the given AES engine, key expanded once.
+template<class AES>
+static void BM_OpenLong(benchmark::State &state)
+{
+    const size_t len = (size_t)state.range(0);
+    std::vector<uint8_t> plain(len, 0x5a), cipher(len);
+    uint8_t tag[16];
+    OTAESGCM::OTAES128GCMKeyed<AES> ctx;
+    ctx.setKey(key);
+    ctx.sealLong(iv, &plain[0], len, aad, sizeof(aad), &cipher[0], tag);
+    for(auto _ : state)
+        {
+        benchmark::DoNotOptimize(ctx.openLong(iv, &cipher[0], len, aad, sizeof(aad), tag, &plain[0]));
+        }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)len);
+}
+BENCHMARK_TEMPLATE(BM_OpenLong, OTAESGCM::OTAES128E_fast_t) OTAESGCM_BENCH_SIZES;
+
+// Streaming decryption in 4kB chunks.
+static void BM_StreamDecrypt(benchmark::State &state)
+{
+    const size_t len = (size_t)state.range(0);
+    const size_t chunk = 4 << 10;
+    std::vector<uint8_t> buf(len, 0x5a);
+    uint8_t tag[16];
+    OTAESGCM::OTAES128GCMStream<OTAESGCM::OTAES128E_fast_t> gcm;
+    for(auto _ : state)
+        {
+        gcm.initDecrypt(key, iv);
+        gcm.updateAAD(aad, sizeof(aad));
+        for(size_t i = 0; i < len; i += chunk)
+            { gcm.update(&buf[i], (len - i < chunk) ? len - i : chunk, &buf[i]); }
+        gcm.finish(tag);
+        benchmark::DoNotOptimize(tag);
+        }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)len);
+}
+BENCHMARK(BM_StreamDecrypt) OTAESGCM_BENCH_SIZES;
+
+// The 32-byte OpenTRV frame shape: fixed-shape against generic, key set up each time.
+template<class AES>
+static void BM_Frame32Fixed(benchmark::State &state)
+{
+    uint8_t plain[32] = { 0 }, cipher[32], tag[16];
+    OTAESGCM::OTAES128GCMFixed<32, 32, 16, AES> i;
+    for(auto _ : state)
+        {
+        i.encrypt(key, iv, aad, sizeof(aad), plain, cipher, tag);
+        benchmark::DoNotOptimize(tag);
+        }
+}
+BENCHMARK_TEMPLATE(BM_Frame32Fixed, OTAESGCM::OTAES128E_default_t);
+BENCHMARK_TEMPLATE(BM_Frame32Fixed, OTAESGCM::OTAES128E_fast_t);
+template<class AES>
+static void BM_Frame32Generic(benchmark::State &state)
+{
+    uint8_t plain[32] = { 0 }, cipher[32], tag[16];
+    OTAESGCM::OTAES128GCMGeneric<AES> i;
+    for(auto _ : state)
+        {
+        i.gcmEncrypt(key, iv, plain, sizeof(plain), aad, sizeof(aad), cipher, tag);
+        benchmark::DoNotOptimize(tag);
+        }
+}
+BENCHMARK_TEMPLATE(BM_Frame32Generic, OTAESGCM::OTAES128E_default_t);
+BENCHMARK_TEMPLATE(BM_Frame32Generic, OTAESGCM::OTAES128E_fast_t);
+static void BM_Frame32Cached(benchmark::State &state)
+{
+    uint8_t plain[32] = { 0 }, cipher[32], tag[16];
+    OTAESGCM::OTAES128GCMBridgeState bridgeState;
+    for(auto _ : state)
+        {
+        OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED(&bridgeState, key, iv, aad, sizeof(aad), plain, cipher, tag);
+        benchmark::DoNotOptimize(tag);
+        }
+}
+BENCHMARK(BM_Frame32Cached);
+
+// Gateway receiving 32-byte frames from many nodes, each with its own key,
+// opening each through the per-node key cache or with full key setup per frame.
+static const size_t GATEWAY_NODES = 2048;
+static OTAESGCM::OTAES128GCMKeyCacheShard<GATEWAY_NODES> gatewayCache;
+static void BM_GatewayOpen(benchmark::State &state)
+{
+    const bool cached = (0 != state.range(0));
+    std::vector<uint8_t> keys(GATEWAY_NODES * 16), frames(GATEWAY_NODES * 48);
+    for(size_t n = 0; n < GATEWAY_NODES; ++n)
+        {
+        for(size_t i = 0; i < 16; ++i) { keys[n * 16 + i] = (uint8_t)(n * 7 + i * 13 + (n >> 8)); }
+        OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> ctx(&keys[n * 16]);
+        ctx.sealLong(iv, aad, 32, aad, sizeof(aad), &frames[n * 48], &frames[n * 48 + 32]);
+        }
+    gatewayCache.clear();
+    OTAESGCM::OTAES128GCMGeneric<OTAESGCM::OTAES128E_fast_t> gen;
+    uint8_t plain[32];
+    size_t n = 0;
+    for(auto _ : state)
+        {
+        n = (n + 617) % GATEWAY_NODES;
+        const uint8_t *const frame = &frames[n * 48];
+        if(!cached)
+            {
+            benchmark::DoNotOptimize(gen.gcmDecryptLong(&keys[n * 16], iv, frame, 32, aad, sizeof(aad), frame + 32, plain));
+            continue;
+            }
+        const OTAESGCM::OTAES128GCMKeyedBase *ctx = gatewayCache.find(n);
+        if(NULL == ctx) { ctx = gatewayCache.insert(n, &keys[n * 16]); }
+        benchmark::DoNotOptimize(ctx->openLong(iv, frame, 32, aad, sizeof(aad), frame + 32, plain));
+        }
+    gatewayCache.clear();
+}
+BENCHMARK(BM_GatewayOpen)->ArgName("cached")->Arg(0)->Arg(1);
+
+// Many short frames under one key or each under its own: one at a time, or batched.
+static void BM_SealFrames(benchmark::State &state)
+{
+    const size_t len = (size_t)state.range(0);
+    const size_t nFrames = 64;
+    std::vector<uint8_t> plain(len * nFrames, 0x5a), cipher(len * nFrames), tags(16 * nFrames);
+    const bool distinctKeys = (0 != state.range(2));
+    std::vector<OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t>> ctx(distinctKeys ? nFrames : 1);
+    for(size_t k = 0; k < ctx.size(); ++k)
+        {
+        uint8_t frameKey[16];
+        memcpy(frameKey, key, sizeof(frameKey));
+        frameKey[0] ^= (uint8_t)k;
+        ctx[k].setKey(frameKey);
+        }
+    std::vector<OTAESGCM::OTAES128GCMBatchFrame> frames(nFrames);
+    for(size_t i = 0; i < nFrames; ++i)
+        { frames[i] = { &ctx[distinctKeys ? i : 0], iv, aad, sizeof(aad), &plain[i * len], len, &cipher[i * len], &tags[i * 16], 16 }; }
+    uint8_t ok[nFrames / 8];
+    const bool batch = (0 != state.range(1));
+    for(auto _ : state)
+        {
+        if(batch) { benchmark::DoNotOptimize(OTAESGCM::OTAES128GCMKeyedBase::sealBatch(&frames[0], nFrames, ok)); }
+        else for(size_t i = 0; i < nFrames; ++i)
+            {
+            const OTAESGCM::OTAES128GCMBatchFrame &f = frames[i];
+            benchmark::DoNotOptimize(f.context->sealLong(f.IV, f.input, f.textLength, f.ADATA, f.ADATALength, f.output, f.tag));
+            }
+        }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)(len * nFrames));
+}
+BENCHMARK(BM_SealFrames)->ArgNames({"len", "batch", "keys"})->ArgsProduct({{16, 32, 64, 128}, {0, 1}, {0, 1}});
+
+#ifdef OTAESGCM_THREADS
+// One large message across a number of threads.
+static void BM_SealParallel(benchmark::State &state)
+{
+    const size_t len = (size_t)state.range(0);
+    const uint8_t nThreads = (uint8_t)state.range(1);
+    std::vector<uint8_t> plain(len, 0x5a), cipher(len);
+    uint8_t tag[16];
+    std::vector<OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t>> ctx(nThreads);
+    std::vector<const OTAESGCM::OTAES128GCMKeyedBase *> contexts;
+    for(auto &c : ctx) { c.setKey(key); contexts.push_back(&c); }
+    for(auto _ : state)
+        {
+        OTAESGCM::OTAES128GCMKeyedBase::sealParallel(&contexts[0], nThreads, iv, &plain[0], len, aad, sizeof(aad), &cipher[0], tag);
+        benchmark::DoNotOptimize(tag);
+        }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)len);
+}
+BENCHMARK(BM_SealParallel)->ArgNames({"len", "threads"})->ArgsProduct({{8 << 20}, {1, 2, 4, 8, 16}})->UseRealTime();
+
+// As BM_SealParallel, on a pool started once, with one context shared by all threads.
+static void BM_SealParallelPool(benchmark::State &state)
+{
+    const size_t len = (size_t)state.range(0);
+    const uint8_t nThreads = (uint8_t)state.range(1);
+    std::vector<uint8_t> plain(len, 0x5a), cipher(len);
+    uint8_t tag[16];
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> ctx(key);
+    const OTAESGCM::OTAES128GCMKeyedBase *const contexts[] = { &ctx };
+    OTAESGCM::OTAES128GCMThreadPool pool;
+    if(nThreads > 1) { pool.start((uint8_t)(nThreads - 1)); }
+    for(auto _ : state)
+        {
+        OTAESGCM::OTAES128GCMKeyedBase::sealParallel(&pool, contexts, 1, iv, &plain[0], len, aad, sizeof(aad), &cipher[0], tag);
+        benchmark::DoNotOptimize(tag);
+        }
+    state.SetBytesProcessed((int64_t)state.iterations() * (int64_t)len);
+}
+BENCHMARK(BM_SealParallelPool)->ArgNames({"len", "threads"})->ArgsProduct({{8 << 20}, {1, 2, 4, 8, 16}})->UseRealTime();
+
+// Gateway load: 32-byte frames from many nodes through the multi-core pipeline.
+static const size_t PIPELINE_NODES = 512;
+static const size_t PIPELINE_FRAMES = 4096;
+static std::atomic<size_t> pipelineDone;
+// Per-frame record: the frame, its receive time and its latency (ns).
+struct PipelineRecord
+    {
+    OTAESGCM::OTAES128GCMPipelineFrame frame;
+    uint8_t text[32], tag[16];
+    std::chrono::steady_clock::time_point received;
+    int64_t latency;
+    };
+static bool pipelineKeyLookup(const uint64_t nodeID, uint8_t *const keyOut, void *)
+    { for(size_t i = 0; i < 16; ++i) { keyOut[i] = (uint8_t)(nodeID * 7 + i * 13); } return(true); }
+static void pipelineCompletion(OTAESGCM::OTAES128GCMPipelineFrame *const frame, bool, void *)
+{
+    PipelineRecord *const r = (PipelineRecord *)frame->user;
+    r->latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - r->received).count();
+    pipelineDone.fetch_add(1, std::memory_order_release);
+}
+static OTAESGCM::OTAES128GCMPipeline<8, 1024, PIPELINE_NODES / 4> pipeline(pipelineKeyLookup, pipelineCompletion, NULL);
+static void BM_Pipeline(benchmark::State &state)
+{
+    const uint8_t nWorkers = (uint8_t)state.range(0);
+    std::vector<PipelineRecord> records(PIPELINE_FRAMES);
+    std::vector<uint8_t> sealed(PIPELINE_FRAMES * 32);
+    for(size_t i = 0; i < PIPELINE_FRAMES; ++i)
+        {
+        const uint64_t node = (i * 617) % PIPELINE_NODES;
+        uint8_t nodeKey[16];
+        pipelineKeyLookup(node, nodeKey, NULL);
+        OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> ctx(nodeKey);
+        PipelineRecord &r = records[i];
+        memset(r.text, (int)i, sizeof(r.text));
+        ctx.sealLong(iv, r.text, 32, aad, sizeof(aad), &sealed[i * 32], r.tag);
+        r.frame = { node, iv, aad, sizeof(aad), r.text, 32, r.text, r.tag, 16, &r };
+        }
+    if(!pipeline.start(nWorkers)) { state.SkipWithError("cannot start workers"); return; }
+    std::vector<int64_t> latencies;
+    for(auto _ : state)
+        {
+        state.PauseTiming();
+        for(size_t i = 0; i < PIPELINE_FRAMES; ++i) { memcpy(records[i].text, &sealed[i * 32], 32); }
+        pipelineDone.store(0);
+        state.ResumeTiming();
+        for(size_t i = 0; i < PIPELINE_FRAMES; ++i)
+            {
+            records[i].received = std::chrono::steady_clock::now();
+            while(!pipeline.submit(&records[i].frame)) { std::this_thread::yield(); }
+            }
+        while(pipelineDone.load(std::memory_order_acquire) < PIPELINE_FRAMES) { std::this_thread::yield(); }
+        for(const PipelineRecord &r : records) { latencies.push_back(r.latency); }
+        }
+    pipeline.stop();
+    pipeline.clearKeys();
+    std::sort(latencies.begin(), latencies.end());
+    state.counters["frames/s"] = benchmark::Counter((double)(state.iterations() * PIPELINE_FRAMES), benchmark::Counter::kIsRate);
+    state.counters["p99_us"] = latencies.empty() ? 0 : (double)latencies[latencies.size() * 99 / 100] / 1000;
+}
+BENCHMARK(BM_Pipeline)->ArgName("workers")->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime();
+#endif
+
+BENCHMARK_MAIN();
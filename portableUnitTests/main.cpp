@@ -21,8 +21,14 @@ Author(s) / Copyright (s): Damon Hart-Davis 2016
  */
 
 #include <stdint.h>
+#include <vector>
 #include <gtest/gtest.h>
 #include <OTAESGCM.h>
+#ifdef OTAESGCM_THREADS
+#include <atomic>
+#include <chrono>
+#include <thread>
+#endif
 
 
 // Sanity test.
@@ -42,6 +48,205 @@ static const int GCM_TAG_LENGTH = 16; // in bytes (default 16, 12 possible)
 // A const all-zeros block useful for keys, nonce, plaintext, etc.
 static const uint8_t allZerosBlock[32] = { };
 
+// Check keyed AES block API against NIST SP 800-38A ECB-AES128 vectors.
+// The key is expanded once and used for several blocks, then wiped.
+TEST(Main,AES128KeyedECB)
+{
+    static const uint8_t key[AES_KEY_SIZE/8] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    static const uint8_t plain[2][16] = {
+        { 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a },
+        { 0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51 } };
+    static const uint8_t cipher[2][16] = {
+        { 0x3a, 0xd7, 0x7b, 0xb4, 0x0d, 0x7a, 0x36, 0x60, 0xa8, 0x9e, 0xca, 0xf3, 0x24, 0x66, 0xef, 0x97 },
+        { 0xf5, 0xd3, 0xd5, 0x85, 0x03, 0xb9, 0x69, 0x9d, 0xe7, 0x85, 0x89, 0x5a, 0x96, 0xfd, 0xba, 0xaf } };
+    uint8_t workspace[OTAESGCM::OTAES128DE_default_t::workspaceRequired];
+    OTAESGCM::OTAES128DE_default_t aes(workspace, sizeof(workspace));
+    uint8_t out[16];
+    // One-shot.
+    aes.blockEncrypt(plain[0], key, out);
+    ASSERT_EQ(0, memcmp(cipher[0], out, 16));
+    // Keyed, several blocks per key setup.
+    aes.setKey(key);
+    for(int i = 0; i < 2; ++i)
+        {
+        aes.blockEncryptKeyed(plain[i], out);
+        ASSERT_EQ(0, memcmp(cipher[i], out, 16));
+        aes.blockDecryptKeyed(cipher[i], out);
+        ASSERT_EQ(0, memcmp(plain[i], out, 16));
+        }
+    // In place.
+    memcpy(out, plain[1], 16);
+    aes.blockEncryptKeyed(out, out);
+    ASSERT_EQ(0, memcmp(cipher[1], out, 16));
+    // Explicit wipe clears the schedule.
+    aes.clearKey();
+    for(int i = sizeof(workspace); --i >= 0; ) { ASSERT_EQ(0, workspace[i]); }
+    // A NULL key is rejected, dropping the previous key: keyed operations then do nothing.
+    aes.setKey(key);
+    aes.setKey(NULL);
+    for(int i = sizeof(workspace); --i >= 0; ) { ASSERT_EQ(0, workspace[i]); }
+    memcpy(out, plain[0], 16);
+    aes.blockEncryptKeyed(out, out);
+    ASSERT_EQ(0, memcmp(plain[0], out, 16));
+}
+
+// Check that the fast and small AES implementations agree, encrypting and decrypting,
+// over a spread of keys and blocks, and that each wipes its workspace.
+TEST(Main,AES128FastMatchesSmall)
+{
+    uint8_t fastWorkspace[OTAESGCM::OTAES128DE_fast_t::workspaceRequired];
+    uint8_t smallWorkspace[OTAESGCM::OTAES128DE_small_t::workspaceRequired];
+    OTAESGCM::OTAES128DE_fast_t fast(fastWorkspace, sizeof(fastWorkspace));
+    OTAESGCM::OTAES128DE_small_t small(smallWorkspace, sizeof(smallWorkspace));
+    uint8_t key[16], block[16], outFast[16], outSmall[16];
+    for(int k = 0; k < 16; ++k)
+        {
+        for(int i = 0; i < 16; ++i) { key[i] = (uint8_t)(k * 37 + i * 101 + (k << i)); }
+        fast.setKey(key);
+        small.setKey(key);
+        for(int b = 0; b < 16; ++b)
+            {
+            for(int i = 0; i < 16; ++i) { block[i] = (uint8_t)(b * 59 + i * 13 + k); }
+            fast.blockEncryptKeyed(block, outFast);
+            small.blockEncryptKeyed(block, outSmall);
+            ASSERT_EQ(0, memcmp(outFast, outSmall, 16));
+            fast.blockDecryptKeyed(outFast, outFast);
+            ASSERT_EQ(0, memcmp(block, outFast, 16));
+            }
+        fast.clearKey();
+        small.clearKey();
+        for(int i = sizeof(fastWorkspace); --i >= 0; ) { ASSERT_EQ(0, fastWorkspace[i]); }
+        }
+    // With only the encryption workspace the decryptor still encrypts, but will not decrypt.
+    uint8_t encWorkspace[OTAESGCM::OTAES128E_fast_t::workspaceRequired];
+    OTAESGCM::OTAES128DE_fast_t encOnly(encWorkspace, sizeof(encWorkspace));
+    encOnly.setKey(key);
+    small.setKey(key);
+    encOnly.blockEncryptKeyed(block, outFast);
+    small.blockEncryptKeyed(block, outSmall);
+    ASSERT_EQ(0, memcmp(outFast, outSmall, 16));
+    encOnly.blockDecryptKeyed(outSmall, outFast);
+    ASSERT_EQ(0, memcmp(outFast, outSmall, 16));
+    encOnly.clearKey();
+    small.clearKey();
+}
+
+#ifdef OTAESGCM_X86_INTRINSICS
+// Check the AES-NI implementation, and its forced portable fallback, against the small implementation,
+// including multi-block counter mode across 8-block batches and a 32-bit counter wrap.
+TEST(Main,AES128AESNIMatchesSmall)
+{
+    uint8_t smallWorkspace[OTAESGCM::OTAES128DE_small_t::workspaceRequired];
+    OTAESGCM::OTAES128DE_small_t small(smallWorkspace, sizeof(smallWorkspace));
+    for(int allow = 0; allow < 2; ++allow)
+        {
+        uint8_t workspace[OTAESGCM::OTAES128DE_AESNI::workspaceRequired];
+        OTAESGCM::OTAES128DE_AESNI aesni(workspace, sizeof(workspace), 0 != allow);
+        if(allow) { ASSERT_EQ(OTAESGCM::cpuHasAESNI(), aesni.isUsingAESNI()); }
+        else { ASSERT_FALSE(aesni.isUsingAESNI()); }
+        uint8_t key[16];
+        for(int i = 0; i < 16; ++i) { key[i] = (uint8_t)(i * 17 + 3); }
+        aesni.setKey(key);
+        small.setKey(key);
+        // Single blocks, enc and dec.
+        uint8_t block[16], out1[16], out2[16];
+        for(int i = 0; i < 16; ++i) { block[i] = (uint8_t)(i * 29); }
+        aesni.blockEncryptKeyed(block, out1);
+        small.blockEncryptKeyed(block, out2);
+        ASSERT_EQ(0, memcmp(out1, out2, 16));
+        aesni.blockDecryptKeyed(out1, out1);
+        ASSERT_EQ(0, memcmp(block, out1, 16));
+        // Counter mode: 19 blocks starting just below the 32-bit counter wrap.
+        const int nBlocks = 19;
+        uint8_t in[nBlocks * 16], ctOut1[nBlocks * 16], ctOut2[nBlocks * 16];
+        for(int i = 0; i < (int)sizeof(in); ++i) { in[i] = (uint8_t)(i * 7); }
+        uint8_t ctr1[16], ctr2[16];
+        memset(ctr1, 0xa5, sizeof(ctr1));
+        ctr1[12] = 0xff; ctr1[13] = 0xff; ctr1[14] = 0xff; ctr1[15] = 0xf7;
+        memcpy(ctr2, ctr1, sizeof(ctr1));
+        aesni.ctr32EncryptKeyed(ctr1, in, ctOut1, nBlocks);
+        small.ctr32EncryptKeyed(ctr2, in, ctOut2, nBlocks);
+        ASSERT_EQ(0, memcmp(ctOut1, ctOut2, sizeof(ctOut1)));
+        ASSERT_EQ(0, memcmp(ctr1, ctr2, sizeof(ctr1)));
+        ASSERT_EQ(0x0a, ctr1[15]);
+        // In place.
+        memcpy(ctOut1, in, sizeof(in));
+        memset(ctr1 + 12, 0, 4);
+        memcpy(ctr2, ctr1, sizeof(ctr1));
+        aesni.ctr32EncryptKeyed(ctr1, ctOut1, ctOut1, nBlocks);
+        small.ctr32EncryptKeyed(ctr2, in, ctOut2, nBlocks);
+        ASSERT_EQ(0, memcmp(ctOut1, ctOut2, sizeof(ctOut1)));
+        aesni.clearKey();
+        small.clearKey();
+        for(int i = sizeof(workspace); --i >= 0; ) { ASSERT_EQ(0, workspace[i]); }
+        }
+}
+
+// Check the PCLMULQDQ GHASH against the portable multiplier,
+// across whole 8-block batches, remainders and a final partial block,
+// and with only some of the powers of H precomputed.
+TEST(Main,GHASHCLMULMatchesPortable)
+{
+    uint8_t H[16];
+    for(int i = 0; i < 16; ++i) { H[i] = (uint8_t)(i * 37 + 11); }
+    OTAESGCM::GHASHKey accel, accel3, portable;
+    accel.init(H);
+    accel3.init(H, true, false, 3);
+    portable.init(H, false);
+    ASSERT_EQ(OTAESGCM::cpuHasPCLMUL(), accel.useCLMUL);
+    ASSERT_FALSE(portable.useCLMUL);
+    uint8_t in[40 * 16 + 7];
+    for(int i = 0; i < (int)sizeof(in); ++i) { in[i] = (uint8_t)(i * 13 + (i >> 5)); }
+    for(size_t len = 0; len <= sizeof(in); len += 5)
+        {
+        uint8_t y1[16], y2[16], y3[16];
+        memset(y1, 0x3c, sizeof(y1));
+        memcpy(y2, y1, sizeof(y1));
+        memcpy(y3, y1, sizeof(y1));
+        OTAESGCM::GHASH(in, len, &accel, y1);
+        OTAESGCM::GHASH(in, len, &portable, y2);
+        OTAESGCM::GHASH(in, len, &accel3, y3);
+        ASSERT_EQ(0, memcmp(y1, y2, sizeof(y1))) << len;
+        ASSERT_EQ(0, memcmp(y3, y2, sizeof(y3))) << len;
+        }
+    accel3.clear();
+    accel.clear();
+    ASSERT_FALSE(accel.useCLMUL);
+    for(int i = 0; i < 16; ++i) { ASSERT_EQ(0, accel.H[i]); }
+}
+#endif
+
+// Check GCMVS vectors and padding with the fast AES implementation.
+TEST(Main,GCMVSFastAES)
+{
+    static const uint8_t input[32] = { 0xcc, 0x38, 0xbc, 0xcd, 0x6b, 0xc5, 0x36, 0xad, 0x91, 0x9b, 0x13, 0x95, 0xf5, 0xd6, 0x38, 0x01, 0xf9, 0x9f, 0x80, 0x68, 0xd6, 0x5c, 0xa5, 0xac, 0x63, 0x87, 0x2d, 0xaf, 0x16, 0xb9, 0x39, 0x01 };
+    static const uint8_t key[AES_KEY_SIZE/8] = { 0x29, 0x8e, 0xfa, 0x1c, 0xcf, 0x29, 0xcf, 0x62, 0xae, 0x68, 0x24, 0xbf, 0xc1, 0x95, 0x57, 0xfc };
+    static const uint8_t nonce[GCM_NONCE_LENGTH] = { 0x6f, 0x58, 0xa9, 0x3f, 0xe1, 0xd2, 0x07, 0xfa, 0xe4, 0xed, 0x2f, 0x6d };
+    static const uint8_t aad[16] = { 0x02, 0x1f, 0xaf, 0xd2, 0x38, 0x46, 0x39, 0x73, 0xff, 0xe8, 0x02, 0x56, 0xe5, 0xb1, 0xc6, 0xb1 };
+    uint8_t tag[GCM_TAG_LENGTH];
+    uint8_t cipherText[32];
+    OTAESGCM::OTAES128GCMGeneric<OTAESGCM::OTAES128E_fast_t> gen;
+    ASSERT_TRUE(gen.gcmEncrypt(key, nonce, input, sizeof(input), aad, sizeof(aad), cipherText, tag));
+    ASSERT_EQ(0xdf, cipherText[0]);
+    ASSERT_EQ(0xce, cipherText[1]);
+    ASSERT_EQ(0xdb, cipherText[31]);
+    ASSERT_EQ(0x54, tag[0]);
+    ASSERT_EQ(0xf2, tag[15]);
+    uint8_t plain[32];
+    ASSERT_TRUE(gen.gcmDecrypt(key, nonce, cipherText, sizeof(cipherText), aad, sizeof(aad), tag, plain));
+    ASSERT_EQ(0, memcmp(input, plain, sizeof(input)));
+    // Padding case from AESGCMPadding.
+    uint8_t padIn[9];
+    memset(padIn, 0x55, sizeof(padIn));
+    uint8_t padOut[16];
+    memset(padOut, 0, sizeof(padOut));
+    ASSERT_TRUE(gen.gcmEncrypt(allZerosBlock, allZerosBlock, padIn, sizeof(padIn), allZerosBlock, 4, padOut, tag));
+    ASSERT_EQ(0x56, padOut[0]);
+    ASSERT_EQ(0xa6, padOut[8]);
+    ASSERT_EQ(0x9b, tag[0]);
+    ASSERT_EQ(0x75, tag[15]);
+}
+
 // Check that all zeros key, plaintext and ADATA gives the correct result.
 //
 // DHD20161107: copied from test.ino testAESGCMAll0().
@@ -458,6 +663,1044 @@ TEST(Main,GCMVS1ViaFixed32BTextSizeWITHWORKSPACE)
             inputDecoded));
 }
 
+// Check GHASH with each available multiplier against GCM spec test case 2:
+// H = E(0^128, 0^128), one ciphertext block and the length block.
+TEST(Main,GHASHKnownAnswer)
+{
+    static const uint8_t H[16] = { 0x66, 0xe9, 0x4b, 0xd4, 0xef, 0x8a, 0x2c, 0x3b, 0x88, 0x4c, 0xfa, 0x59, 0xca, 0x34, 0x2b, 0x2e };
+    static const uint8_t in[32] = { 0x03, 0x88, 0xda, 0xce, 0x60, 0xb6, 0xa3, 0x92, 0xf3, 0x28, 0xc2, 0xb9, 0x71, 0xb2, 0xfe, 0x78,
+                                    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x80 };
+    static const uint8_t expected[16] = { 0xf3, 0x8c, 0xbb, 0x1a, 0xd6, 0x92, 0x23, 0xdc, 0xc3, 0x45, 0x7a, 0xe5, 0xb6, 0xb0, 0xf8, 0x85 };
+    uint8_t table[OTAESGCM::GHASH_TABLE4_SIZE];
+    for(int m = 0; m < 3; ++m)
+        {
+        OTAESGCM::GHASHKey hk((2 == m) ? table : NULL);
+        // Force the table multiplier where ctmul64 would otherwise be used.
+        hk.init(H, 0 == m, 2 == m);
+        ASSERT_EQ(2 == m, hk.useTable4) << m;
+        uint8_t y[16];
+        memset(y, 0, sizeof(y));
+        OTAESGCM::GHASH(in, sizeof(in), &hk, y);
+        ASSERT_EQ(0, memcmp(expected, y, sizeof(y))) << m;
+        hk.clear();
+        }
+}
+
+// Check the 4-bit table GHASH (forced even where ctmul64 is available) against the portable multiplier,
+// and GCM with the table in the caller-supplied workspace.
+TEST(Main,GHASHTable4)
+{
+    uint8_t H[16];
+    for(int i = 0; i < 16; ++i) { H[i] = (uint8_t)(i * 53 + 7); }
+    uint8_t table[OTAESGCM::GHASH_TABLE4_SIZE];
+    OTAESGCM::GHASHKey tabled(table), portable;
+    tabled.init(H, false, true);
+    portable.init(H, false);
+    ASSERT_TRUE(tabled.useTable4);
+    ASSERT_FALSE(portable.useTable4);
+    uint8_t in[5 * 16 + 9];
+    for(int i = 0; i < (int)sizeof(in); ++i) { in[i] = (uint8_t)(i * 31 + 1); }
+    for(size_t len = 0; len <= sizeof(in); len += 3)
+        {
+        uint8_t y1[16], y2[16];
+        memset(y1, 0xc3, sizeof(y1));
+        memcpy(y2, y1, sizeof(y1));
+        OTAESGCM::GHASH(in, len, &tabled, y1);
+        OTAESGCM::GHASH(in, len, &portable, y2);
+        ASSERT_EQ(0, memcmp(y1, y2, sizeof(y1))) << len;
+        }
+    tabled.clear();
+    for(int i = sizeof(table); --i >= 0; ) { ASSERT_EQ(0, table[i]); }
+    // GCMVS vector with a workspace big enough for the table.
+    static const uint8_t input[32] = { 0xcc, 0x38, 0xbc, 0xcd, 0x6b, 0xc5, 0x36, 0xad, 0x91, 0x9b, 0x13, 0x95, 0xf5, 0xd6, 0x38, 0x01, 0xf9, 0x9f, 0x80, 0x68, 0xd6, 0x5c, 0xa5, 0xac, 0x63, 0x87, 0x2d, 0xaf, 0x16, 0xb9, 0x39, 0x01 };
+    static const uint8_t key[AES_KEY_SIZE/8] = { 0x29, 0x8e, 0xfa, 0x1c, 0xcf, 0x29, 0xcf, 0x62, 0xae, 0x68, 0x24, 0xbf, 0xc1, 0x95, 0x57, 0xfc };
+    static const uint8_t nonce[GCM_NONCE_LENGTH] = { 0x6f, 0x58, 0xa9, 0x3f, 0xe1, 0xd2, 0x07, 0xfa, 0xe4, 0xed, 0x2f, 0x6d };
+    static const uint8_t aad[16] = { 0x02, 0x1f, 0xaf, 0xd2, 0x38, 0x46, 0x39, 0x73, 0xff, 0xe8, 0x02, 0x56, 0xe5, 0xb1, 0xc6, 0xb1 };
+    constexpr size_t workspaceSize = OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceWithGHASHTable;
+    uint8_t workspace[workspaceSize];
+    uint8_t tag[GCM_TAG_LENGTH];
+    uint8_t cipherText[32];
+    ASSERT_TRUE(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(
+            workspace, workspaceSize, key, nonce, aad, sizeof(aad), input, cipherText, tag));
+    for(int i = workspaceSize; --i >= 0; ) { ASSERT_EQ(0, workspace[i]); }
+    ASSERT_EQ(0xdf, cipherText[0]);
+    ASSERT_EQ(0xdb, cipherText[31]);
+    ASSERT_EQ(0x54, tag[0]);
+    ASSERT_EQ(0xf2, tag[15]);
+    uint8_t inputDecoded[32];
+    ASSERT_TRUE(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE(
+            workspace, workspaceSize, key, nonce, aad, sizeof(aad), cipherText, tag, inputDecoded));
+    for(int i = workspaceSize; --i >= 0; ) { ASSERT_EQ(0, workspace[i]); }
+    ASSERT_EQ(0, memcmp(input, inputDecoded, 32));
+}
+
+// Check keyed context using NIST GCMVS test vector, for several messages per key.
+//
+//Key = 298efa1ccf29cf62ae6824bfc19557fc
+//IV = 6f58a93fe1d207fae4ed2f6d
+//PT = cc38bccd6bc536ad919b1395f5d63801f99f8068d65ca5ac63872daf16b93901
+//AAD = 021fafd238463973ffe80256e5b1c6b1
+//CT = dfce4e9cd291103d7fe4e63351d9e79d3dfd391e3267104658212da96521b7db
+//Tag = 542465ef599316f73a7a560509a2d9f2
+TEST(Main,GCMVS1Keyed)
+{
+    static const uint8_t input[32] = { 0xcc, 0x38, 0xbc, 0xcd, 0x6b, 0xc5, 0x36, 0xad, 0x91, 0x9b, 0x13, 0x95, 0xf5, 0xd6, 0x38, 0x01, 0xf9, 0x9f, 0x80, 0x68, 0xd6, 0x5c, 0xa5, 0xac, 0x63, 0x87, 0x2d, 0xaf, 0x16, 0xb9, 0x39, 0x01 };
+    static const uint8_t key[AES_KEY_SIZE/8] = { 0x29, 0x8e, 0xfa, 0x1c, 0xcf, 0x29, 0xcf, 0x62, 0xae, 0x68, 0x24, 0xbf, 0xc1, 0x95, 0x57, 0xfc };
+    static const uint8_t nonce[GCM_NONCE_LENGTH] = { 0x6f, 0x58, 0xa9, 0x3f, 0xe1, 0xd2, 0x07, 0xfa, 0xe4, 0xed, 0x2f, 0x6d };
+    static const uint8_t aad[16] = { 0x02, 0x1f, 0xaf, 0xd2, 0x38, 0x46, 0x39, 0x73, 0xff, 0xe8, 0x02, 0x56, 0xe5, 0xb1, 0xc6, 0xb1 };
+    uint8_t tag[GCM_TAG_LENGTH];
+    uint8_t cipherText[32];
+    uint8_t plain[32];
+    OTAESGCM::OTAES128GCMKeyed<> ctx;
+    // Unkeyed context refuses to work.
+    ASSERT_FALSE(ctx.isKeyed());
+    ASSERT_FALSE(ctx.seal(nonce, input, sizeof(input), aad, sizeof(aad), cipherText, tag));
+    ASSERT_TRUE(ctx.setKey(key));
+    ASSERT_TRUE(ctx.isKeyed());
+    // Repeated use of the same key state gives the same correct result.
+    for(int i = 0; i < 3; ++i)
+        {
+        ASSERT_TRUE(ctx.seal(nonce, input, sizeof(input), aad, sizeof(aad), cipherText, tag));
+        ASSERT_EQ(0xdf, cipherText[0]);
+        ASSERT_EQ(0xdb, cipherText[31]);
+        ASSERT_EQ(0x54, tag[0]);
+        ASSERT_EQ(0xf2, tag[15]);
+        ASSERT_TRUE(ctx.open(nonce, cipherText, sizeof(cipherText), aad, sizeof(aad), tag, plain));
+        ASSERT_EQ(0, memcmp(input, plain, sizeof(input)));
+        }
+    // Results must match the one-shot API.
+    // (Padding bytes of the ciphertext buffer are covered by the tag, so start both zeroed.)
+    uint8_t tag2[GCM_TAG_LENGTH];
+    uint8_t cipherText2[32];
+    memset(cipherText, 0, sizeof(cipherText));
+    memset(cipherText2, 0, sizeof(cipherText2));
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    ASSERT_TRUE(gen.gcmEncrypt(key, nonce, input, 30, aad, 3, cipherText2, tag2));
+    ASSERT_TRUE(ctx.seal(nonce, input, 30, aad, 3, cipherText, tag));
+    ASSERT_EQ(0, memcmp(cipherText, cipherText2, 30));
+    ASSERT_EQ(0, memcmp(tag, tag2, sizeof(tag)));
+    // Tampering is detected.
+    tag[3] ^= 1;
+    ASSERT_FALSE(ctx.open(nonce, cipherText, sizeof(cipherText), aad, 3, tag, plain));
+    // Rekeying to a different key gives different output; clearing prevents use.
+    ASSERT_TRUE(ctx.setKey(allZerosBlock));
+    ASSERT_TRUE(ctx.seal(nonce, input, sizeof(input), aad, sizeof(aad), cipherText, tag));
+    ASSERT_NE(0x54, tag[0]);
+    ctx.clearKey();
+    ASSERT_FALSE(ctx.isKeyed());
+    ASSERT_FALSE(ctx.open(nonce, cipherText, sizeof(cipherText), aad, sizeof(aad), tag, plain));
+    ASSERT_FALSE(ctx.setKey(NULL));
+}
+
+// GCM spec (McGrew & Viega) test case 4: 60-byte plaintext and 20-byte AAD,
+// ie standard GCM on exact (non-block-multiple) lengths.
+static const uint8_t tc4Key[16] = { 0xfe, 0xff, 0xe9, 0x92, 0x86, 0x65, 0x73, 0x1c, 0x6d, 0x6a, 0x8f, 0x94, 0x67, 0x30, 0x83, 0x08 };
+static const uint8_t tc4IV[12] = { 0xca, 0xfe, 0xba, 0xbe, 0xfa, 0xce, 0xdb, 0xad, 0xde, 0xca, 0xf8, 0x88 };
+static const uint8_t tc4Plain[60] = {
+    0xd9, 0x31, 0x32, 0x25, 0xf8, 0x84, 0x06, 0xe5, 0xa5, 0x59, 0x09, 0xc5, 0xaf, 0xf5, 0x26, 0x9a,
+    0x86, 0xa7, 0xa9, 0x53, 0x15, 0x34, 0xf7, 0xda, 0x2e, 0x4c, 0x30, 0x3d, 0x8a, 0x31, 0x8a, 0x72,
+    0x1c, 0x3c, 0x0c, 0x95, 0x95, 0x68, 0x09, 0x53, 0x2f, 0xcf, 0x0e, 0x24, 0x49, 0xa6, 0xb5, 0x25,
+    0xb1, 0x6a, 0xed, 0xf5, 0xaa, 0x0d, 0xe6, 0x57, 0xba, 0x63, 0x7b, 0x39 };
+static const uint8_t tc4AAD[20] = {
+    0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef, 0xfe, 0xed, 0xfa, 0xce, 0xde, 0xad, 0xbe, 0xef,
+    0xab, 0xad, 0xda, 0xd2 };
+static const uint8_t tc4Cipher[60] = {
+    0x42, 0x83, 0x1e, 0xc2, 0x21, 0x77, 0x74, 0x24, 0x4b, 0x72, 0x21, 0xb7, 0x84, 0xd0, 0xd4, 0x9c,
+    0xe3, 0xaa, 0x21, 0x2f, 0x2c, 0x02, 0xa4, 0xe0, 0x35, 0xc1, 0x7e, 0x23, 0x29, 0xac, 0xa1, 0x2e,
+    0x21, 0xd5, 0x14, 0xb2, 0x54, 0x66, 0x93, 0x1c, 0x7d, 0x8f, 0x6a, 0x5a, 0xac, 0x84, 0xaa, 0x05,
+    0x1b, 0xa3, 0x0b, 0x39, 0x6a, 0x0a, 0xac, 0x97, 0x3d, 0x58, 0xe0, 0x91 };
+static const uint8_t tc4Tag[16] = { 0x5b, 0xc9, 0x4f, 0xbc, 0x32, 0x21, 0xa5, 0xdb, 0x94, 0xfa, 0xe9, 0x5a, 0xe7, 0x12, 0x1a, 0x47 };
+
+// Check the streaming API against test case 4 with a variety of chunk sizes,
+// in and out of place, and that a bad tag or misuse is rejected.
+TEST(Main,GCMStream)
+{
+    OTAESGCM::OTAES128GCMStream<OTAESGCM::OTAES128E_fast_t> gcm;
+    static const size_t chunks[] = { 1, 3, 7, 16, 17, 60 };
+    for(size_t c = 0; c < sizeof(chunks)/sizeof(chunks[0]); ++c)
+        {
+        const size_t chunk = chunks[c];
+        // Encrypt.
+        uint8_t out[60], tag[16];
+        ASSERT_TRUE(gcm.initEncrypt(tc4Key, tc4IV));
+        for(size_t i = 0; i < sizeof(tc4AAD); i += chunk)
+            { ASSERT_TRUE(gcm.updateAAD(tc4AAD + i, fnmin(chunk, sizeof(tc4AAD) - i))); }
+        for(size_t i = 0; i < sizeof(tc4Plain); i += chunk)
+            { ASSERT_TRUE(gcm.update(tc4Plain + i, fnmin(chunk, sizeof(tc4Plain) - i), out + i)); }
+        ASSERT_TRUE(gcm.finish(tag));
+        ASSERT_EQ(0, memcmp(tc4Cipher, out, sizeof(out))) << chunk;
+        ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag))) << chunk;
+        // Decrypt in place.
+        ASSERT_TRUE(gcm.initDecrypt(tc4Key, tc4IV));
+        ASSERT_TRUE(gcm.updateAAD(tc4AAD, sizeof(tc4AAD)));
+        for(size_t i = 0; i < sizeof(out); i += chunk)
+            { ASSERT_TRUE(gcm.update(out + i, fnmin(chunk, sizeof(out) - i), out + i)); }
+        ASSERT_TRUE(gcm.verify(tc4Tag));
+        ASSERT_EQ(0, memcmp(tc4Plain, out, sizeof(out))) << chunk;
+        }
+    // Bad tag.
+    uint8_t out[60], tag[16];
+    memcpy(tag, tc4Tag, sizeof(tag));
+    tag[15] ^= 1;
+    ASSERT_TRUE(gcm.initDecrypt(tc4Key, tc4IV));
+    ASSERT_TRUE(gcm.updateAAD(tc4AAD, sizeof(tc4AAD)));
+    ASSERT_TRUE(gcm.update(tc4Cipher, sizeof(tc4Cipher), out));
+    ASSERT_FALSE(gcm.verify(tag));
+    // Misuse: not initialised, AAD after text, wrong completion.
+    ASSERT_FALSE(gcm.update(tc4Plain, sizeof(tc4Plain), out));
+    ASSERT_FALSE(gcm.finish(tag));
+    ASSERT_TRUE(gcm.initEncrypt(tc4Key, tc4IV));
+    ASSERT_TRUE(gcm.update(tc4Plain, 1, out));
+    ASSERT_FALSE(gcm.updateAAD(tc4AAD, sizeof(tc4AAD)));
+    ASSERT_FALSE(gcm.verify(tc4Tag));
+    gcm.clear();
+    ASSERT_FALSE(gcm.finish(tag));
+    // AAD only (GMAC) and empty message, against the one-shot tag for AAD only.
+    uint8_t tag1[16], tag2[16], unused[16];
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    ASSERT_TRUE(gen.gcmEncrypt(tc4Key, tc4IV, NULL, 0, tc4AAD, 16, unused, tag1));
+    ASSERT_TRUE(gcm.initEncrypt(tc4Key, tc4IV));
+    ASSERT_TRUE(gcm.updateAAD(tc4AAD, 16));
+    ASSERT_TRUE(gcm.finish(tag2));
+    ASSERT_EQ(0, memcmp(tag1, tag2, sizeof(tag1)));
+}
+
+// Check that a message failing authentication leaves the output buffer untouched,
+// for the one-shot, keyed and long forms.
+TEST(Main,GCMDecryptRejectsWithoutWriting)
+{
+    uint8_t cipher[64], tag[16], out[64];
+    memset(cipher, 0, sizeof(cipher));
+    memcpy(cipher, tc4Cipher, sizeof(tc4Cipher));
+    memcpy(tag, tc4Tag, sizeof(tag));
+    tag[0] ^= 0x80;
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    memset(out, 0xa5, sizeof(out));
+    ASSERT_FALSE(gen.gcmDecrypt(tc4Key, tc4IV, cipher, sizeof(cipher), tc4AAD, sizeof(tc4AAD), tag, out));
+    for(size_t i = 0; i < sizeof(out); ++i) { ASSERT_EQ(0xa5, out[i]); }
+    ASSERT_FALSE(gen.gcmDecryptLong(tc4Key, tc4IV, cipher, sizeof(tc4Cipher), tc4AAD, sizeof(tc4AAD), tag, out));
+    for(size_t i = 0; i < sizeof(out); ++i) { ASSERT_EQ(0xa5, out[i]); }
+    OTAESGCM::OTAES128GCMKeyed<> ctx;
+    ASSERT_TRUE(ctx.setKey(tc4Key));
+    ASSERT_FALSE(ctx.open(tc4IV, cipher, sizeof(cipher), tc4AAD, sizeof(tc4AAD), tag, out));
+    for(size_t i = 0; i < sizeof(out); ++i) { ASSERT_EQ(0xa5, out[i]); }
+    // The genuine tag still decrypts, in place.
+    ASSERT_TRUE(ctx.openLong(tc4IV, cipher, sizeof(tc4Cipher), tc4AAD, sizeof(tc4AAD), tc4Tag, cipher));
+    ASSERT_EQ(0, memcmp(tc4Plain, cipher, sizeof(tc4Plain)));
+}
+
+// Check in-place encryption and decryption on a single frame buffer against test case 4:
+// header (AAD) then a gap, the body, and the tag slot.
+TEST(Main,GCMInPlaceFrame)
+{
+    const uint8_t bodyOffset = sizeof(tc4AAD) + 2;
+    const uint8_t tagOffset = bodyOffset + sizeof(tc4Plain);
+    uint8_t frame[tagOffset + 16 + 1];
+    memset(frame, 0xee, sizeof(frame));
+    memcpy(frame, tc4AAD, sizeof(tc4AAD));
+    memcpy(frame + bodyOffset, tc4Plain, sizeof(tc4Plain));
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    ASSERT_TRUE(gen.gcmEncryptInPlace(tc4Key, tc4IV, frame, sizeof(frame), sizeof(tc4AAD), bodyOffset, sizeof(tc4Plain), tagOffset));
+    ASSERT_EQ(0, memcmp(tc4AAD, frame, sizeof(tc4AAD)));
+    ASSERT_EQ(0xee, frame[sizeof(tc4AAD)]);
+    ASSERT_EQ(0, memcmp(tc4Cipher, frame + bodyOffset, sizeof(tc4Cipher)));
+    ASSERT_EQ(0, memcmp(tc4Tag, frame + tagOffset, sizeof(tc4Tag)));
+    ASSERT_EQ(0xee, frame[sizeof(frame) - 1]);
+    // Decrypt where it lies, with the keyed context.
+    OTAESGCM::OTAES128GCMKeyed<> ctx;
+    ASSERT_TRUE(ctx.setKey(tc4Key));
+    ASSERT_TRUE(ctx.openInPlace(tc4IV, frame, sizeof(frame), sizeof(tc4AAD), bodyOffset, sizeof(tc4Plain), tagOffset));
+    ASSERT_EQ(0, memcmp(tc4Plain, frame + bodyOffset, sizeof(tc4Plain)));
+    ASSERT_TRUE(ctx.sealInPlace(tc4IV, frame, sizeof(frame), sizeof(tc4AAD), bodyOffset, sizeof(tc4Plain), tagOffset));
+    ASSERT_EQ(0, memcmp(tc4Cipher, frame + bodyOffset, sizeof(tc4Cipher)));
+    // A corrupted header is rejected and the frame left untouched.
+    frame[0] ^= 1;
+    uint8_t copy[sizeof(frame)];
+    memcpy(copy, frame, sizeof(frame));
+    ASSERT_FALSE(gen.gcmDecryptInPlace(tc4Key, tc4IV, frame, sizeof(frame), sizeof(tc4AAD), bodyOffset, sizeof(tc4Plain), tagOffset));
+    ASSERT_EQ(0, memcmp(copy, frame, sizeof(frame)));
+    // Bad layouts: overlapping regions or running off the end.
+    ASSERT_FALSE(ctx.sealInPlace(tc4IV, frame, sizeof(frame), sizeof(tc4AAD), sizeof(tc4AAD) - 1, sizeof(tc4Plain), tagOffset));
+    ASSERT_FALSE(ctx.sealInPlace(tc4IV, frame, sizeof(frame), sizeof(tc4AAD), bodyOffset, sizeof(tc4Plain), tagOffset - 1));
+    ASSERT_FALSE(ctx.sealInPlace(tc4IV, frame, sizeof(frame), sizeof(tc4AAD), bodyOffset, sizeof(tc4Plain), sizeof(tc4AAD) - 1));
+    ASSERT_FALSE(ctx.sealInPlace(tc4IV, frame, sizeof(frame) - 2, sizeof(tc4AAD), bodyOffset, sizeof(tc4Plain), tagOffset));
+    ASSERT_FALSE(ctx.sealInPlace(tc4IV, frame, sizeof(frame), 0, bodyOffset, 0, tagOffset));
+    ASSERT_EQ(0, memcmp(copy, frame, sizeof(frame)));
+    // The tag slot may precede the body.
+    ASSERT_TRUE(ctx.sealInPlace(tc4IV, frame, sizeof(frame), sizeof(tc4AAD), sizeof(tc4AAD) + 16, 16, sizeof(tc4AAD)));
+}
+
+// Check the variable-size (exact-length) bridges against test case 4,
+// on a short odd-sized frame, and for interoperation with the fixed32B... bridges.
+TEST(Main,GCMVarTextSizeBridges)
+{
+    uint8_t out[60], tag[16], back[60];
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, sizeof(tc4Plain), out, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, out, sizeof(out)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    constexpr size_t workspaceRequired = OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequired;
+    uint8_t workspace[workspaceRequired];
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleDec_DEFAULT_WITH_WORKSPACE(workspace, sizeof(workspace),
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Cipher, sizeof(tc4Cipher), tc4Tag, back));
+    ASSERT_EQ(0, memcmp(tc4Plain, back, sizeof(back)));
+    for(size_t i = 0; i < sizeof(workspace); ++i) { ASSERT_EQ(0, workspace[i]); }
+    // A 5-byte frame yields 5 bytes of ciphertext, the prefix of the longer one's.
+    uint8_t shortOut[5], shortBack[5];
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(workspace, sizeof(workspace),
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, sizeof(shortOut), shortOut, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, shortOut, sizeof(shortOut)));
+    memset(shortBack, 0xa5, sizeof(shortBack));
+    tag[3] ^= 4;
+    ASSERT_FALSE(OTAESGCM::varTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), shortOut, sizeof(shortOut), tag, shortBack));
+    for(size_t i = 0; i < sizeof(shortBack); ++i) { ASSERT_EQ(0xa5, shortBack[i]); }
+    tag[3] ^= 4;
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), shortOut, sizeof(shortOut), tag, shortBack));
+    ASSERT_EQ(0, memcmp(tc4Plain, shortBack, sizeof(shortBack)));
+    // 32-byte frames are identical either way.
+    uint8_t fixedOut[32], fixedTag[16];
+    ASSERT_TRUE(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, fixedOut, fixedTag));
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, 32, out, tag));
+    ASSERT_EQ(0, memcmp(fixedOut, out, 32));
+    ASSERT_EQ(0, memcmp(fixedTag, tag, sizeof(tag)));
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleDec_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), fixedOut, 32, fixedTag, back));
+    ASSERT_EQ(0, memcmp(tc4Plain, back, 32));
+    // Parameter checks.
+    ASSERT_FALSE(OTAESGCM::varTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, NULL, 0, NULL, 0, out, tag));
+    ASSERT_FALSE(OTAESGCM::varTextSize12BNonce16BTagSimpleEnc_DEFAULT_WITH_WORKSPACE(workspace, sizeof(workspace) - 1,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, 5, out, tag));
+}
+
+// Check the cached-key bridges match the stateless ones through the same function pointer type,
+// across key changes, and reject a NULL state.
+TEST(Main,GCMCachedBridges)
+{
+    typedef bool (*enc_t)(void *, const uint8_t *, const uint8_t *, const uint8_t *, uint8_t, const uint8_t *, uint8_t *, uint8_t *);
+    typedef bool (*dec_t)(void *, const uint8_t *, const uint8_t *, const uint8_t *, uint8_t, const uint8_t *, const uint8_t *, uint8_t *);
+    const enc_t encStateless = OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS;
+    const enc_t encCached = OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED;
+    const dec_t decCached = OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleDec_DEFAULT_CACHED;
+    OTAESGCM::OTAES128GCMBridgeState state;
+    uint8_t key2[16];
+    memcpy(key2, tc4Key, sizeof(key2));
+    key2[0] ^= 1;
+    uint8_t out[32], tag[16], out2[32], tag2[16], back[32];
+    // Alternate keys, with the same key for consecutive frames.
+    const uint8_t *const keys[] = { tc4Key, tc4Key, key2, key2, tc4Key };
+    for(size_t k = 0; k < sizeof(keys)/sizeof(keys[0]); ++k)
+        {
+        ASSERT_TRUE(encStateless(NULL, keys[k], tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag));
+        ASSERT_TRUE(encCached(&state, keys[k], tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out2, tag2));
+        ASSERT_EQ(0, memcmp(out, out2, sizeof(out)));
+        ASSERT_EQ(0, memcmp(tag, tag2, sizeof(tag)));
+        ASSERT_TRUE(decCached(&state, keys[k], tc4IV, tc4AAD, sizeof(tc4AAD), out, tag, back));
+        ASSERT_EQ(0, memcmp(tc4Plain, back, sizeof(back)));
+        }
+    // Authenticate-only, and the wrong key.
+    ASSERT_TRUE(encStateless(NULL, tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), NULL, out, tag));
+    ASSERT_TRUE(encCached(&state, tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), NULL, out2, tag2));
+    ASSERT_EQ(0, memcmp(tag, tag2, sizeof(tag)));
+    ASSERT_TRUE(decCached(&state, tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), NULL, tag, back));
+    ASSERT_FALSE(decCached(&state, key2, tc4IV, tc4AAD, sizeof(tc4AAD), NULL, tag, back));
+    // Variable size.
+    uint8_t varOut[60];
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleEnc_DEFAULT_CACHED(&state,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, sizeof(tc4Plain), varOut, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, varOut, sizeof(varOut)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    ASSERT_TRUE(OTAESGCM::varTextSize12BNonce16BTagSimpleDec_DEFAULT_CACHED(&state,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Cipher, sizeof(tc4Cipher), tc4Tag, varOut));
+    ASSERT_EQ(0, memcmp(tc4Plain, varOut, sizeof(varOut)));
+    // No state.
+    ASSERT_FALSE(encCached(NULL, tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag));
+    state.clear();
+    ASSERT_TRUE(encCached(&state, tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out2, tag2));
+}
+
+// Check the per-node key cache: lookups, CLOCK eviction keeping recently used nodes,
+// removal, and index integrity under churn.
+TEST(Main,GCMKeyCache)
+{
+    uint8_t keys[8][16];
+    for(uint8_t n = 0; n < 8; ++n) { memcpy(keys[n], tc4Key, 16); keys[n][0] = n; }
+    uint8_t out[60], tag[16], expected[60], expectedTag[16];
+    OTAESGCM::OTAES128GCMKeyCacheShard<4> cache;
+    for(uint8_t n = 1; n <= 4; ++n) { ASSERT_TRUE(NULL != cache.insert(n, keys[n])); }
+    ASSERT_EQ(4, cache.size());
+    for(uint8_t n = 1; n <= 4; ++n)
+        {
+        const OTAESGCM::OTAES128GCMKeyedBase *const ctx = cache.find(n);
+        ASSERT_TRUE(NULL != ctx);
+        ASSERT_TRUE(ctx->sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), out, tag));
+        OTAESGCM::OTAES128GCMKeyed<> direct(keys[n]);
+        ASSERT_TRUE(direct.sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), expected, expectedTag));
+        ASSERT_EQ(0, memcmp(expected, out, sizeof(out)));
+        ASSERT_EQ(0, memcmp(expectedTag, tag, sizeof(tag)));
+        }
+    // All now referenced; use 1 and 2 again after the hand passes, so 3 goes.
+    ASSERT_TRUE(NULL != cache.insert(5, keys[5]));
+    ASSERT_EQ(4, cache.size());
+    ASSERT_TRUE(NULL == cache.find(1));
+    ASSERT_TRUE(NULL != cache.find(2));
+    ASSERT_TRUE(NULL != cache.insert(6, keys[6]));
+    ASSERT_TRUE(NULL != cache.find(2));
+    ASSERT_TRUE(NULL == cache.find(3));
+    // Rekeying in place, and removal.
+    ASSERT_TRUE(NULL != cache.insert(2, keys[7]));
+    ASSERT_TRUE(cache.find(2)->sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), out, tag));
+    OTAESGCM::OTAES128GCMKeyed<> direct7(keys[7]);
+    ASSERT_TRUE(direct7.sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), expected, expectedTag));
+    ASSERT_EQ(0, memcmp(expectedTag, tag, sizeof(tag)));
+    ASSERT_TRUE(cache.remove(2));
+    ASSERT_FALSE(cache.remove(2));
+    ASSERT_TRUE(NULL == cache.find(2));
+    ASSERT_EQ(3, cache.size());
+    ASSERT_TRUE(NULL == cache.insert(9, NULL));
+    cache.clear();
+    ASSERT_EQ(0, cache.size());
+    ASSERT_TRUE(NULL == cache.find(5));
+
+    // Churn through many nodes, with some removals: everything counted must be findable.
+    static OTAESGCM::OTAES128GCMKeyCacheShard<32> big;
+    uint64_t id = 1;
+    for(int i = 0; i < 2000; ++i)
+        {
+        id = id * 6364136223846793005ULL + 1442695040888963407ULL;
+        const uint64_t node = id >> 54; // Repeats, so some hits.
+        if(NULL == big.find(node)) { ASSERT_TRUE(NULL != big.insert(node, keys[node & 7])); }
+        if(0 == (i % 7)) { big.remove((id >> 40) & 1023); }
+        }
+    uint16_t found = 0;
+    for(uint64_t node = 0; node < 1024; ++node) { if(NULL != big.find(node)) { ++found; } }
+    ASSERT_EQ(big.size(), found);
+    ASSERT_TRUE(found <= 32);
+
+    // Shard choice is stable and in range.
+    typedef OTAESGCM::OTAES128GCMShardedKeyCache<3, 4> sharded_t;
+    static sharded_t sharded;
+    for(uint64_t node = 0; node < 100; ++node)
+        {
+        const uint8_t s = sharded_t::shardFor(node);
+        ASSERT_TRUE(s < 3);
+        ASSERT_EQ(s, sharded_t::shardFor(node));
+        }
+    ASSERT_TRUE(NULL != sharded.shard(sharded_t::shardFor(42)).insert(42, keys[1]));
+    ASSERT_TRUE(NULL != sharded.shard(sharded_t::shardFor(42)).find(42));
+    sharded.clear();
+    ASSERT_TRUE(NULL == sharded.shard(sharded_t::shardFor(42)).find(42));
+}
+
+// Check GMAC (authenticate-only) against the GCM tag with no plaintext,
+// with the one-shot (with and without GHASH table) and keyed forms.
+TEST(Main,GMAC)
+{
+    uint8_t expected[16], tag[16], unused[16];
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    ASSERT_TRUE(gen.gcmEncrypt(tc4Key, tc4IV, NULL, 0, tc4AAD, sizeof(tc4AAD), unused, expected));
+    ASSERT_TRUE(gen.gmacCompute(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tag));
+    ASSERT_EQ(0, memcmp(expected, tag, sizeof(tag)));
+    ASSERT_TRUE(gen.gmacVerify(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), expected));
+    typedef OTAESGCM::OTAES128GCMGenericWithWorkspace<> wt;
+    uint8_t workspace[wt::workspaceWithGHASHTable];
+    wt genT(workspace, sizeof(workspace));
+    memset(tag, 0, sizeof(tag));
+    ASSERT_TRUE(genT.gmacCompute(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tag));
+    ASSERT_EQ(0, memcmp(expected, tag, sizeof(tag)));
+    OTAESGCM::OTAES128GCMKeyed<> ctx;
+    ASSERT_FALSE(ctx.gmacCompute(tc4IV, tc4AAD, sizeof(tc4AAD), tag));
+    ASSERT_TRUE(ctx.setKey(tc4Key));
+    memset(tag, 0, sizeof(tag));
+    ASSERT_TRUE(ctx.gmacCompute(tc4IV, tc4AAD, sizeof(tc4AAD), tag));
+    ASSERT_EQ(0, memcmp(expected, tag, sizeof(tag)));
+    ASSERT_TRUE(ctx.gmacVerify(tc4IV, tc4AAD, sizeof(tc4AAD), tag));
+    // Any change to the data, IV or tag is rejected.
+    uint8_t aad[sizeof(tc4AAD)];
+    memcpy(aad, tc4AAD, sizeof(aad));
+    aad[7] ^= 0x10;
+    ASSERT_FALSE(ctx.gmacVerify(tc4IV, aad, sizeof(aad), tag));
+    ASSERT_FALSE(ctx.gmacVerify(tc4IV, tc4AAD, sizeof(tc4AAD) - 1, tag));
+    ASSERT_FALSE(ctx.gmacVerify(tc4Key, tc4AAD, sizeof(tc4AAD), tag));
+    tag[15] ^= 1;
+    ASSERT_FALSE(gen.gmacVerify(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tag));
+    // Nothing to authenticate.
+    ASSERT_FALSE(ctx.gmacCompute(tc4IV, tc4AAD, 0, tag));
+    ASSERT_FALSE(ctx.gmacCompute(tc4IV, NULL, 1, tag));
+}
+
+// Check truncated tags against test case 4: each is a prefix of the full tag,
+// checked only over its length, and disallowed lengths are rejected.
+TEST(Main,GCMTruncatedTags)
+{
+    static const uint8_t tagLengths[] = { 4, 8, 12, 13, 16 };
+    OTAESGCM::OTAES128GCMKeyed<> ctx;
+    ASSERT_TRUE(ctx.setKey(tc4Key));
+    for(size_t t = 0; t < sizeof(tagLengths); ++t)
+        {
+        const uint8_t tagLength = tagLengths[t];
+        uint8_t out[60], tag[17];
+        memset(tag, 0xee, sizeof(tag));
+        ASSERT_TRUE(ctx.sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), out, tag, tagLength));
+        ASSERT_EQ(0, memcmp(tc4Cipher, out, sizeof(out)));
+        ASSERT_EQ(0, memcmp(tc4Tag, tag, tagLength)) << (int)tagLength;
+        ASSERT_EQ(0xee, tag[tagLength]);
+        ASSERT_TRUE(ctx.openLong(tc4IV, tc4Cipher, sizeof(tc4Cipher), tc4AAD, sizeof(tc4AAD), tc4Tag, out, tagLength));
+        ASSERT_EQ(0, memcmp(tc4Plain, out, sizeof(out)));
+        tag[tagLength - 1] ^= 1;
+        ASSERT_FALSE(ctx.openLong(tc4IV, tc4Cipher, sizeof(tc4Cipher), tc4AAD, sizeof(tc4AAD), tag, out, tagLength));
+        }
+    uint8_t out[60], tag[16];
+    static const uint8_t badLengths[] = { 0, 1, 5, 9, 11, 17 };
+    for(size_t t = 0; t < sizeof(badLengths); ++t)
+        {
+        ASSERT_FALSE(OTAESGCM::isValidGCMTagLength(badLengths[t]));
+        ASSERT_FALSE(ctx.sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), out, tag, badLengths[t]));
+        ASSERT_FALSE(ctx.openLong(tc4IV, tc4Cipher, sizeof(tc4Cipher), tc4AAD, sizeof(tc4AAD), tc4Tag, out, badLengths[t]));
+        }
+    // An 8-byte tag slot at the end of an in-place frame.
+    uint8_t frame[sizeof(tc4AAD) + sizeof(tc4Plain) + 8];
+    memcpy(frame, tc4AAD, sizeof(tc4AAD));
+    memcpy(frame + sizeof(tc4AAD), tc4Plain, sizeof(tc4Plain));
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    ASSERT_TRUE(gen.gcmEncryptInPlace(tc4Key, tc4IV, frame, sizeof(frame), sizeof(tc4AAD), sizeof(tc4AAD), sizeof(tc4Plain), sizeof(tc4AAD) + sizeof(tc4Plain), 8));
+    ASSERT_EQ(0, memcmp(tc4Tag, frame + sizeof(tc4AAD) + sizeof(tc4Plain), 8));
+    ASSERT_FALSE(gen.gcmEncryptInPlace(tc4Key, tc4IV, frame, sizeof(frame), sizeof(tc4AAD), sizeof(tc4AAD), sizeof(tc4Plain), sizeof(tc4AAD) + sizeof(tc4Plain)));
+    ASSERT_TRUE(ctx.openInPlace(tc4IV, frame, sizeof(frame), sizeof(tc4AAD), sizeof(tc4AAD), sizeof(tc4Plain), sizeof(tc4AAD) + sizeof(tc4Plain), 8));
+    ASSERT_EQ(0, memcmp(tc4Plain, frame + sizeof(tc4AAD), sizeof(tc4Plain)));
+    // Templated fixed-size bridges.
+    uint8_t tag8[8];
+    ASSERT_TRUE((OTAESGCM::fixedTextSize12BNonceTagSimpleEnc_DEFAULT_STATELESS<60, 8>(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag8)));
+    ASSERT_EQ(0, memcmp(tc4Cipher, out, sizeof(out)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag8, sizeof(tag8)));
+    constexpr size_t workspaceRequired = OTAESGCM::OTAES128GCMGenericWithWorkspace<>::workspaceRequired;
+    uint8_t workspace[workspaceRequired];
+    ASSERT_TRUE((OTAESGCM::fixedTextSize12BNonceTagSimpleDec_DEFAULT_WITH_WORKSPACE<60, 8>(workspace, sizeof(workspace),
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Cipher, tag8, out)));
+    ASSERT_EQ(0, memcmp(tc4Plain, out, sizeof(out)));
+    for(size_t i = 0; i < sizeof(workspace); ++i) { ASSERT_EQ(0, workspace[i]); }
+    tag8[0] ^= 0x80;
+    ASSERT_FALSE((OTAESGCM::fixedTextSize12BNonceTagSimpleDec_DEFAULT_STATELESS<60, 8>(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Cipher, tag8, out)));
+    // With 32 bytes of text and a full tag, the same as the fixed32B... bridge.
+    uint8_t fixedOut[32], fixedTag[16];
+    ASSERT_TRUE(OTAESGCM::fixed32BTextSize12BNonce16BTagSimpleEnc_DEFAULT_STATELESS(NULL,
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, fixedOut, fixedTag));
+    ASSERT_TRUE((OTAESGCM::fixedTextSize12BNonceTagSimpleEnc_DEFAULT_WITH_WORKSPACE<32, 16>(workspace, sizeof(workspace),
+            tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag)));
+    ASSERT_EQ(0, memcmp(fixedOut, out, sizeof(fixedOut)));
+    ASSERT_EQ(0, memcmp(fixedTag, tag, sizeof(fixedTag)));
+}
+
+// Check that batched seal/open matches sealLong()/openLong() frame by frame,
+// across two keys, assorted lengths, a long frame and bad frames.
+TEST(Main,GCMBatch)
+{
+    static const uint8_t key2[16] = { 0x10, 0x32, 0x54, 0x76, 0x98, 0xba, 0xdc, 0xfe, 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef };
+    OTAESGCM::OTAES128GCMKeyed<> ctx1(tc4Key), ctx2(key2);
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_TTable> ctxT(key2);
+    static const size_t textLengths[] = { 60, 0, 16, 1, 33, 1000, 60, 17, 31, 5, 48, 2 };
+    const size_t nFrames = sizeof(textLengths) / sizeof(textLengths[0]);
+    static uint8_t plain[nFrames][1000], cipher[nFrames][1000], expected[nFrames][1000], tags[nFrames][16], expectedTags[nFrames][16], ivs[nFrames][12];
+    OTAESGCM::OTAES128GCMBatchFrame frames[nFrames];
+    for(size_t i = 0; i < nFrames; ++i)
+        {
+        for(size_t j = 0; j < sizeof(plain[i]); ++j) { plain[i][j] = (uint8_t)(i * 31 + j); }
+        memcpy(ivs[i], tc4IV, 12);
+        ivs[i][0] = (uint8_t)i;
+        const OTAESGCM::OTAES128GCMKeyedBase *ctx = &ctxT;
+        if(i < 8) { ctx = (i < 4) ? &ctx1 : &ctx2; }
+        const uint8_t tagLength = (i == 7) ? 8 : 16;
+        frames[i] = { ctx, ivs[i], tc4AAD, (i % 3) ? sizeof(tc4AAD) : 0, plain[i], textLengths[i], cipher[i], tags[i], tagLength };
+        }
+    // Frame 1 has neither text nor AAD; frame 9 has a bad tag length.
+    frames[1].ADATALength = 0;
+    frames[9].tagLength = 3;
+    for(size_t i = 0; i < nFrames; ++i)
+        {
+        const OTAESGCM::OTAES128GCMBatchFrame &f = frames[i];
+        const bool ok = f.context->sealLong(f.IV, f.input, f.textLength, f.ADATA, f.ADATALength, expected[i], expectedTags[i], f.tagLength);
+        ASSERT_EQ((i != 1) && (i != 9), ok) << i;
+        }
+
+    uint8_t ok[2];
+    ASSERT_EQ(nFrames - 2, OTAESGCM::OTAES128GCMKeyedBase::sealBatch(frames, nFrames, ok));
+    ASSERT_EQ(0xfd, ok[0]);
+    ASSERT_EQ(0x0d, ok[1]);
+    for(size_t i = 0; i < nFrames; ++i)
+        {
+        if((i == 1) || (i == 9)) { continue; }
+        ASSERT_EQ(0, memcmp(expected[i], cipher[i], textLengths[i])) << i;
+        ASSERT_EQ(0, memcmp(expectedTags[i], tags[i], frames[i].tagLength)) << i;
+        }
+
+    // Open in place, with a short and a long frame tampered; they must be left as ciphertext.
+    for(size_t i = 0; i < nFrames; ++i) { frames[i].input = cipher[i]; frames[i].output = cipher[i]; }
+    cipher[2][3] ^= 1;
+    cipher[5][999] ^= 1;
+    ASSERT_EQ(nFrames - 4, OTAESGCM::OTAES128GCMKeyedBase::openBatch(frames, nFrames, ok));
+    ASSERT_EQ(0xd9, ok[0]);
+    ASSERT_EQ(0x0d, ok[1]);
+    ASSERT_EQ(0, memcmp(expected[2] + 4, cipher[2] + 4, textLengths[2] - 4));
+    ASSERT_EQ(0, memcmp(expected[5], cipher[5], textLengths[5] - 1));
+    for(size_t i = 0; i < nFrames; ++i)
+        {
+        if((i == 1) || (i == 2) || (i == 5) || (i == 9)) { continue; }
+        ASSERT_EQ(0, memcmp(plain[i], cipher[i], textLengths[i])) << i;
+        }
+    ASSERT_EQ(0, OTAESGCM::OTAES128GCMKeyedBase::openBatch(NULL, nFrames, ok));
+
+    // Short frames each under a different key, the later ones mixing engines, so that their blocks are batched across keys.
+    const size_t nKeyed = 24;
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> ctxs[nKeyed];
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_TTable> ctxsT[nKeyed];
+    static uint8_t keyedCipher[nKeyed][200], keyedPlain[nKeyed][200], keyedTags[nKeyed][16];
+    OTAESGCM::OTAES128GCMBatchFrame keyed[nKeyed];
+    for(size_t i = 0; i < nKeyed; ++i)
+        {
+        uint8_t key[16];
+        memcpy(key, key2, sizeof(key));
+        key[15] = (uint8_t)i;
+        ASSERT_TRUE(ctxs[i].setKey(key));
+        ASSERT_TRUE(ctxsT[i].setKey(key));
+        const OTAESGCM::OTAES128GCMKeyedBase *ctx = ((i < 16) || (i % 3)) ? (const OTAESGCM::OTAES128GCMKeyedBase *)&ctxs[i] : &ctxsT[i];
+        keyed[i] = { ctx, ivs[i % nFrames], tc4AAD, i % sizeof(tc4AAD), plain[i % nFrames], (i * 13 + 1) % 200, keyedCipher[i], keyedTags[i], 16 };
+        }
+    uint8_t okKeyed[3];
+    ASSERT_EQ(nKeyed, OTAESGCM::OTAES128GCMKeyedBase::sealBatch(keyed, nKeyed, okKeyed));
+    for(size_t i = 0; i < nKeyed; ++i)
+        {
+        const OTAESGCM::OTAES128GCMBatchFrame &f = keyed[i];
+        uint8_t out[200], tag[16];
+        ASSERT_TRUE(f.context->sealLong(f.IV, f.input, f.textLength, f.ADATA, f.ADATALength, out, tag)) << i;
+        ASSERT_EQ(0, memcmp(out, f.output, f.textLength)) << i;
+        ASSERT_EQ(0, memcmp(tag, f.tag, 16)) << i;
+        keyed[i].input = keyedCipher[i];
+        keyed[i].output = keyedPlain[i];
+        }
+    ASSERT_EQ(nKeyed, OTAESGCM::OTAES128GCMKeyedBase::openBatch(keyed, nKeyed, okKeyed));
+    for(size_t i = 0; i < nKeyed; ++i) { ASSERT_EQ(0, memcmp(plain[i % nFrames], keyedPlain[i], keyed[i].textLength)) << i; }
+}
+
+// Check the exact-length (size_t) entry points against test case 4,
+// and a large message against the streaming API.
+TEST(Main,GCMLongLengths)
+{
+    OTAESGCM::OTAES128GCMGeneric<OTAESGCM::OTAES128E_fast_t> gen;
+    uint8_t out[60], tag[16];
+    ASSERT_TRUE(gen.gcmEncryptLong(tc4Key, tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), out, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, out, sizeof(out)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    ASSERT_TRUE(gen.gcmDecryptLong(tc4Key, tc4IV, tc4Cipher, sizeof(tc4Cipher), tc4AAD, sizeof(tc4AAD), tc4Tag, out));
+    ASSERT_EQ(0, memcmp(tc4Plain, out, sizeof(out)));
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> ctx;
+    ASSERT_FALSE(ctx.sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), out, tag));
+    ASSERT_TRUE(ctx.setKey(tc4Key));
+    ASSERT_TRUE(ctx.sealLong(tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), out, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, out, sizeof(out)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    ASSERT_TRUE(ctx.openLong(tc4IV, tc4Cipher, sizeof(tc4Cipher), tc4AAD, sizeof(tc4AAD), tc4Tag, out));
+    ASSERT_EQ(0, memcmp(tc4Plain, out, sizeof(out)));
+    // Parameter and limit checks.
+    ASSERT_FALSE(gen.gcmEncryptLong(tc4Key, tc4IV, NULL, 0, NULL, 0, out, tag));
+    ASSERT_FALSE(gen.gcmEncryptLong(tc4Key, tc4IV, NULL, sizeof(tc4Plain), NULL, 0, out, tag));
+    if(sizeof(size_t) > 4)
+        { ASSERT_FALSE(gen.gcmEncryptLong(tc4Key, tc4IV, tc4Plain, (size_t)(((uint64_t)1) << 36), NULL, 0, out, tag)); }
+
+    // Large message, well past 255 bytes and not a whole number of blocks.
+    const size_t len = 100000 + 7;
+    std::vector<uint8_t> plain(len), cipher(len), back(len), streamed(len);
+    for(size_t i = 0; i < len; ++i) { plain[i] = (uint8_t)(i * 31 + (i >> 8)); }
+    ASSERT_TRUE(ctx.sealLong(tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+    OTAESGCM::OTAES128GCMStream<OTAESGCM::OTAES128E_fast_t> gcm;
+    uint8_t tag2[16];
+    ASSERT_TRUE(gcm.initEncrypt(tc4Key, tc4IV));
+    ASSERT_TRUE(gcm.updateAAD(tc4AAD, sizeof(tc4AAD)));
+    ASSERT_TRUE(gcm.update(&plain[0], len, &streamed[0]));
+    ASSERT_TRUE(gcm.finish(tag2));
+    ASSERT_TRUE(cipher == streamed);
+    ASSERT_EQ(0, memcmp(tag, tag2, sizeof(tag)));
+    ASSERT_TRUE(gen.gcmDecryptLong(tc4Key, tc4IV, &cipher[0], len, tc4AAD, sizeof(tc4AAD), tag, &back[0]));
+    ASSERT_TRUE(plain == back);
+    // The portable engine (not stitched) agrees.
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_TTable> ctxT;
+    ASSERT_TRUE(ctxT.setKey(tc4Key));
+    ASSERT_TRUE(ctxT.sealLong(tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &streamed[0], tag2));
+    ASSERT_TRUE(cipher == streamed);
+    ASSERT_EQ(0, memcmp(tag, tag2, sizeof(tag)));
+    // Streaming decryption in place, in odd-sized chunks.
+    ASSERT_TRUE(gcm.initDecrypt(tc4Key, tc4IV));
+    ASSERT_TRUE(gcm.updateAAD(tc4AAD, sizeof(tc4AAD)));
+    for(size_t i = 0; i < len; i += 1000)
+        { ASSERT_TRUE(gcm.update(&streamed[i], fnmin((size_t)1000, len - i), &streamed[i])); }
+    ASSERT_TRUE(gcm.verify(tag));
+    ASSERT_TRUE(plain == streamed);
+    cipher[len / 2] ^= 1;
+    ASSERT_FALSE(ctx.openLong(tc4IV, &cipher[0], len, tc4AAD, sizeof(tc4AAD), tag, &back[0]));
+}
+
+// Check scatter-gather seal/open against the known vectors,
+// with segment boundaries falling inside and across blocks.
+TEST(Main,GCMSegments)
+{
+    const OTAESGCM::OTAES128GCMSegment aad[] = { { tc4AAD, 7 }, { NULL, 0 }, { tc4AAD + 7, 13 } };
+    // Plaintext fields gathered straight into one ciphertext buffer.
+    uint8_t cipher[60], tag[16];
+    static const size_t cuts[] = { 0, 5, 21, 21, 43, 60 };
+    OTAESGCM::OTAES128GCMTextSegment text[5];
+    for(size_t i = 0; i < 5; ++i) { text[i] = { tc4Plain + cuts[i], cipher + cuts[i], cuts[i + 1] - cuts[i] }; }
+    OTAESGCM::OTAES128GCMKeyed<> ctx(tc4Key);
+    ASSERT_TRUE(ctx.sealSegments(tc4IV, aad, 3, text, 5, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, cipher, sizeof(cipher)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    memset(cipher, 0, sizeof(cipher));
+    ASSERT_TRUE(gen.gcmEncryptSegments(tc4Key, tc4IV, aad, 3, text, 5, tag, 12));
+    ASSERT_EQ(0, memcmp(tc4Cipher, cipher, sizeof(cipher)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, 12));
+
+    // Ciphertext scattered back out to separate fields, differently cut.
+    uint8_t field1[33], field2[27];
+    const OTAESGCM::OTAES128GCMTextSegment fields[] = { { tc4Cipher, field1, 33 }, { tc4Cipher + 33, field2, 27 } };
+    ASSERT_TRUE(ctx.openSegments(tc4IV, aad, 3, fields, 2, tc4Tag));
+    ASSERT_EQ(0, memcmp(tc4Plain, field1, 33));
+    ASSERT_EQ(0, memcmp(tc4Plain + 33, field2, 27));
+    memset(field1, 0, sizeof(field1));
+    ASSERT_TRUE(gen.gcmDecryptSegments(tc4Key, tc4IV, aad, 3, fields, 2, tc4Tag));
+    ASSERT_EQ(0, memcmp(tc4Plain, field1, 33));
+    // A wrong tag writes nothing.
+    memset(field1, 0, sizeof(field1));
+    tag[0] = (uint8_t)(tc4Tag[0] ^ 1);
+    memcpy(tag + 1, tc4Tag + 1, 15);
+    ASSERT_FALSE(ctx.openSegments(tc4IV, aad, 3, fields, 2, tag));
+    ASSERT_EQ(0, field1[0]);
+    // Bad parameters.
+    const OTAESGCM::OTAES128GCMSegment badAAD[] = { { NULL, 3 } };
+    ASSERT_FALSE(ctx.sealSegments(tc4IV, badAAD, 1, text, 5, tag));
+    ASSERT_FALSE(ctx.sealSegments(tc4IV, NULL, 0, NULL, 0, tag));
+    ASSERT_FALSE(ctx.sealSegments(tc4IV, NULL, 1, text, 5, tag));
+    // GMAC is the special case of no text.
+    ASSERT_TRUE(ctx.sealSegments(tc4IV, aad, 3, NULL, 0, tag));
+    uint8_t gmac[16];
+    ASSERT_TRUE(ctx.gmacCompute(tc4IV, tc4AAD, sizeof(tc4AAD), gmac));
+    ASSERT_EQ(0, memcmp(gmac, tag, sizeof(tag)));
+}
+
+// Check the compile-time fixed-shape implementation against the known vectors,
+// including a partial final block and a truncated tag.
+TEST(Main,GCMFixed)
+{
+    OTAESGCM::OTAES128GCMFixed<60, 20> fixed;
+    uint8_t out[60], tag[16];
+    ASSERT_TRUE(fixed.encrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, out, sizeof(out)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    ASSERT_TRUE(fixed.decrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Cipher, tc4Tag, out));
+    ASSERT_EQ(0, memcmp(tc4Plain, out, sizeof(out)));
+    // AAD over the fixed maximum.
+    ASSERT_FALSE((OTAESGCM::OTAES128GCMFixed<60, 19>().encrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag)));
+    // Truncated tag, with a tampered tag writing nothing.
+    OTAESGCM::OTAES128GCMFixed<60, 20, 8, OTAESGCM::OTAES128E_fast_t> fixed8;
+    uint8_t tag8[8];
+    ASSERT_TRUE(fixed8.encrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag8));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag8, sizeof(tag8)));
+    ASSERT_TRUE(fixed8.decrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Cipher, tag8, out));
+    ASSERT_EQ(0, memcmp(tc4Plain, out, sizeof(out)));
+    tag8[7] ^= 1;
+    memset(out, 0, sizeof(out));
+    ASSERT_FALSE(fixed8.decrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Cipher, tag8, out));
+    ASSERT_EQ(0, out[0]);
+    // No text is GMAC.
+    uint8_t gmac[16];
+    OTAESGCM::OTAES128GCMKeyed<> ctx(tc4Key);
+    ASSERT_TRUE(ctx.gmacCompute(tc4IV, tc4AAD, sizeof(tc4AAD), gmac));
+    ASSERT_TRUE(fixed.encrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), NULL, NULL, tag));
+    ASSERT_EQ(0, memcmp(gmac, tag, sizeof(tag)));
+    ASSERT_TRUE(fixed.decrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), NULL, gmac, NULL));
+    ASSERT_FALSE(fixed.encrypt(tc4Key, tc4IV, NULL, 0, NULL, NULL, tag));
+    // With workspace, and the GHASH table, agreeing with the generic padded form for 32 bytes.
+    uint8_t workspace[OTAESGCM::OTAES128GCMFixedWithWorkspace<32>::workspaceWithGHASHTable];
+    OTAESGCM::OTAES128GCMFixedWithWorkspace<32> fixedW(workspace, sizeof(workspace));
+    uint8_t out2[32], tag2[16];
+    ASSERT_TRUE(fixedW.encrypt(tc4Key, tc4IV, tc4AAD, sizeof(tc4AAD), tc4Plain, out, tag));
+    OTAESGCM::OTAES128GCMGeneric<> gen;
+    ASSERT_TRUE(gen.gcmEncrypt(tc4Key, tc4IV, tc4Plain, 32, tc4AAD, sizeof(tc4AAD), out2, tag2));
+    ASSERT_EQ(0, memcmp(out2, out, sizeof(out2)));
+    ASSERT_EQ(0, memcmp(tag2, tag, sizeof(tag2)));
+}
+
+// Check sealing with keystream and tag mask prepared ahead of time.
+TEST(Main,GCMPrepared)
+{
+    OTAESGCM::OTAES128GCMKeyed<> ctx;
+    uint8_t prepared[OTAESGCM::gcmPreparedSize(sizeof(tc4Plain))];
+    uint8_t cipher[60], tag[16];
+    ASSERT_FALSE(ctx.prepare(tc4IV, prepared, sizeof(prepared)));
+    ASSERT_TRUE(ctx.setKey(tc4Key));
+    ASSERT_TRUE(ctx.prepare(tc4IV, prepared, sizeof(prepared)));
+    ASSERT_TRUE(ctx.sealPrepared(prepared, sizeof(prepared), tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), cipher, tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, cipher, sizeof(cipher)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    // The buffer is single use.
+    ASSERT_FALSE(ctx.sealPrepared(prepared, sizeof(prepared), tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), cipher, tag));
+    // A shorter text than prepared for, with a truncated tag.
+    ASSERT_TRUE(ctx.prepare(tc4IV, prepared, sizeof(prepared)));
+    ASSERT_TRUE(ctx.sealPrepared(prepared, sizeof(prepared), tc4Plain, 33, tc4AAD, sizeof(tc4AAD), cipher, tag, 8));
+    uint8_t expected[33], expectedTag[16];
+    ASSERT_TRUE(ctx.sealLong(tc4IV, tc4Plain, 33, tc4AAD, sizeof(tc4AAD), expected, expectedTag, 8));
+    ASSERT_EQ(0, memcmp(expected, cipher, sizeof(expected)));
+    ASSERT_EQ(0, memcmp(expectedTag, tag, 8));
+    // Too long for the buffer.
+    ASSERT_TRUE(ctx.prepare(tc4IV, prepared, sizeof(prepared) - 1));
+    ASSERT_FALSE(ctx.sealPrepared(prepared, sizeof(prepared) - 1, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), cipher, tag));
+    ASSERT_FALSE(ctx.prepare(tc4IV, prepared, OTAESGCM::AES128GCM_PREPARED_OVERHEAD - 1));
+}
+
+#ifdef OTAESGCM_THREADS
+// Check that multi-threaded seal/open matches sealLong()/openLong(),
+// for several thread counts and engines, and a partial final block.
+TEST(Main,GCMParallel)
+{
+    const size_t len = 5 * OTAESGCM::OTAES128GCMKeyedBase::GCM_PARALLEL_MIN_SHARE + 7;
+    std::vector<uint8_t> plain(len), expected(len), cipher(len), back(len);
+    for(size_t i = 0; i < len; ++i) { plain[i] = (uint8_t)(i * 7 + (i >> 9)); }
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> c0(tc4Key), c1(tc4Key), c2(tc4Key);
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_TTable> c3(tc4Key);
+    const OTAESGCM::OTAES128GCMKeyedBase *contexts[] = { &c0, &c1, &c2, &c3 };
+    uint8_t expectedTag[16], tag[16];
+    ASSERT_TRUE(c0.sealLong(tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &expected[0], expectedTag));
+    for(uint8_t n = 1; n <= 4; ++n)
+        {
+        memset(&cipher[0], 0, len);
+        ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(contexts, n, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+        ASSERT_TRUE(expected == cipher) << (int)n;
+        ASSERT_EQ(0, memcmp(expectedTag, tag, sizeof(tag))) << (int)n;
+        ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::openParallel(contexts, n, tc4IV, &cipher[0], len, tc4AAD, sizeof(tc4AAD), tag, &back[0]));
+        ASSERT_TRUE(plain == back) << (int)n;
+        }
+    // Short messages use one thread and still match.
+    ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(contexts, 4, tc4IV, tc4Plain, sizeof(tc4Plain), tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+    ASSERT_EQ(0, memcmp(tc4Cipher, &cipher[0], sizeof(tc4Cipher)));
+    ASSERT_EQ(0, memcmp(tc4Tag, tag, sizeof(tag)));
+    // Tampering is detected and nothing is written.
+    cipher = expected;
+    cipher[len - 1] ^= 1;
+    memset(&back[0], 0, len);
+    ASSERT_FALSE(OTAESGCM::OTAES128GCMKeyedBase::openParallel(contexts, 4, tc4IV, &cipher[0], len, tc4AAD, sizeof(tc4AAD), expectedTag, &back[0]));
+    ASSERT_EQ(0, back[0]);
+    // Contexts must all be keyed, with the same key.
+    c3.clearKey();
+    ASSERT_FALSE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(contexts, 4, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+    static const uint8_t otherKey[16] = { 1 };
+    c3.setKey(otherKey);
+    ASSERT_FALSE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(contexts, 4, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+    ASSERT_FALSE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(contexts, 0, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+}
+
+// Check that seal/open on a persistent pool matches sealLong(),
+// with one context shared by all threads or several, and reusing the pool across calls.
+TEST(Main,GCMParallelPool)
+{
+    const size_t len = 5 * OTAESGCM::OTAES128GCMKeyedBase::GCM_PARALLEL_MIN_SHARE + 7;
+    std::vector<uint8_t> plain(len), expected(len), cipher(len), back(len);
+    for(size_t i = 0; i < len; ++i) { plain[i] = (uint8_t)(i * 5 + (i >> 11)); }
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> c0(tc4Key), c1(tc4Key);
+    const OTAESGCM::OTAES128GCMKeyedBase *contexts[] = { &c0, &c1 };
+    uint8_t expectedTag[16], tag[16];
+    ASSERT_TRUE(c0.sealLong(tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &expected[0], expectedTag));
+    OTAESGCM::OTAES128GCMThreadPool pool;
+    ASSERT_FALSE(pool.start(0));
+    ASSERT_FALSE(pool.start(OTAESGCM::OTAES128GCMThreadPool::MAX_THREADS + 1));
+    // A stopped pool does all the work on the caller's thread.
+    ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(&pool, contexts, 1, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+    ASSERT_TRUE(expected == cipher);
+    ASSERT_EQ(0, memcmp(expectedTag, tag, sizeof(tag)));
+    ASSERT_TRUE(pool.start(3));
+    ASSERT_EQ(3, pool.workerCount());
+    ASSERT_FALSE(pool.start(1));
+    for(uint8_t n = 1; n <= 2; ++n)
+        {
+        for(int rep = 0; rep < 3; ++rep)
+            {
+            memset(&cipher[0], 0, len);
+            ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(&pool, contexts, n, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+            ASSERT_TRUE(expected == cipher) << (int)n;
+            ASSERT_EQ(0, memcmp(expectedTag, tag, sizeof(tag))) << (int)n;
+            memset(&back[0], 0, len);
+            ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::openParallel(&pool, contexts, n, tc4IV, &cipher[0], len, tc4AAD, sizeof(tc4AAD), tag, &back[0]));
+            ASSERT_TRUE(plain == back) << (int)n;
+            }
+        }
+    // Tampering is still detected.
+    cipher[0] ^= 1;
+    ASSERT_FALSE(OTAESGCM::OTAES128GCMKeyedBase::openParallel(&pool, contexts, 2, tc4IV, &cipher[0], len, tc4AAD, sizeof(tc4AAD), tag, &back[0]));
+    // Stopped, then started again.
+    pool.stop();
+    ASSERT_EQ(0, pool.workerCount());
+    ASSERT_TRUE(pool.start(1, false));
+    ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(&pool, contexts, 1, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+    ASSERT_TRUE(expected == cipher);
+}
+
+// Seals and opens nMsgs messages with ctx, the IV varying by message, results appended to out.
+static void sealOpenMany(const OTAESGCM::OTAES128GCMKeyedBase *const ctx, const size_t nMsgs,
+                         std::vector<uint8_t> *const out, bool *const ok)
+{
+    uint8_t IV[12], plain[45], cipher[45], tag[16], back[45];
+    memcpy(IV, tc4IV, sizeof(IV));
+    for(size_t i = 0; i < sizeof(plain); ++i) { plain[i] = (uint8_t)(i * 3); }
+    *ok = true;
+    for(size_t m = 0; m < nMsgs; ++m)
+        {
+        IV[11] = (uint8_t)m;
+        plain[0] = (uint8_t)m;
+        *ok &= ctx->sealLong(IV, plain, sizeof(plain), tc4AAD, sizeof(tc4AAD), cipher, tag);
+        *ok &= ctx->openLong(IV, cipher, sizeof(cipher), tc4AAD, sizeof(tc4AAD), tag, back);
+        *ok &= (0 == memcmp(plain, back, sizeof(plain)));
+        out->insert(out->end(), cipher, cipher + sizeof(cipher));
+        out->insert(out->end(), tag, tag + sizeof(tag));
+        }
+}
+
+// Check that one keyed context can be shared by several threads at once
+// and gives the same results as when used from one thread, for each engine.
+TEST(Main,GCMSharedKeyedContext)
+{
+    OTAESGCM::OTAES128GCMKeyed<> cAVR(tc4Key);
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_TTable> cTT(tc4Key);
+    OTAESGCM::OTAES128GCMKeyed<OTAESGCM::OTAES128E_fast_t> cFast(tc4Key);
+    const OTAESGCM::OTAES128GCMKeyedBase *const engines[] = { &cAVR, &cTT, &cFast };
+    const size_t nMsgs = 200;
+    const uint8_t nThreads = 4;
+    for(const OTAESGCM::OTAES128GCMKeyedBase *ctx : engines)
+        {
+        std::vector<uint8_t> expected;
+        bool ok;
+        sealOpenMany(ctx, nMsgs, &expected, &ok);
+        ASSERT_TRUE(ok);
+        std::vector<uint8_t> results[nThreads];
+        bool oks[nThreads];
+        std::thread threads[nThreads];
+        for(uint8_t t = 0; t < nThreads; ++t) { threads[t] = std::thread(sealOpenMany, ctx, nMsgs, &results[t], &oks[t]); }
+        for(uint8_t t = 0; t < nThreads; ++t) { threads[t].join(); }
+        for(uint8_t t = 0; t < nThreads; ++t)
+            {
+            ASSERT_TRUE(oks[t]) << (int)t;
+            ASSERT_TRUE(expected == results[t]) << (int)t;
+            }
+        }
+    // One context may stand for all the threads of a parallel seal.
+    const size_t len = 3 * OTAESGCM::OTAES128GCMKeyedBase::GCM_PARALLEL_MIN_SHARE + 5;
+    std::vector<uint8_t> plain(len, 0x5a), expected(len), cipher(len);
+    uint8_t expectedTag[16], tag[16];
+    ASSERT_TRUE(cFast.sealLong(tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &expected[0], expectedTag));
+    const OTAESGCM::OTAES128GCMKeyedBase *const same[] = { &cFast, &cFast, &cFast };
+    ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(same, 3, tc4IV, &plain[0], len, tc4AAD, sizeof(tc4AAD), &cipher[0], tag));
+    ASSERT_TRUE(expected == cipher);
+    ASSERT_EQ(0, memcmp(expectedTag, tag, sizeof(tag)));
+    // More contexts than GCM_PARALLEL_MAX_THREADS, and enough text for each: capped, and still matching.
+    const size_t bigLen = (OTAESGCM::OTAES128GCMKeyedBase::GCM_PARALLEL_MAX_THREADS + 2) * OTAESGCM::OTAES128GCMKeyedBase::GCM_PARALLEL_MIN_SHARE + 3;
+    std::vector<uint8_t> bigPlain(bigLen, 0xa5), bigExpected(bigLen), bigCipher(bigLen);
+    ASSERT_TRUE(cFast.sealLong(tc4IV, &bigPlain[0], bigLen, tc4AAD, sizeof(tc4AAD), &bigExpected[0], expectedTag));
+    const OTAESGCM::OTAES128GCMKeyedBase *many[UINT8_MAX];
+    for(size_t i = 0; i < UINT8_MAX; ++i) { many[i] = &cFast; }
+    ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::sealParallel(many, UINT8_MAX, tc4IV, &bigPlain[0], bigLen, tc4AAD, sizeof(tc4AAD), &bigCipher[0], tag));
+    ASSERT_TRUE(bigExpected == bigCipher);
+    ASSERT_EQ(0, memcmp(expectedTag, tag, sizeof(tag)));
+    ASSERT_TRUE(OTAESGCM::OTAES128GCMKeyedBase::openParallel(many, UINT8_MAX, tc4IV, &bigCipher[0], bigLen, tc4AAD, sizeof(tc4AAD), tag, &bigCipher[0]));
+    ASSERT_TRUE(bigPlain == bigCipher);
+}
+
+// Pipeline test: node n (below PIPELINE_NODES) has a key derived from n; others are unknown.
+static const uint8_t PIPELINE_NODES = 10;
+static void pipelineKey(const uint64_t nodeID, uint8_t *const key)
+    { for(uint8_t i = 0; i < 16; ++i) { key[i] = (uint8_t)(nodeID * 31 + i); } }
+static bool pipelineKeyLookup(const uint64_t nodeID, uint8_t *const key, void *)
+    { if(nodeID >= PIPELINE_NODES) { return(false); } pipelineKey(nodeID, key); return(true); }
+// Counts completions (in arg) and records each frame's result in its user byte: 1 if ok, 2 if not.
+static void pipelineCompletion(OTAESGCM::OTAES128GCMPipelineFrame *const frame, const bool ok, void *const arg)
+{
+    *(uint8_t *)frame->user = ok ? 1 : 2;
+    ((std::atomic<size_t> *)arg)->fetch_add(1, std::memory_order_release);
+}
+static std::atomic<size_t> pipelineDone;
+static OTAESGCM::OTAES128GCMPipeline<3, 8, 2> pipeline(pipelineKeyLookup, pipelineCompletion, &pipelineDone);
+
+// Check that the pipeline opens frames from many nodes, submitted from two threads,
+// with more nodes than cached contexts and small queues, with 1 and 3 workers,
+// rejecting tampered frames and unknown nodes, and that every frame is completed exactly once.
+TEST(Main,GCMPipeline)
+{
+    const size_t nFrames = 300;
+    std::vector<uint8_t> cipher(nFrames * 32), plain(nFrames * 32), tags(nFrames * 16), results(nFrames);
+    std::vector<OTAESGCM::OTAES128GCMPipelineFrame> frames(nFrames);
+    for(size_t i = 0; i < nFrames; ++i)
+        {
+        // Every 50th frame is from an unknown node.
+        const uint64_t node = (0 == i % 50) ? 1000 + i : i % PIPELINE_NODES;
+        uint8_t key[16];
+        pipelineKey(node, key);
+        OTAESGCM::OTAES128GCMKeyed<> ctx(key);
+        for(size_t j = 0; j < 32; ++j) { plain[i * 32 + j] = (uint8_t)(i + j); }
+        ASSERT_TRUE(ctx.sealLong(tc4IV, &plain[i * 32], 32, tc4AAD, sizeof(tc4AAD), &cipher[i * 32], &tags[i * 16]));
+        // Every 7th frame is tampered with.
+        if(0 == i % 7) { cipher[i * 32] ^= 1; }
+        frames[i] = { node, tc4IV, tc4AAD, sizeof(tc4AAD), &cipher[i * 32], 32, &cipher[i * 32], &tags[i * 16], 16, &results[i] };
+        }
+    const std::vector<uint8_t> sealed(cipher);
+    ASSERT_FALSE(pipeline.submit(&frames[0]));
+    for(uint8_t nWorkers = 1; nWorkers <= 3; nWorkers = (uint8_t)(nWorkers + 2))
+        {
+        cipher = sealed;
+        memset(&results[0], 0, nFrames);
+        pipelineDone.store(0);
+        ASSERT_TRUE(pipeline.start(nWorkers));
+        ASSERT_FALSE(pipeline.start(nWorkers));
+        ASSERT_EQ(nWorkers, pipeline.workerCount());
+        // Two receivers, each submitting alternate frames and retrying while its queue is full.
+        auto receive = [&frames](const size_t first)
+            {
+            for(size_t i = first; i < nFrames; i += 2)
+                { while(!pipeline.submit(&frames[i])) { std::this_thread::yield(); } }
+            };
+        std::thread r0(receive, 0), r1(receive, 1);
+        r0.join();
+        r1.join();
+        pipeline.stop();
+        ASSERT_EQ(nFrames, pipelineDone.load());
+        for(size_t i = 0; i < nFrames; ++i)
+            {
+            const bool good = (0 != i % 50) && (0 != i % 7);
+            ASSERT_EQ(good ? 1 : 2, results[i]) << i;
+            if(good) { ASSERT_EQ(0, memcmp(&plain[i * 32], &cipher[i * 32], 32)) << i; }
+            else { ASSERT_EQ(0, memcmp(&sealed[i * 32], &cipher[i * 32], 32)) << i; }
+            }
+        }
+    // Idle workers go to sleep, and a submitted frame wakes its worker without waiting for stop().
+    cipher = sealed;
+    pipelineDone.store(0);
+    ASSERT_TRUE(pipeline.start(3));
+    for(size_t i = 1; i <= 3; ++i)
+        {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ASSERT_TRUE(pipeline.submit(&frames[i]));
+        for(int t = 0; (t < 5000) && (pipelineDone.load() < i); ++t) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); }
+        ASSERT_EQ(i, pipelineDone.load());
+        ASSERT_EQ(0, memcmp(&plain[i * 32], &cipher[i * 32], 32)) << i;
+        }
+    pipeline.stop();
+    ASSERT_FALSE(pipeline.isRunning());
+    ASSERT_FALSE(pipeline.start(0));
+    ASSERT_FALSE(pipeline.start(4));
+    pipeline.clearKeys();
+}
+#endif
+
 // Check that authentication works correctly.
 //
 // DHD20161107: copied from test.ino testAESGCMAuthentication().
@@ -624,6 +1867,19 @@ TEST(Main,AESGCMNoKey)
     OTAESGCM::OTAES128GCMGeneric<> gen;
     ASSERT_FALSE(gen.gcmEncrypt(NULL, nonce, NULL, 0,
                       ADATA, sizeof(ADATA), NULL, tag));
+    // With real text too: must fail rather than pass the plaintext through untouched.
+    uint8_t plain[32], cipher[32];
+    memset(plain, 0x5a, sizeof(plain));
+    memcpy(cipher, plain, sizeof(cipher));
+    ASSERT_FALSE(gen.gcmEncrypt(NULL, nonce, plain, sizeof(plain), NULL, 0, cipher, tag));
+    ASSERT_FALSE(gen.gcmDecrypt(NULL, nonce, cipher, sizeof(cipher), NULL, 0, tag, plain));
+    OTAESGCM::OTAES128GCMGeneric<OTAESGCM::OTAES128E_fast_t> fast;
+    ASSERT_FALSE(fast.gcmEncrypt(NULL, nonce, plain, sizeof(plain), NULL, 0, cipher, tag));
+    ASSERT_FALSE(fast.gcmDecrypt(NULL, nonce, cipher, sizeof(cipher), NULL, 0, tag, plain));
+    // A keyed context still needs an IV.
+    OTAESGCM::OTAES128GCMKeyed<> ctx(tc4Key);
+    ASSERT_FALSE(ctx.seal(NULL, plain, sizeof(plain), NULL, 0, cipher, tag));
+    ASSERT_FALSE(ctx.open(NULL, cipher, sizeof(cipher), NULL, 0, tag, plain));
 }
 
 // Check that runs correctly with ADATA only.